@@ -49,6 +49,14 @@ typedef llvm::DenseMap<const clang::FileEntry *,
                        std::vector<clang::tooling::Replacement>>
     FileToReplacementsMap;
 
+/// \brief Number of replacements read by collectReplacementsFromDirectory().
+struct ReplacementLoadStats {
+  ReplacementLoadStats() : Read(0), Unique(0) {}
+
+  unsigned Read;
+  unsigned Unique;
+};
+
 /// \brief Recursively descends through a directory structure rooted at \p
 /// Directory and attempts to deserialize *.yaml files as
 /// TranslationUnitReplacements. All docs that successfully deserialize are
@@ -56,6 +64,12 @@ typedef llvm::DenseMap<const clang::FileEntry *,
 ///
 /// Directories starting with '.' are ignored during traversal.
 ///
+/// A header included by many translation units typically gets the same
+/// replacements from each of them. Replacements identical to one already
+/// loaded, targeting the same file even if spelled differently, are dropped
+/// so that only unique replacements are kept in \p TUs. Translation units
+/// left without replacements are dropped as well.
+///
 /// \param[in] Directory Directory to begin search for serialized
 /// TranslationUnitReplacements.
 /// \param[out] TUs Collection of all found and deserialized
@@ -63,6 +77,8 @@ typedef llvm::DenseMap<const clang::FileEntry *,
 /// \param[out] TURFiles Collection of all TranslationUnitReplacement files
 /// found in \c Directory.
 /// \param[in] Diagnostics DiagnosticsEngine used for error output.
+/// \param[out] Stats If non-null, receives the number of replacements read
+/// and the number of unique ones kept.
 ///
 /// \returns An error_code indicating success or failure in navigating the
 /// directory structure.
@@ -70,7 +86,8 @@ std::error_code
 collectReplacementsFromDirectory(const llvm::StringRef Directory,
                                  TUReplacements &TUs,
                                  TUReplacementFiles &TURFiles,
-                                 clang::DiagnosticsEngine &Diagnostics);
+                                 clang::DiagnosticsEngine &Diagnostics,
+                                 ReplacementLoadStats *Stats = nullptr);
 
 /// \brief Deduplicate, check for conflicts, and apply all Replacements stored
 /// in \c TUs. If conflicts occur, no Replacements are applied.
@@ -106,19 +123,57 @@ bool applyReplacements(const FileToReplacementsMap &GroupedReplacements,
 /// of source ranges that enclose those Replacements.
 ///
 /// \pre Replacements[i].getOffset() <= Replacements[i+1].getOffset().
+/// \pre Replacements don't overlap, as ensured by mergeAndDeduplicate().
 ///
 /// \param[in] Replacements Replacements from a single file.
 /// 
-/// \returns Collection of source ranges that enclose all given Replacements.
-/// One range is created for each replacement.
+/// \returns Collection of source ranges that enclose all given Replacements,
+/// in increasing order. One range is created for each replacement, except
+/// that ranges overlapping or touching each other are merged into one.
 RangeVector calculateChangedRanges(
     const std::vector<clang::tooling::Replacement> &Replacements);
 
-/// \brief Write the contents of \c FileContents to disk. Keys of the map are
-/// filenames and values are the new contents for those files.
+/// \brief Number of files handled by writeFiles() and writeFileIfChanged().
+struct FileWriteStats {
+  FileWriteStats() : Written(0), Unchanged(0), Failed(0) {}
+
+  unsigned Written;
+  unsigned Unchanged;
+  unsigned Failed;
+};
+
+/// \brief Write \c NewContents to \c FileName unless it is identical to the
+/// current contents of the file, \c OldContents.
+///
+/// The new contents are written to a temporary file in the same directory,
+/// which then replaces \c FileName. An error while writing thus leaves the
+/// original file untouched. A symbolic link, a file with other hard links,
+/// or a file the new one couldn't get the owner and group of, is written in
+/// place instead, so that only its contents change.
+///
+/// \param[in] FileName File to write.
+/// \param[in] OldContents Current contents of \c FileName.
+/// \param[in] NewContents Contents to write.
+/// \param[in,out] Stats Counts the file as written, unchanged or failed.
+///
+/// \returns \li true If the file was written or left unchanged.
+///          \li false If the file could not be written.
+bool writeFileIfChanged(llvm::StringRef FileName, llvm::StringRef OldContents,
+                        llvm::StringRef NewContents, FileWriteStats &Stats);
+
+/// \brief Write the rewritten buffers of \c Rewrites to disk.
+///
+/// Buffers whose contents end up identical to the original file are not
+/// written.
 ///
 /// \param[in] Rewrites Rewriter containing written files to write to disk.
-bool writeFiles(const clang::Rewriter &Rewrites);
+/// \param[out] Stats If non-null, receives the number of files written, left
+/// unchanged and failed to write.
+///
+/// \returns \li true If all changed files were written successfully.
+///          \li false If at least one file could not be written.
+bool writeFiles(const clang::Rewriter &Rewrites,
+                FileWriteStats *Stats = nullptr);
 
 /// \brief Delete the replacement files.
 ///
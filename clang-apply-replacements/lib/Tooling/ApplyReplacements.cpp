@@ -22,10 +22,20 @@
 #include "clang/Rewrite/Core/Rewriter.h"
 #include "clang/Tooling/ReplacementsYaml.h"
 #include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/ADT/StringSet.h"
+#include "llvm/Config/llvm-config.h"
 #include "llvm/Support/FileSystem.h"
 #include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/Path.h"
 #include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+
+#ifdef LLVM_ON_UNIX
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 using namespace llvm;
 using namespace clang;
@@ -33,6 +43,42 @@ using namespace clang;
 
 static void eatDiagnostics(const SMDiagnostic &, void *) {}
 
+namespace {
+/// \brief Remembers the replacements loaded so far to drop the duplicates
+/// coming from other translation units.
+class ReplacementUniquer {
+public:
+  /// \brief Returns true if \p R wasn't seen before.
+  bool insert(const tooling::Replacement &R) {
+    std::string Key;
+    raw_string_ostream OS(Key);
+    OS << getFileKey(R.getFilePath()) << '\0' << R.getOffset() << '\0'
+       << R.getLength() << '\0' << R.getReplacementText();
+    return Seen.insert(OS.str()).second;
+  }
+
+private:
+  /// \brief Returns a key identifying the file at \p Path, whatever the
+  /// spelling of the path, or the path itself if the file doesn't exist.
+  StringRef getFileKey(StringRef Path) {
+    StringMap<std::string>::iterator I = FileKeys.find(Path);
+    if (I != FileKeys.end())
+      return I->getValue();
+
+    std::string &FileKey = FileKeys[Path];
+    sys::fs::UniqueID ID;
+    if (sys::fs::getUniqueID(Path, ID))
+      FileKey = ("path:" + Path).str();
+    else
+      FileKey = "id:" + utostr(ID.getDevice()) + ":" + utostr(ID.getFile());
+    return FileKey;
+  }
+
+  StringMap<std::string> FileKeys;
+  StringSet<> Seen;
+};
+} // end anonymous namespace
+
 namespace clang {
 namespace replace {
 
@@ -40,11 +86,14 @@ std::error_code
 collectReplacementsFromDirectory(const llvm::StringRef Directory,
                                  TUReplacements &TUs,
                                  TUReplacementFiles & TURFiles,
-                                 clang::DiagnosticsEngine &Diagnostics) {
+                                 clang::DiagnosticsEngine &Diagnostics,
+                                 ReplacementLoadStats *Stats) {
   using namespace llvm::sys::fs;
   using namespace llvm::sys::path;
 
   std::error_code ErrorCode;
+  ReplacementUniquer Uniquer;
+  ReplacementLoadStats LocalStats;
 
   for (recursive_directory_iterator I(Directory, ErrorCode), E;
        I != E && !ErrorCode; I.increment(ErrorCode)) {
@@ -75,10 +124,23 @@ collectReplacementsFromDirectory(const llvm::StringRef Directory,
       continue;
     }
 
-    // Only keep files that properly parse.
-    TUs.push_back(TU);
+    // Only keep files that properly parse, and only the replacements that
+    // weren't loaded from another file already.
+    LocalStats.Read += TU.Replacements.size();
+    TU.Replacements.erase(
+        std::remove_if(TU.Replacements.begin(), TU.Replacements.end(),
+                       [&Uniquer](const tooling::Replacement &R) {
+                         return !Uniquer.insert(R);
+                       }),
+        TU.Replacements.end());
+    LocalStats.Unique += TU.Replacements.size();
+
+    if (!TU.Replacements.empty())
+      TUs.push_back(std::move(TU));
   }
 
+  if (Stats)
+    *Stats = LocalStats;
   return ErrorCode;
 }
 
@@ -166,18 +228,26 @@ bool mergeAndDeduplicate(const TUReplacements &TUs,
                          FileToReplacementsMap &GroupedReplacements,
                          clang::SourceManager &SM) {
 
-  // Group all replacements by target file.
-  std::set<StringRef> Warned;
+  // Group all replacements by target file. Most replacements of a file share
+  // the same path so each path is only resolved once.
+  StringMap<const FileEntry *> Entries;
   for (const auto &TU : TUs) {
     for (const tooling::Replacement &R : TU.Replacements) {
-      // Use the file manager to deduplicate paths. FileEntries are
-      // automatically canonicalized.
-      const FileEntry *Entry = SM.getFileManager().getFile(R.getFilePath());
-      if (!Entry && Warned.insert(R.getFilePath()).second) {
-        errs() << "Described file '" << R.getFilePath()
-               << "' doesn't exist. Ignoring...\n";
-        continue;
+      const FileEntry *Entry;
+      StringMap<const FileEntry *>::iterator I = Entries.find(R.getFilePath());
+      if (I != Entries.end()) {
+        Entry = I->getValue();
+      } else {
+        // Use the file manager to deduplicate paths. FileEntries are
+        // automatically canonicalized.
+        Entry = SM.getFileManager().getFile(R.getFilePath());
+        Entries[R.getFilePath()] = Entry;
+        if (!Entry)
+          errs() << "Described file '" << R.getFilePath()
+                 << "' doesn't exist. Ignoring...\n";
       }
+      if (!Entry)
+        continue;
       GroupedReplacements[Entry].push_back(R);
     }
   }
@@ -210,39 +280,157 @@ RangeVector calculateChangedRanges(
     const std::vector<clang::tooling::Replacement> &Replaces) {
   RangeVector ChangedRanges;
 
-  // Generate the new ranges from the replacements.
-  //
-  // NOTE: This is O(n^2) in the number of replacements. If this starts to
-  // become a problem inline shiftedCodePosition() here and do shifts in a
-  // single run through this loop.
+  // Generate the new ranges from the replacements. This does what
+  // tooling::shiftedCodePosition() would do for each replacement in a single
+  // run: as replacements are sorted and don't overlap, the shift of a
+  // replacement is the growth of all replacements starting before it.
+  int Shift = 0;
+  std::vector<tooling::Replacement>::const_iterator Prev = Replaces.begin();
   for (const tooling::Replacement &R : Replaces) {
-    unsigned Offset = tooling::shiftedCodePosition(Replaces, R.getOffset());
+    for (; Prev->getOffset() < R.getOffset(); ++Prev)
+      Shift += int(Prev->getReplacementText().size()) - int(Prev->getLength());
+
+    unsigned Offset = R.getOffset() + Shift;
     unsigned Length = R.getReplacementText().size();
 
+    // Extend the last range rather than adding one that overlaps or touches
+    // it so clang-format is handed as few ranges as possible.
+    if (!ChangedRanges.empty()) {
+      const tooling::Range &Last = ChangedRanges.back();
+      unsigned LastEnd = Last.getOffset() + Last.getLength();
+      if (Offset <= LastEnd) {
+        ChangedRanges.back() =
+            tooling::Range(Last.getOffset(),
+                           std::max(LastEnd, Offset + Length) -
+                               Last.getOffset());
+        continue;
+      }
+    }
     ChangedRanges.push_back(tooling::Range(Offset, Length));
   }
 
   return ChangedRanges;
 }
 
-bool writeFiles(const clang::Rewriter &Rewrites) {
+/// \brief Writes \p Contents over the existing file \p FileName, through
+/// symbolic links and keeping its owner, permissions and other hard links.
+static std::error_code writeFileInPlace(StringRef FileName,
+                                        StringRef Contents) {
+  std::error_code EC;
+  raw_fd_ostream FileStream(FileName, EC, sys::fs::F_None);
+  if (EC)
+    return EC;
+  FileStream << Contents;
+  FileStream.close();
+  if (FileStream.has_error()) {
+    FileStream.clear_error();
+    return std::make_error_code(std::errc::io_error);
+  }
+  return std::error_code();
+}
+
+/// \brief Replaces \p FileName with a new file holding \p Contents, written
+/// to a temporary file in the same directory first.
+///
+/// Replacing a file loses what belongs to the file rather than to its
+/// contents, so this is only done for a regular file, not a symbolic link,
+/// without other hard links, and if the new file gets the same owner and
+/// group. The new file is given the exact permissions of the old one,
+/// regardless of the umask.
+///
+/// \returns true and sets \p EC to the result of the replacement if it was
+/// attempted, false if the file must be written in place instead.
+static bool replaceFile(StringRef FileName, StringRef Contents,
+                        std::error_code &EC) {
+  unsigned Mode = sys::fs::all_read | sys::fs::all_write;
+#ifdef LLVM_ON_UNIX
+  struct stat OldStatus;
+  if (::lstat(FileName.str().c_str(), &OldStatus) != 0 ||
+      !S_ISREG(OldStatus.st_mode) || OldStatus.st_nlink != 1)
+    return false;
+  Mode = OldStatus.st_mode & 07777;
+#else
+  sys::fs::file_status OldStatus;
+  if (!sys::fs::status(FileName, OldStatus))
+    Mode = OldStatus.permissions();
+#endif
+
+  int FD;
+  SmallString<128> TempFile;
+  EC = sys::fs::createUniqueFile(FileName + "-%%%%%%%%.tmp", FD, TempFile,
+                                 Mode);
+  if (EC)
+    return true;
+
+#ifdef LLVM_ON_UNIX
+  struct stat NewStatus;
+  if (::fstat(FD, &NewStatus) != 0 || NewStatus.st_uid != OldStatus.st_uid ||
+      NewStatus.st_gid != OldStatus.st_gid ||
+      ::fchmod(FD, OldStatus.st_mode & 07777) != 0) {
+    ::close(FD);
+    sys::fs::remove(TempFile);
+    return false;
+  }
+#endif
+
+  raw_fd_ostream FileStream(FD, /*shouldClose=*/true);
+  FileStream << Contents;
+  FileStream.close();
+  if (FileStream.has_error()) {
+    FileStream.clear_error();
+    EC = std::make_error_code(std::errc::io_error);
+  } else {
+    EC = sys::fs::rename(TempFile, FileName);
+  }
+  if (EC)
+    sys::fs::remove(TempFile);
+  return true;
+}
+
+bool writeFileIfChanged(StringRef FileName, StringRef OldContents,
+                        StringRef NewContents, FileWriteStats &Stats) {
+  if (NewContents == OldContents) {
+    ++Stats.Unchanged;
+    return true;
+  }
+
+  std::error_code EC;
+  if (!replaceFile(FileName, NewContents, EC))
+    EC = writeFileInPlace(FileName, NewContents);
+
+  if (EC) {
+    errs() << "Warning: Could not write to " << FileName << ": "
+           << EC.message() << "\n";
+    ++Stats.Failed;
+    return false;
+  }
+  ++Stats.Written;
+  return true;
+}
+
+bool writeFiles(const clang::Rewriter &Rewrites, FileWriteStats *Stats) {
+  const SourceManager &SM = Rewrites.getSourceMgr();
+  FileWriteStats LocalStats;
+  bool Success = true;
 
   for (Rewriter::const_buffer_iterator BufferI = Rewrites.buffer_begin(),
                                        BufferE = Rewrites.buffer_end();
        BufferI != BufferE; ++BufferI) {
-    const char *FileName =
-        Rewrites.getSourceMgr().getFileEntryForID(BufferI->first)->getName();
+    const char *FileName = SM.getFileEntryForID(BufferI->first)->getName();
 
-    std::error_code EC;
-    llvm::raw_fd_ostream FileStream(FileName, EC, llvm::sys::fs::F_Text);
-    if (EC) {
-      errs() << "Warning: Could not write to " << EC.message() << "\n";
-      continue;
-    }
-    BufferI->second.write(FileStream);
+    std::string NewContents;
+    llvm::raw_string_ostream OS(NewContents);
+    BufferI->second.write(OS);
+    OS.flush();
+
+    if (!writeFileIfChanged(FileName, SM.getBufferData(BufferI->first),
+                            NewContents, LocalStats))
+      Success = false;
   }
 
-  return true;
+  if (Stats)
+    *Stats = LocalStats;
+  return Success;
 }
 
 bool deleteReplacementFiles(const TUReplacementFiles &Files,
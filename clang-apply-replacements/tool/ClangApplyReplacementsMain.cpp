@@ -23,6 +23,8 @@
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/StringSet.h"
 #include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/MemoryBuffer.h"
 
 using namespace llvm;
 using namespace clang;
@@ -43,6 +45,13 @@ static cl::opt<bool> RemoveTUReplacementFiles(
              "merging/replacing."),
     cl::init(false), cl::cat(ReplacementCategory));
 
+static cl::opt<bool> Summary(
+    "summary",
+    cl::desc("Print the number of replacements read and of unique ones,\n"
+             "then the number of files written, of files left\n"
+             "unchanged because applying replacements did not modify them\n"
+             "and of files that could not be written."),
+    cl::init(false), cl::cat(ReplacementCategory));
 
 static cl::opt<bool> DoFormat(
     "format",
@@ -213,9 +222,10 @@ int main(int argc, char **argv) {
 
   TUReplacements TUs;
   TUReplacementFiles TURFiles;
+  ReplacementLoadStats LoadStats;
 
-  std::error_code ErrorCode =
-      collectReplacementsFromDirectory(Directory, TUs, TURFiles, Diagnostics);
+  std::error_code ErrorCode = collectReplacementsFromDirectory(
+      Directory, TUs, TURFiles, Diagnostics, &LoadStats);
 
   if (ErrorCode) {
     errs() << "Trouble iterating over directory '" << Directory
@@ -237,6 +247,8 @@ int main(int argc, char **argv) {
     return 1;
 
   Rewriter ReplacementsRewriter(SM, LangOptions());
+  FileWriteStats Stats;
+  bool WriteFailed = false;
 
   for (const auto &FileAndReplacements : GroupedReplacements) {
     // This shouldn't happen but if a file somehow has no replacements skip to
@@ -261,16 +273,31 @@ int main(int argc, char **argv) {
       continue;
     }
 
-    // Write new file to disk
-    std::error_code EC;
-    llvm::raw_fd_ostream FileStream(FileName, EC, llvm::sys::fs::F_None);
-    if (EC) {
-      llvm::errs() << "Could not open " << FileName << " for writing\n";
+    // Write new file to disk, unless replacements and formatting cancelled
+    // each other out.
+    bool Invalid = false;
+    const llvm::MemoryBuffer *OldFileData =
+        SM.getMemoryBufferForFile(FileAndReplacements.first, &Invalid);
+    if (Invalid) {
+      errs() << "Could not read " << FileName << "\n";
       continue;
     }
+    if (!writeFileIfChanged(FileName, OldFileData->getBuffer(), NewFileData,
+                            Stats))
+      WriteFailed = true;
+  }
 
-    FileStream << NewFileData;
+  if (Summary) {
+    outs() << "Replacements read: " << LoadStats.Read
+           << " - Unique: " << LoadStats.Unique;
+    if (LoadStats.Unique)
+      outs() << " - Ratio: "
+             << format("%.2f", double(LoadStats.Read) / LoadStats.Unique);
+    outs() << "\n";
+    outs() << "Files written: " << Stats.Written
+           << " - Unchanged: " << Stats.Unchanged
+           << " - Failed: " << Stats.Failed << "\n";
   }
 
-  return 0;
+  return WriteFailed ? 1 : 0;
 }
@@ -28,6 +28,10 @@ static cl::opt<bool> DetectMacros(
     cl::desc("Detect and use macros that expand to the 'override' keyword."),
     cl::cat(TransformsOptionsCategory));
 
+std::string AddOverrideTransform::getOptionsKey() const {
+  return DetectMacros ? "override-macros=1" : "override-macros=0";
+}
+
 int AddOverrideTransform::apply(const CompilationDatabase &Database,
                                 const std::vector<std::string> &SourcePaths) {
   ClangTool AddOverrideTool(Database, SourcePaths);
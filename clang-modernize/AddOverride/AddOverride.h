@@ -34,6 +34,9 @@ public:
   int apply(const clang::tooling::CompilationDatabase &Database,
             const std::vector<std::string> &SourcePaths) override;
 
+  /// \see Transform::getOptionsKey().
+  std::string getOptionsKey() const override;
+
   bool handleBeginSource(clang::CompilerInstance &CI,
                          llvm::StringRef Filename) override;
 
@@ -20,46 +20,17 @@
 #include "clang/Lex/Preprocessor.h"
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/StringSwitch.h"
-#include <stack>
+#include <algorithm>
 
 using namespace clang;
 using namespace clang::tooling;
 using llvm::StringRef;
 
-/// \brief PPCallbacks that fills-in the include information in the given
+/// \brief PPCallbacks that records the inclusion directives in the given
 /// \c IncludeDirectives.
 class IncludeDirectivesPPCallback : public clang::PPCallbacks {
-  // Struct helping the detection of header guards in the various callbacks
-  struct GuardDetection {
-    GuardDetection(FileID FID)
-      : FID(FID), Count(0), TheMacro(nullptr), CountAtEndif(0) {}
-
-    FileID FID;
-    // count for relevant preprocessor directives
-    unsigned Count;
-    // the macro that is tested in the top most ifndef for the header guard
-    // (e.g: GUARD_H)
-    const IdentifierInfo *TheMacro;
-    // the hash locations of #ifndef, #define, #endif
-    SourceLocation IfndefLoc, DefineLoc, EndifLoc;
-    // the value of Count once the #endif is reached
-    unsigned CountAtEndif;
-
-    /// \brief Check that with all the information gathered if this is a
-    /// potential header guard.
-    ///
-    /// Meaning a top-most \#ifndef has been found, followed by a define and the
-    /// last preprocessor directive was the terminating \#endif.
-    ///
-    /// FIXME: accept the \#if !defined identifier form too.
-    bool isPotentialHeaderGuard() const {
-      return Count == CountAtEndif && DefineLoc.isValid();
-    }
-  };
-
 public:
-  IncludeDirectivesPPCallback(IncludeDirectives *Self)
-      : Self(Self), Guard(nullptr) {}
+  IncludeDirectivesPPCallback(IncludeDirectives *Self) : Self(Self) {}
   ~IncludeDirectivesPPCallback() override {}
 
 private:
@@ -68,161 +39,10 @@ private:
                           CharSourceRange FilenameRange, const FileEntry *File,
                           StringRef SearchPath, StringRef RelativePath,
                           const Module *Imported) override {
-    SourceManager &SM = Self->Sources;
-    const FileEntry *FE = SM.getFileEntryForID(SM.getFileID(HashLoc));
-    assert(FE && "Valid file expected.");
-
-    IncludeDirectives::Entry E(HashLoc, File, IsAngled);
-    Self->FileToEntries[FE].push_back(E);
-    Self->IncludeAsWrittenToLocationsMap[FileName].push_back(HashLoc);
-  }
-
-  // Keep track of the current file in the stack
-  void FileChanged(SourceLocation Loc, FileChangeReason Reason,
-                   SrcMgr::CharacteristicKind FileType,
-                   FileID PrevFID) override {
-    SourceManager &SM = Self->Sources;
-    switch (Reason) {
-    case EnterFile:
-      Files.push(GuardDetection(SM.getFileID(Loc)));
-      Guard = &Files.top();
-      break;
-
-    case ExitFile:
-      if (Guard->isPotentialHeaderGuard())
-        handlePotentialHeaderGuard(*Guard);
-      Files.pop();
-      Guard = &Files.top();
-      break;
-
-    default:
-      break;
-    }
-  }
-
-  /// \brief Mark this header as guarded in the IncludeDirectives if it's a
-  /// proper header guard.
-  void handlePotentialHeaderGuard(const GuardDetection &Guard) {
-    SourceManager &SM = Self->Sources;
-    const FileEntry *File = SM.getFileEntryForID(Guard.FID);
-    const LangOptions &LangOpts = Self->CI.getLangOpts();
-
-    // Null file can happen for the <built-in> buffer for example. They
-    // shouldn't have header guards though...
-    if (!File)
-      return;
-
-    // The #ifndef should be the next thing after the preamble. We aren't
-    // checking for equality because it can also be part of the preamble if the
-    // preamble is the whole file.
-    unsigned Preamble =
-        Lexer::ComputePreamble(SM.getBuffer(Guard.FID)->getBuffer(), LangOpts)
-            .first;
-    unsigned IfndefOffset = SM.getFileOffset(Guard.IfndefLoc);
-    if (IfndefOffset > (Preamble + 1))
-      return;
-
-    // No code is allowed in the code remaining after the #endif.
-    const llvm::MemoryBuffer *Buffer = SM.getBuffer(Guard.FID);
-    Lexer Lex(SM.getLocForStartOfFile(Guard.FID), LangOpts,
-              Buffer->getBufferStart(),
-              Buffer->getBufferStart() + SM.getFileOffset(Guard.EndifLoc),
-              Buffer->getBufferEnd());
-
-    // Find the first newline not part of a multi-line comment.
-    Token Tok;
-    Lex.LexFromRawLexer(Tok); // skip endif
-    Lex.LexFromRawLexer(Tok);
-
-    // Not a proper header guard, the remainder of the file contains something
-    // else than comments or whitespaces.
-    if (Tok.isNot(tok::eof))
-      return;
-
-    // Add to the location of the define to the IncludeDirectives for this file.
-    Self->HeaderToGuard[File] = Guard.DefineLoc;
-  }
-
-  void Ifndef(SourceLocation Loc, const Token &MacroNameTok,
-              const MacroDefinition &MD) override {
-    Guard->Count++;
-
-    // If this #ifndef is the top-most directive and the symbol isn't defined
-    // store those information in the guard detection, the next step will be to
-    // check for the define.
-    if (Guard->Count == 1 && !MD) {
-      IdentifierInfo *MII = MacroNameTok.getIdentifierInfo();
-
-      Guard->IfndefLoc = Loc;
-      Guard->TheMacro = MII;
-    }
-  }
-
-  void MacroDefined(const Token &MacroNameTok,
-                    const MacroDirective *MD) override {
-    Guard->Count++;
-
-    // If this #define is the second directive of the file and the symbol
-    // defined is the same as the one checked in the #ifndef then store the
-    // information about this define.
-    if (Guard->Count == 2 && Guard->TheMacro != nullptr) {
-      IdentifierInfo *MII = MacroNameTok.getIdentifierInfo();
-
-      // macro unrelated to the ifndef, doesn't look like a proper header guard
-      if (MII->getName() != Guard->TheMacro->getName())
-        return;
-
-      Guard->DefineLoc = MacroNameTok.getLocation();
-    }
-  }
-
-  void Endif(SourceLocation Loc, SourceLocation IfLoc) override {
-    Guard->Count++;
-
-    // If it's the #endif corresponding to the top-most #ifndef
-    if (Self->Sources.getDecomposedLoc(Guard->IfndefLoc) !=
-        Self->Sources.getDecomposedLoc(IfLoc))
-      return;
-
-    // And that the top-most #ifndef was followed by the right #define
-    if (Guard->DefineLoc.isInvalid())
-      return;
-
-    // Then save the information about this #endif. Once the file is exited we
-    // will check if it was the final preprocessor directive.
-    Guard->CountAtEndif = Guard->Count;
-    Guard->EndifLoc = Loc;
-  }
-
-  void MacroExpands(const Token &, const MacroDefinition &, SourceRange,
-                    const MacroArgs *) override {
-    Guard->Count++;
-  }
-  void MacroUndefined(const Token &, const MacroDefinition &) override {
-    Guard->Count++;
-  }
-  void Defined(const Token &, const MacroDefinition &, SourceRange) override {
-    Guard->Count++;
-  }
-  void If(SourceLocation, SourceRange, ConditionValueKind) override {
-    Guard->Count++;
-  }
-  void Elif(SourceLocation, SourceRange, ConditionValueKind,
-            SourceLocation) override {
-    Guard->Count++;
-  }
-  void Ifdef(SourceLocation, const Token &, const MacroDefinition &) override {
-    Guard->Count++;
-  }
-  void Else(SourceLocation, SourceLocation) override {
-    Guard->Count++;
+    Self->addInclusion(HashLoc, File, FileName, IsAngled);
   }
 
   IncludeDirectives *Self;
-  // keep track of the guard info through the include stack
-  std::stack<GuardDetection> Files;
-  // convenience field pointing to Files.top().second
-  GuardDetection *Guard;
 };
 
 // Flags that describes where to insert newlines.
@@ -302,44 +122,159 @@ static std::pair<unsigned, bool> findDirectiveEnd(SourceLocation HashLoc,
   }
 }
 
+/// \brief Find the header guard of the file \p FID, if any, and return the
+/// location of the guard macro in its \#define.
+///
+/// A header guard is an \#ifndef preceded by nothing but comments, directly
+/// followed by the \#define of the macro it tests, and whose \#endif ends the
+/// file.
+///
+/// FIXME: accept the \#if !defined identifier form too.
+static SourceLocation findHeaderGuardDefine(FileID FID, SourceManager &SM,
+                                            const LangOptions &LangOpts) {
+  StringRef Content = SM.getBufferData(FID);
+  Lexer Lex(SM.getLocForStartOfFile(FID), LangOpts, Content.begin(),
+            Content.begin(), Content.end());
+  Token Tok;
+
+  // Lex a directive name if Tok starts a directive, return an empty string
+  // otherwise.
+  auto LexDirective = [&]() -> StringRef {
+    if (Tok.isNot(tok::hash) || !Tok.isAtStartOfLine())
+      return StringRef();
+    Lex.LexFromRawLexer(Tok);
+    return Tok.is(tok::raw_identifier) ? Tok.getRawIdentifier() : StringRef();
+  };
+
+  // #ifndef GUARD
+  Lex.LexFromRawLexer(Tok);
+  if (LexDirective() != "ifndef")
+    return SourceLocation();
+  Lex.LexFromRawLexer(Tok);
+  if (Tok.isNot(tok::raw_identifier))
+    return SourceLocation();
+  StringRef Macro = Tok.getRawIdentifier();
+
+  // #define GUARD
+  Lex.LexFromRawLexer(Tok);
+  if (LexDirective() != "define")
+    return SourceLocation();
+  Lex.LexFromRawLexer(Tok);
+  if (Tok.isNot(tok::raw_identifier) || Tok.getRawIdentifier() != Macro)
+    return SourceLocation();
+  SourceLocation DefineLoc = Tok.getLocation();
+
+  // Find the #endif matching the #ifndef, it must be followed by the end of
+  // the file.
+  unsigned Depth = 1;
+  while (Tok.isNot(tok::eof)) {
+    Lex.LexFromRawLexer(Tok);
+    StringRef Directive = LexDirective();
+    if (Directive == "if" || Directive == "ifdef" || Directive == "ifndef") {
+      ++Depth;
+    } else if (Directive == "endif" && --Depth == 0) {
+      Lex.LexFromRawLexer(Tok);
+      return Tok.is(tok::eof) ? DefineLoc : SourceLocation();
+    }
+  }
+  return SourceLocation();
+}
+
 IncludeDirectives::IncludeDirectives(clang::CompilerInstance &CI)
-    : CI(CI), Sources(CI.getSourceManager()) {
+    : CI(CI), Sources(CI.getSourceManager()), IncludeMapsBuilt(false) {
   // addPPCallbacks takes ownership of the callback
   CI.getPreprocessor().addPPCallbacks(
                           llvm::make_unique<IncludeDirectivesPPCallback>(this));
 }
 
-bool IncludeDirectives::lookForInclude(const FileEntry *File,
-                                       const LocationVec &IncludeLocs,
-                                       SeenFilesSet &Seen) const {
-  // mark this file as visited
-  Seen.insert(File);
+void IncludeDirectives::addInclusion(SourceLocation HashLoc,
+                                     const FileEntry *File, StringRef FileName,
+                                     bool Angled) {
+  char *Name = NameAllocator.Allocate<char>(FileName.size());
+  std::copy(FileName.begin(), FileName.end(), Name);
+  Inclusions.push_back(
+      Inclusion(HashLoc, File, StringRef(Name, FileName.size()), Angled));
+}
 
-  // First check if included directly in this file
-  for (LocationVec::const_iterator I = IncludeLocs.begin(),
-                                   E = IncludeLocs.end();
-       I != E; ++I)
-    if (Sources.getFileEntryForID(Sources.getFileID(*I)) == File)
-      return true;
+void IncludeDirectives::buildIncludeMaps() const {
+  if (IncludeMapsBuilt)
+    return;
+  IncludeMapsBuilt = true;
 
-  // Otherwise look recursively all the included files
-  FileToEntriesMap::const_iterator EntriesIt = FileToEntries.find(File);
-  if (EntriesIt == FileToEntries.end())
-    return false;
-  for (EntryVec::const_iterator I = EntriesIt->second.begin(),
-                                E = EntriesIt->second.end();
+  for (std::vector<Inclusion>::const_iterator I = Inclusions.begin(),
+                                              E = Inclusions.end();
+       I != E; ++I) {
+    const FileEntry *FE =
+        Sources.getFileEntryForID(Sources.getFileID(I->HashLoc));
+    assert(FE && "Valid file expected.");
+
+    FileToEntries[FE].push_back(Entry(I->HashLoc, I->File, I->Angled));
+    IncludeAsWrittenToLocationsMap[I->FileName].push_back(I->HashLoc);
+  }
+}
+
+void IncludeDirectives::indexFiles() const {
+  for (FileToEntriesMap::const_iterator I = FileToEntries.begin(),
+                                        E = FileToEntries.end();
        I != E; ++I) {
-    // skip if this header has already been checked before
-    if (Seen.count(I->getIncludedFile()))
+    FileIndexes.insert(std::make_pair(I->first, FileIndexes.size()));
+    for (EntryVec::const_iterator EntryI = I->second.begin(),
+                                  EntryE = I->second.end();
+         EntryI != EntryE; ++EntryI)
+      FileIndexes.insert(
+          std::make_pair(EntryI->getIncludedFile(), FileIndexes.size()));
+  }
+}
+
+const llvm::BitVector &
+IncludeDirectives::getIncludeClosure(const FileEntry *File) const {
+  llvm::BitVector &Closure = IncludeClosures[File];
+  if (!Closure.empty())
+    return Closure;
+
+  Closure.resize(FileIndexes.size());
+  Closure.set(FileIndexes.lookup(File));
+
+  // Depth-first search of the files included by File, each visited once.
+  llvm::SmallVector<const FileEntry *, 32> Worklist(1, File);
+  while (!Worklist.empty()) {
+    FileToEntriesMap::const_iterator EntriesIt =
+        FileToEntries.find(Worklist.pop_back_val());
+    if (EntriesIt == FileToEntries.end())
       continue;
-    if (lookForInclude(I->getIncludedFile(), IncludeLocs, Seen))
-      return true;
+    for (EntryVec::const_iterator I = EntriesIt->second.begin(),
+                                  E = EntriesIt->second.end();
+         I != E; ++I) {
+      unsigned Index = FileIndexes.lookup(I->getIncludedFile());
+      if (Closure.test(Index))
+        continue;
+      Closure.set(Index);
+      Worklist.push_back(I->getIncludedFile());
+    }
   }
-  return false;
+  return Closure;
+}
+
+const llvm::BitVector &
+IncludeDirectives::getIncluders(StringRef Include,
+                                const LocationVec &IncludeLocs) const {
+  llvm::BitVector &Includers = IncludersByName[Include];
+  if (!Includers.empty())
+    return Includers;
+
+  Includers.resize(FileIndexes.size());
+  for (LocationVec::const_iterator I = IncludeLocs.begin(),
+                                   E = IncludeLocs.end();
+       I != E; ++I)
+    Includers.set(
+        FileIndexes.lookup(Sources.getFileEntryForID(Sources.getFileID(*I))));
+  return Includers;
 }
 
 bool IncludeDirectives::hasInclude(const FileEntry *File,
                                    StringRef Include) const {
+  buildIncludeMaps();
+
   llvm::StringMap<LocationVec>::const_iterator It =
       IncludeAsWrittenToLocationsMap.find(Include);
 
@@ -347,8 +282,15 @@ bool IncludeDirectives::hasInclude(const FileEntry *File,
   if (It == IncludeAsWrittenToLocationsMap.end())
     return false;
 
-  SeenFilesSet Seen;
-  return lookForInclude(File, It->getValue(), Seen);
+  if (FileIndexes.empty())
+    indexFiles();
+
+  // A file that isn't part of the include graph includes nothing.
+  if (!FileIndexes.count(File))
+    return false;
+
+  return getIncludeClosure(File).anyCommon(
+      getIncluders(Include, It->getValue()));
 }
 
 Replacement IncludeDirectives::addAngledInclude(const clang::FileEntry *File,
@@ -419,6 +361,8 @@ IncludeDirectives::findFileHeaderEndOffset(FileID FID) const {
 
 SourceLocation
 IncludeDirectives::angledIncludeHintLoc(FileID FID) const {
+  buildIncludeMaps();
+
   FileToEntriesMap::const_iterator EntriesIt =
       FileToEntries.find(Sources.getFileEntryForID(FID));
 
@@ -454,6 +398,19 @@ IncludeDirectives::angledIncludeHintLoc(FileID FID) const {
 
 std::pair<unsigned, unsigned>
 IncludeDirectives::angledIncludeInsertionOffset(FileID FID) const {
+  llvm::DenseMap<FileID, std::pair<unsigned, unsigned> >::const_iterator
+      CachedIt = InsertionOffsets.find(FID);
+  if (CachedIt != InsertionOffsets.end())
+    return CachedIt->second;
+
+  std::pair<unsigned, unsigned> Offset =
+      computeAngledIncludeInsertionOffset(FID);
+  InsertionOffsets[FID] = Offset;
+  return Offset;
+}
+
+std::pair<unsigned, unsigned>
+IncludeDirectives::computeAngledIncludeInsertionOffset(FileID FID) const {
   SourceLocation Hint = angledIncludeHintLoc(FID);
   unsigned NL_Flags = NL_Prepend;
 
@@ -461,14 +418,10 @@ IncludeDirectives::angledIncludeInsertionOffset(FileID FID) const {
   // guarded header. If so the hint will be the location of the #define from the
   // guard.
   if (Hint.isInvalid()) {
-    const FileEntry *File = Sources.getFileEntryForID(FID);
-    HeaderToGuardMap::const_iterator GuardIt = HeaderToGuard.find(File);
-    if (GuardIt != HeaderToGuard.end()) {
-      // get the hash location from the #define
-      Hint = GuardIt->second;
-      // we want a blank line between the #define and the #include
+    Hint = findHeaderGuardDefine(FID, Sources, CI.getLangOpts());
+    // we want a blank line between the #define and the #include
+    if (Hint.isValid())
       NL_Flags = NL_PrependTwice;
-    }
   }
 
   // no hints, insertion is done after the file header
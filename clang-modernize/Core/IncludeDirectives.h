@@ -18,9 +18,11 @@
 
 #include "clang/Basic/SourceLocation.h"
 #include "clang/Tooling/Refactoring.h"
+#include "llvm/ADT/BitVector.h"
 #include "llvm/ADT/DenseMap.h"
-#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/StringMap.h"
 #include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Allocator.h"
 #include <vector>
 
 namespace clang {
@@ -32,6 +34,11 @@ class Preprocessor;
 /// This class should be created with a \c clang::CompilerInstance before the
 /// file is preprocessed in order to collect the inclusion information. It can
 /// be queried as long as the compiler instance is valid.
+///
+/// Most translation units never need an include to be added, so
+/// preprocessing only records the inclusion directives in a flat list. The
+/// include graph is built from it on the first query and header guards are
+/// only looked for in the files an include is inserted into.
 class IncludeDirectives {
 public:
   IncludeDirectives(clang::CompilerInstance &CI);
@@ -53,6 +60,10 @@ public:
 
   /// \brief Check if \p Include is included by \p File or any of the files
   /// \p File includes.
+  ///
+  /// Must only be called once the file has been preprocessed. The files
+  /// transitively included by \p File and the files including \p Include are
+  /// computed on the first query and reused by the following ones.
   bool hasInclude(const clang::FileEntry *File, llvm::StringRef Include) const;
 
 private:
@@ -90,25 +101,39 @@ private:
   // Associates files to their includes.
   typedef llvm::DenseMap<const clang::FileEntry *, EntryVec> FileToEntriesMap;
 
-  // Associates headers to their include guards if any. The location is the
-  // location of the hash from the #define.
-  typedef llvm::DenseMap<const clang::FileEntry *, clang::SourceLocation>
-  HeaderToGuardMap;
+  /// \brief An inclusion directive as seen by the preprocessor.
+  struct Inclusion {
+    Inclusion(clang::SourceLocation HashLoc, const clang::FileEntry *File,
+              llvm::StringRef FileName, bool Angled)
+        : HashLoc(HashLoc), File(File), FileName(FileName), Angled(Angled) {}
 
-  /// \brief Type used by \c lookForInclude() to keep track of the files that
-  /// have already been processed.
-  typedef llvm::SmallPtrSet<const clang::FileEntry *, 32> SeenFilesSet;
+    clang::SourceLocation HashLoc;
+    const clang::FileEntry *File;
+    /// \brief The file name as written, allocated in \c NameAllocator.
+    llvm::StringRef FileName;
+    bool Angled;
+  };
 
-  /// \brief Recursively look if an include is included by \p File or any of the
-  /// headers \p File includes.
-  ///
-  /// \param File The file where to start the search.
-  /// \param IncludeLocs These are the hash locations of the \#include
-  /// directives we are looking for.
-  /// \param Seen Used to avoid visiting a same file more than once during the
-  /// recursion.
-  bool lookForInclude(const clang::FileEntry *File,
-                      const LocationVec &IncludeLocs, SeenFilesSet &Seen) const;
+  /// \brief Record an inclusion directive seen by the preprocessor.
+  void addInclusion(clang::SourceLocation HashLoc, const clang::FileEntry *File,
+                    llvm::StringRef FileName, bool Angled);
+
+  /// \brief Build \c FileToEntries and \c IncludeAsWrittenToLocationsMap from
+  /// \c Inclusions, if not done yet.
+  void buildIncludeMaps() const;
+
+  /// \brief Give an index to each file of the include graph, for the bit
+  /// vectors of \c IncludeClosures and \c IncludersByName.
+  void indexFiles() const;
+
+  /// \brief Return the set of files \p File includes, directly or not, along
+  /// with \p File itself.
+  const llvm::BitVector &getIncludeClosure(const clang::FileEntry *File) const;
+
+  /// \brief Return the set of files containing one of the \#include
+  /// directives \p IncludeLocs.
+  const llvm::BitVector &getIncluders(llvm::StringRef Include,
+                                      const LocationVec &IncludeLocs) const;
 
   /// \brief Find the end of a file header and returns a pair (FileOffset,
   /// NewLineFlags).
@@ -120,8 +145,12 @@ private:
 
   /// \brief Finds the offset where an angled include should be added and
   /// returns a pair (FileOffset, NewLineFlags).
+  ///
+  /// The offset is only computed once per file.
   std::pair<unsigned, unsigned>
   angledIncludeInsertionOffset(clang::FileID FID) const;
+  std::pair<unsigned, unsigned>
+  computeAngledIncludeInsertionOffset(clang::FileID FID) const;
 
   /// \brief Find the location of an include directive that can be used to
   /// insert an inclusion after.
@@ -131,11 +160,22 @@ private:
 
   clang::CompilerInstance &CI;
   clang::SourceManager &Sources;
-  FileToEntriesMap FileToEntries;
+  std::vector<Inclusion> Inclusions;
+  llvm::BumpPtrAllocator NameAllocator;
+
+  // Lazily computed data, see buildIncludeMaps(), hasInclude() and
+  // angledIncludeInsertionOffset().
+  mutable bool IncludeMapsBuilt;
+  mutable FileToEntriesMap FileToEntries;
   // maps include filename as written in the source code to the source locations
   // where it appears
-  llvm::StringMap<LocationVec> IncludeAsWrittenToLocationsMap;
-  HeaderToGuardMap HeaderToGuard;
+  mutable llvm::StringMap<LocationVec> IncludeAsWrittenToLocationsMap;
+  mutable llvm::DenseMap<const clang::FileEntry *, unsigned> FileIndexes;
+  mutable llvm::DenseMap<const clang::FileEntry *, llvm::BitVector>
+  IncludeClosures;
+  mutable llvm::StringMap<llvm::BitVector> IncludersByName;
+  mutable llvm::DenseMap<clang::FileID, std::pair<unsigned, unsigned> >
+  InsertionOffsets;
 };
 
 #endif // CLANG_MODERNIZE_INCLUDE_DIRECTIVES_H
@@ -26,32 +26,15 @@ using namespace llvm;
 typedef SmallString<64> PathString;
 
 namespace {
-/// \brief Helper function to determine whether a file has the same path
-/// prefix as \a Path.
+/// \brief Helper function returning the key used in the path trie for the
+/// path component \a Component.
 ///
-/// \a Path must be an absolute path.
-bool fileHasPathPrefix(StringRef File, StringRef Path) {
-  // Converts File to its absolute path.
-  PathString AbsoluteFile = File;
-  sys::fs::make_absolute(AbsoluteFile);
-
-  // Convert path strings to sys::path to iterate over each of its directories.
-  sys::path::const_iterator FileI = sys::path::begin(AbsoluteFile),
-                            FileE = sys::path::end(AbsoluteFile),
-                            PathI = sys::path::begin(Path),
-                            PathE = sys::path::end(Path);
-  while (FileI != FileE && PathI != PathE) {
-    // If the strings aren't equal then the two paths aren't contained within
-    // each other.
-    bool IsSeparator = ((FileI->size() == 1) && (PathI->size() == 1) &&
-                        sys::path::is_separator((*FileI)[0]) &&
-                        sys::path::is_separator((*PathI)[0]));
-    if (!FileI->equals(*PathI) && !IsSeparator)
-      return false;
-    ++FileI;
-    ++PathI;
-  }
-  return true;
+/// Root directory components consisting of a single separator compare equal
+/// regardless of which separator was used.
+StringRef getComponentKey(StringRef Component) {
+  if (Component.size() == 1 && sys::path::is_separator(Component[0]))
+    return "/";
+  return Component;
 }
 
 /// \brief Helper function for removing relative operators from a given
@@ -79,11 +62,13 @@ std::string removeRelativeOperators(StringRef Path) {
   }
   return NewPath.str();
 }
+} // end anonymous namespace
 
-/// \brief Helper function to tokenize a string of paths and populate
-/// the vector.
-std::error_code parseCLInput(StringRef Line, std::vector<std::string> &List,
-                             StringRef Separator) {
+IncludeExcludeInfo::IncludeExcludeInfo() : Nodes(1), NumIncludes(0) {}
+
+std::error_code IncludeExcludeInfo::parseList(StringRef Line,
+                                              StringRef Separator,
+                                              bool Exclude) {
   SmallVector<StringRef, 32> Tokens;
   Line.split(Tokens, Separator, /*MaxSplit=*/ -1, /*KeepEmpty=*/ false);
   for (SmallVectorImpl<StringRef>::iterator I = Tokens.begin(),
@@ -95,26 +80,76 @@ std::error_code parseCLInput(StringRef Line, std::vector<std::string> &List,
       return Err;
     // Remove relative operators from the path.
     std::string AbsPath = removeRelativeOperators(Path);
-    // Add only non-empty paths to the list.
+    // Add only non-empty paths to the trie.
     if (!AbsPath.empty())
-      List.push_back(AbsPath);
+      addPath(AbsPath, Exclude);
     else
       llvm::errs() << "Unable to parse input path: " << *I << "\n";
-
-    llvm::errs() << "Parse: " <<List.back() << "\n";
   }
   return std::error_code();
 }
-} // end anonymous namespace
+
+void IncludeExcludeInfo::addPath(StringRef Path, bool Exclude) {
+  unsigned Node = 0;
+  for (sys::path::const_iterator I = sys::path::begin(Path),
+                                 E = sys::path::end(Path);
+       I != E; ++I) {
+    StringMap<unsigned>::iterator Child =
+        Nodes[Node].Children.find(getComponentKey(*I));
+    if (Child != Nodes[Node].Children.end()) {
+      Node = Child->second;
+      continue;
+    }
+    // Nodes may be reallocated by push_back() so look the parent up again
+    // afterwards.
+    unsigned NewNode = Nodes.size();
+    Nodes.push_back(PathNode());
+    Nodes[Node].Children[getComponentKey(*I)] = NewNode;
+    Node = NewNode;
+  }
+
+  if (Exclude) {
+    Nodes[Node].Excluded = true;
+  } else if (!Nodes[Node].Included) {
+    Nodes[Node].Included = true;
+    ++NumIncludes;
+  }
+}
+
+bool IncludeExcludeInfo::lookup(StringRef FilePath,
+                                bool &InIncludeList) const {
+  InIncludeList = false;
+
+  // Converts FilePath to its absolute path.
+  PathString AbsoluteFile = FilePath;
+  sys::fs::make_absolute(AbsoluteFile);
+
+  unsigned Node = 0;
+  for (sys::path::const_iterator I = sys::path::begin(AbsoluteFile),
+                                 E = sys::path::end(AbsoluteFile);
+       I != E; ++I) {
+    StringMap<unsigned>::const_iterator Child =
+        Nodes[Node].Children.find(getComponentKey(*I));
+    if (Child == Nodes[Node].Children.end())
+      return false;
+    Node = Child->second;
+
+    if (Nodes[Node].Excluded)
+      return true;
+    if (Nodes[Node].Included)
+      InIncludeList = true;
+  }
+  return false;
+}
 
 std::error_code
 IncludeExcludeInfo::readListFromString(StringRef IncludeString,
                                        StringRef ExcludeString) {
-  if (std::error_code Err = parseCLInput(IncludeString, IncludeList,
-                                         /*Separator=*/","))
+  if (std::error_code Err = parseList(IncludeString, /*Separator=*/",",
+                                      /*Exclude=*/false))
     return Err;
-  if (std::error_code Err = parseCLInput(ExcludeString, ExcludeList,
-                                         /*Separator=*/","))
+  if (std::error_code Err = parseList(ExcludeString, /*Separator=*/",",
+                                      /*Exclude=*/true))
     return Err;
   return std::error_code();
 }
@@ -129,9 +164,9 @@ IncludeExcludeInfo::readListFromFile(StringRef IncludeListFile,
       errs() << "Unable to read from include file.\n";
       return Err;
     }
-    if (std::error_code Err =
-            parseCLInput(FileBuf.get()->getBuffer(), IncludeList,
-                         /*Separator=*/"\n"))
+    if (std::error_code Err = parseList(FileBuf.get()->getBuffer(),
+                                        /*Separator=*/"\n",
+                                        /*Exclude=*/false))
       return Err;
   }
   if (!ExcludeListFile.empty()) {
@@ -141,39 +176,24 @@ IncludeExcludeInfo::readListFromFile(StringRef IncludeListFile,
       errs() << "Unable to read from exclude file.\n";
       return Err;
     }
-    if (std::error_code Err =
-            parseCLInput(FileBuf.get()->getBuffer(), ExcludeList,
-                         /*Separator=*/"\n"))
+    if (std::error_code Err = parseList(FileBuf.get()->getBuffer(),
+                                        /*Separator=*/"\n",
+                                        /*Exclude=*/true))
       return Err;
   }
   return std::error_code();
 }
 
 bool IncludeExcludeInfo::isFileIncluded(StringRef FilePath) const {
-  bool InIncludeList = false;
-
-  for (std::vector<std::string>::const_iterator I = IncludeList.begin(),
-                                                E = IncludeList.end();
-       I != E; ++I)
-    if ((InIncludeList = fileHasPathPrefix(FilePath, *I)))
-      break;
-
-  // If file is not in the list of included paths then it is not necessary
-  // to check the excluded path list.
-  if (!InIncludeList)
-    return false;
+  bool InIncludeList;
+  bool Excluded = lookup(FilePath, InIncludeList);
 
   // If the file is in the included list but not is not explicitly excluded,
   // then it is safe to transform.
-  return !isFileExplicitlyExcluded(FilePath);
+  return InIncludeList && !Excluded;
 }
 
 bool IncludeExcludeInfo::isFileExplicitlyExcluded(StringRef FilePath) const {
-  for (std::vector<std::string>::const_iterator I = ExcludeList.begin(),
-                                                E = ExcludeList.end();
-      I != E; ++I)
-    if (fileHasPathPrefix(FilePath, *I))
-      return true;
-
-  return false;
+  bool InIncludeList;
+  return lookup(FilePath, InIncludeList);
 }
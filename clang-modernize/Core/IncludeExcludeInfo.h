@@ -16,14 +16,21 @@
 #ifndef CLANG_MODERNIZE_INCLUDEEXCLUDEINFO_H
 #define CLANG_MODERNIZE_INCLUDEEXCLUDEINFO_H
 
+#include "llvm/ADT/StringMap.h"
 #include "llvm/ADT/StringRef.h"
 #include <system_error>
 #include <vector>
 
 /// \brief Class encapsulating the handling of include and exclude paths
 /// provided by the user through command line options.
+///
+/// The include and exclude paths are stored in a trie keyed by path
+/// component so that a file is matched against all of them in a single walk
+/// over its own path components, independent of the number of paths given.
 class IncludeExcludeInfo {
 public:
+  IncludeExcludeInfo();
+
   /// \brief Read and parse a comma-separated lists of paths from
   /// \a IncludeString and \a ExcludeString.
   ///
@@ -52,11 +59,41 @@ public:
   bool isFileExplicitlyExcluded(llvm::StringRef FilePath) const;
 
   /// \brief Determine if a list of include paths was provided.
-  bool isIncludeListEmpty() const { return IncludeList.empty(); }
+  bool isIncludeListEmpty() const { return NumIncludes == 0; }
 
 private:
-  std::vector<std::string> IncludeList;
-  std::vector<std::string> ExcludeList;
+  /// \brief A node of the path trie, one per path component.
+  struct PathNode {
+    PathNode() : Included(false), Excluded(false) {}
+
+    /// \brief Indices into \c Nodes of the nodes for the next component.
+    llvm::StringMap<unsigned> Children;
+
+    /// \brief True if the path ending at this node was in the include list.
+    bool Included;
+
+    /// \brief True if the path ending at this node was in the exclude list.
+    bool Excluded;
+  };
+
+  /// \brief Tokenize a list of paths separated by \a Separator and add them
+  /// to the trie.
+  std::error_code parseList(llvm::StringRef Line, llvm::StringRef Separator,
+                            bool Exclude);
+
+  /// \brief Add the absolute path \a Path to the trie.
+  void addPath(llvm::StringRef Path, bool Exclude);
+
+  /// \brief Walk the trie along the components of \a FilePath.
+  ///
+  /// Sets \a InIncludeList if an include path is a prefix of \a FilePath and
+  /// returns true if an exclude path is a prefix of \a FilePath. The walk
+  /// stops at the first exclude path found.
+  bool lookup(llvm::StringRef FilePath, bool &InIncludeList) const;
+
+  /// \brief The trie nodes. The root is always at index 0.
+  std::vector<PathNode> Nodes;
+  unsigned NumIncludes;
 };
 
 #endif // CLANG_MODERNIZE_INCLUDEEXCLUDEINFO_H
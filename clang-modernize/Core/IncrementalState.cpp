@@ -0,0 +1,179 @@
+//===-- Core/IncrementalState.cpp - Incremental run state -----------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// \brief This file provides the implementation of the IncrementalState class.
+///
+/// The state file starts with a version line, followed by one line per
+/// source holding its hash and its key, the fields separated by tabs. The
+/// inputs of the source follow, one per line, each indented by a tab.
+///
+//===----------------------------------------------------------------------===//
+
+#include "IncrementalState.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace llvm;
+
+static const char StateHeader[] = "clang-modernize-incremental-state 1";
+
+std::error_code IncrementalState::load(StringRef File) {
+  ErrorOr<std::unique_ptr<MemoryBuffer> > Buffer = MemoryBuffer::getFile(File);
+  if (!Buffer) {
+    if (Buffer.getError() == std::errc::no_such_file_or_directory)
+      return std::error_code();
+    return Buffer.getError();
+  }
+
+  SmallVector<StringRef, 64> Lines;
+  Buffer.get()->getBuffer().split(Lines, "\n", /*MaxSplit=*/-1,
+                                  /*KeepEmpty=*/false);
+  if (Lines.empty() || Lines.front() != StateHeader)
+    return std::make_error_code(std::errc::invalid_argument);
+
+  Entry *Current = nullptr;
+  for (unsigned I = 1, E = Lines.size(); I != E; ++I) {
+    StringRef Line = Lines[I];
+    if (Line.startswith("\t")) {
+      if (!Current)
+        return std::make_error_code(std::errc::invalid_argument);
+      Current->Inputs.push_back(Line.substr(1));
+      continue;
+    }
+
+    std::pair<StringRef, StringRef> HashAndKey = Line.split('\t');
+    if (HashAndKey.second.empty())
+      return std::make_error_code(std::errc::invalid_argument);
+    Current = &Entries[HashAndKey.second];
+    Current->Hash = HashAndKey.first;
+    Current->Inputs.clear();
+  }
+  return std::error_code();
+}
+
+std::error_code IncrementalState::save(StringRef File) const {
+  int FD;
+  SmallString<128> TempFile;
+  if (std::error_code EC =
+          sys::fs::createUniqueFile(File + "-%%%%%%%%.tmp", FD, TempFile))
+    return EC;
+
+  {
+    raw_fd_ostream OS(FD, /*shouldClose=*/true);
+    OS << StateHeader << "\n";
+    for (std::map<std::string, Entry>::const_iterator I = Entries.begin(),
+                                                      E = Entries.end();
+         I != E; ++I) {
+      OS << I->second.Hash << "\t" << I->first << "\n";
+      for (std::vector<std::string>::const_iterator
+               InputI = I->second.Inputs.begin(),
+               InputE = I->second.Inputs.end();
+           InputI != InputE; ++InputI)
+        OS << "\t" << *InputI << "\n";
+    }
+    OS.close();
+    if (OS.has_error()) {
+      OS.clear_error();
+      sys::fs::remove(TempFile);
+      return std::make_error_code(std::errc::io_error);
+    }
+  }
+
+  if (std::error_code EC = sys::fs::rename(TempFile, File)) {
+    sys::fs::remove(TempFile);
+    return EC;
+  }
+  return std::error_code();
+}
+
+bool IncrementalState::isUnchanged(StringRef Source, StringRef TransformName,
+                                   StringRef Config, StringRef Command) {
+  std::map<std::string, Entry>::const_iterator I =
+      Entries.find(getKey(Source, TransformName, Config));
+  if (I == Entries.end())
+    return false;
+
+  std::string Hash = hashInputs(Command, I->second.Inputs);
+  return !Hash.empty() && Hash == I->second.Hash;
+}
+
+void IncrementalState::record(StringRef Source, StringRef TransformName,
+                              StringRef Config, StringRef Command,
+                              const std::vector<std::string> &Inputs,
+                              bool Changed) {
+  std::string Key = getKey(Source, TransformName, Config);
+  std::string Hash;
+  if (!Changed)
+    Hash = hashInputs(Command, Inputs);
+
+  // Changed sources, and those whose inputs vanished already, have to be
+  // transformed again by the next run.
+  if (Hash.empty()) {
+    Entries.erase(Key);
+    return;
+  }
+
+  Entry &E = Entries[Key];
+  E.Hash = Hash;
+  E.Inputs = Inputs;
+}
+
+std::string
+IncrementalState::hashInputs(StringRef Command,
+                             const std::vector<std::string> &Inputs) {
+  MD5 Hash;
+  Hash.update(Command);
+  for (std::vector<std::string>::const_iterator I = Inputs.begin(),
+                                                E = Inputs.end();
+       I != E; ++I) {
+    StringRef FileHash = hashFile(*I);
+    if (FileHash.empty())
+      return std::string();
+    // Separate the fields so that moving bytes from one to the next changes
+    // the hash.
+    Hash.update(StringRef("", 1));
+    Hash.update(*I);
+    Hash.update(StringRef("", 1));
+    Hash.update(FileHash);
+  }
+
+  MD5::MD5Result Result;
+  Hash.final(Result);
+  SmallString<32> Str;
+  MD5::stringifyResult(Result, Str);
+  return Str.str();
+}
+
+StringRef IncrementalState::hashFile(StringRef File) {
+  StringMap<std::string>::iterator I = FileHashes.find(File);
+  if (I != FileHashes.end())
+    return I->getValue();
+
+  std::string &FileHash = FileHashes[File];
+  ErrorOr<std::unique_ptr<MemoryBuffer> > Buffer = MemoryBuffer::getFile(File);
+  if (Buffer) {
+    MD5 Hash;
+    Hash.update(Buffer.get()->getBuffer());
+    MD5::MD5Result Result;
+    Hash.final(Result);
+    SmallString<32> Str;
+    MD5::stringifyResult(Result, Str);
+    FileHash = Str.str();
+  }
+  return FileHash;
+}
+
+std::string IncrementalState::getKey(StringRef Source, StringRef TransformName,
+                                     StringRef Config) {
+  return (TransformName + "\t" + Config + "\t" + Source).str();
+}
@@ -0,0 +1,92 @@
+//===-- Core/IncrementalState.h - Incremental run state ---------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// \brief This file provides the definition of the IncrementalState class
+/// used to skip sources that needed no changes in a previous run.
+///
+//===----------------------------------------------------------------------===//
+
+#ifndef CLANG_MODERNIZE_INCREMENTALSTATE_H
+#define CLANG_MODERNIZE_INCREMENTALSTATE_H
+
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include <map>
+#include <string>
+#include <system_error>
+#include <vector>
+
+/// \brief Remembers the sources a transform made no changes to, along with a
+/// hash of their inputs, across runs of the Modernizer.
+///
+/// Entries are keyed by source, transform and a configuration string holding
+/// the options affecting the result of the transform, like the risk level. A
+/// source can be skipped as long as its compile command and the contents of
+/// all the files it read stay the same.
+class IncrementalState {
+public:
+  /// \brief Read the state saved by a previous run to \p File.
+  ///
+  /// A missing file leaves the state empty and is not an error.
+  std::error_code load(llvm::StringRef File);
+
+  /// \brief Write the state to \p File.
+  ///
+  /// The state is written to a temporary file first, which then replaces
+  /// \p File, so an interrupted run never leaves a truncated state behind.
+  std::error_code save(llvm::StringRef File) const;
+
+  /// \brief Determine if transform \p TransformName made no changes to
+  /// \p Source in a run with the same \p Config and \p Command, and if none of
+  /// the files read by \p Source changed since.
+  bool isUnchanged(llvm::StringRef Source, llvm::StringRef TransformName,
+                   llvm::StringRef Config, llvm::StringRef Command);
+
+  /// \brief Record the result of transform \p TransformName on \p Source.
+  ///
+  /// If \p Changed is false, \p Source can be skipped by later runs until
+  /// \p Command or one of \p Inputs changes. Otherwise any previous entry for
+  /// \p Source is dropped.
+  void record(llvm::StringRef Source, llvm::StringRef TransformName,
+              llvm::StringRef Config, llvm::StringRef Command,
+              const std::vector<std::string> &Inputs, bool Changed);
+
+  /// \brief Forget the hashes of the files read so far.
+  ///
+  /// File hashes are computed once and reused by all sources including the
+  /// file. This must be called once files have been modified, e.g. after
+  /// applying replacements.
+  void invalidateFileHashes() { FileHashes.clear(); }
+
+private:
+  struct Entry {
+    std::string Hash;
+    std::vector<std::string> Inputs;
+  };
+
+  /// \brief Hash \p Command and the paths and contents of \p Inputs.
+  ///
+  /// \returns an empty string if one of the inputs can't be read.
+  std::string hashInputs(llvm::StringRef Command,
+                         const std::vector<std::string> &Inputs);
+
+  /// \brief Hash the contents of \p File, or return an empty string if it
+  /// can't be read.
+  llvm::StringRef hashFile(llvm::StringRef File);
+
+  static std::string getKey(llvm::StringRef Source,
+                            llvm::StringRef TransformName,
+                            llvm::StringRef Config);
+
+  std::map<std::string, Entry> Entries;
+  llvm::StringMap<std::string> FileHashes;
+};
+
+#endif // CLANG_MODERNIZE_INCREMENTALSTATE_H
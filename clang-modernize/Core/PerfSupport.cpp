@@ -13,21 +13,40 @@
 //===----------------------------------------------------------------------===//
 
 #include "PerfSupport.h"
+#include "llvm/ADT/SmallString.h"
 #include "llvm/Support/FileSystem.h"
 #include "llvm/Support/Format.h"
 #include "llvm/Support/Path.h"
 #include "llvm/Support/Process.h"
 #include "llvm/Support/raw_ostream.h"
 
-void collectSourcePerfData(const Transform &T, SourcePerfData &Data) {
+const char *const AllSourcesPerfKey = "<all sources>";
+
+PerfItem::PerfItem(const llvm::StringRef Label, const llvm::StringRef Phase,
+                   const llvm::TimeRecord &Time, size_t Memory,
+                   bool UseWallTime)
+    : Label(Label), Phase(Phase),
+      Duration((UseWallTime ? Time.getWallTime() : Time.getProcessTime()) *
+               1000.0),
+      Wall(Time.getWallTime() * 1000.0), User(Time.getUserTime() * 1000.0),
+      System(Time.getSystemTime() * 1000.0), Memory(Memory) {}
+
+void collectSourcePerfData(const Transform &T, SourcePerfData &Data,
+                           bool UseWallTime) {
   for (Transform::TimingVec::const_iterator I = T.timing_begin(),
                                             E = T.timing_end();
        I != E; ++I) {
     SourcePerfData::iterator DataI = Data.insert(
         SourcePerfData::value_type(I->first, std::vector<PerfItem>())).first;
-    DataI->second
-        .push_back(PerfItem(T.getName(), I->second.getProcessTime() * 1000.0));
+    DataI->second.push_back(
+        PerfItem(T.getName(), "total", I->second, 0, UseWallTime));
   }
+
+  for (Transform::PhaseTimingVec::const_iterator I = T.phase_timing_begin(),
+                                                 E = T.phase_timing_end();
+       I != E; ++I)
+    Data[I->Source].push_back(PerfItem(T.getName(), I->Phase, I->Duration,
+                                       I->MemoryInUse, UseWallTime));
 }
 
 void writePerfDataJSON(
@@ -36,22 +55,24 @@ void writePerfDataJSON(
   // Create directory path if it doesn't exist
   llvm::sys::fs::create_directories(DirectoryName);
 
-  // Get PID and current time.
-  // FIXME: id_type on Windows is NOT a process id despite the function name.
-  // Need to call GetProcessId() providing it what get_id() returns. For now
-  // disabling PID-based file names until this is fixed properly.
-  //llvm::sys::self_process *SP = llvm::sys::process::get_self();
-  //id_type Pid = SP->get_id();
-  unsigned Pid = 0;
+  // Name the file after the current time. The random suffix keeps runs
+  // started within the same second, possibly from different machines writing
+  // to a shared directory, from overwriting each other's results.
   llvm::TimeRecord T = llvm::TimeRecord::getCurrentTime();
+  llvm::SmallString<128> Model(DirectoryName);
+  llvm::sys::path::append(Model, llvm::Twine(static_cast<int>(
+                                     T.getWallTime())) + "_%%%%%%%%.json");
 
-  std::string FileName;
-  llvm::raw_string_ostream SS(FileName);
-  SS << DirectoryName << "/" << static_cast<int>(T.getWallTime()) << "_" << Pid
-     << ".json";
+  int FD;
+  llvm::SmallString<128> FileName;
+  if (std::error_code EC =
+          llvm::sys::fs::createUniqueFile(Model, FD, FileName)) {
+    llvm::errs() << "Error creating performance data file in "
+                 << DirectoryName << ": " << EC.message() << "\n";
+    return;
+  }
 
-  std::error_code EC;
-  llvm::raw_fd_ostream FileStream(SS.str(), EC, llvm::sys::fs::F_Text);
+  llvm::raw_fd_ostream FileStream(FD, /*shouldClose=*/true);
   FileStream << "{\n";
   FileStream << "  \"Sources\" : [\n";
   for (SourcePerfData::const_iterator I = TimingResults.begin(),
@@ -62,7 +83,7 @@ void writePerfDataJSON(
       FileStream << ",\n";
 
     FileStream << "    {\n";
-    FileStream << "      \"Source \" : \"" << I->first << "\",\n";
+    FileStream << "      \"Source\" : \"" << I->first << "\",\n";
     FileStream << "      \"Data\" : [\n";
     for (std::vector<PerfItem>::const_iterator IE = I->second.begin(),
                                                EE = I->second.end();
@@ -74,8 +95,16 @@ void writePerfDataJSON(
 
       FileStream << "        {\n";
       FileStream << "          \"TimerId\" : \"" << IE->Label << "\",\n";
+      FileStream << "          \"Phase\" : \"" << IE->Phase << "\",\n";
       FileStream << "          \"Time\" : " << llvm::format("%.2f", IE->Duration)
-                 << "\n";
+                 << ",\n";
+      FileStream << "          \"Wall\" : " << llvm::format("%.2f", IE->Wall)
+                 << ",\n";
+      FileStream << "          \"User\" : " << llvm::format("%.2f", IE->User)
+                 << ",\n";
+      FileStream << "          \"System\" : "
+                 << llvm::format("%.2f", IE->System) << ",\n";
+      FileStream << "          \"Memory\" : " << uint64_t(IE->Memory) << "\n";
 
       FileStream << "        }";
 
@@ -94,8 +123,10 @@ void dumpPerfData(const SourcePerfData &Data) {
     for (std::vector<PerfItem>::const_iterator VecI = I->second.begin(),
                                                VecE = I->second.end();
          VecI != VecE; ++VecI) {
-      llvm::errs() << "  " << VecI->Label << ": "
-                   << llvm::format("%.1f", VecI->Duration) << "ms\n";
+      llvm::errs() << "  " << VecI->Label;
+      if (VecI->Phase != "total")
+        llvm::errs() << " (" << VecI->Phase << ")";
+      llvm::errs() << ": " << llvm::format("%.1f", VecI->Duration) << "ms\n";
     }
   }
 }
@@ -23,33 +23,59 @@
 
 /// \brief A single piece of performance data: a duration in milliseconds and a
 /// label for that duration.
+///
+/// Items recorded for a phase of the work done for a source also carry the
+/// name of the phase and a breakdown of the duration. Items covering all the
+/// work done by a transform for a source belong to the "total" phase.
 struct PerfItem {
-  PerfItem(const llvm::StringRef Label, float Duration)
-      : Label(Label), Duration(Duration) {}
+  /// Creates an item for \p Phase lasting \p Time. \p UseWallTime selects
+  /// the time used as Duration, see collectSourcePerfData().
+  PerfItem(const llvm::StringRef Label, const llvm::StringRef Phase,
+           const llvm::TimeRecord &Time, size_t Memory, bool UseWallTime);
 
   /// Label for this performance measurement.
   std::string Label;
 
+  /// Phase measured, e.g. "parse", "match", "serialize", "apply" or "total".
+  std::string Phase;
+
   /// Duration in milliseconds.
   float Duration;
+
+  /// Wall, user and system time in milliseconds.
+  float Wall, User, System;
+
+  /// Bytes of heap memory in use at the end of the phase, 0 if unknown.
+  size_t Memory;
 };
 
 /// Maps source file names to a vector of durations/labels.
 typedef std::map<std::string, std::vector<PerfItem> > SourcePerfData;
 
 /// Extracts durations collected by a Transform for all sources and adds them
-/// to a SourcePerfData map where data is organized by source file.
-extern void collectSourcePerfData(const Transform &T, SourcePerfData &Data);
+/// to a SourcePerfData map where data is organized by source file. Durations of the
+/// phases of each source are added after the totals of the transform.
+///
+/// Durations are process times unless \p UseWallTime is set. Process times
+/// include all threads, so wall times should be used when the sources were
+/// transformed in parallel.
+extern void collectSourcePerfData(const Transform &T, SourcePerfData &Data,
+                                  bool UseWallTime = false);
 
 /// Write timing results to a JSON formatted file.
 ///
-/// File is placed in the directory given by \p DirectoryName. File is named in
-/// a unique way with time and process ID to avoid naming collisions with
-/// existing files or files being generated by other migrator processes.
+/// File is placed in the directory given by \p DirectoryName. File is named
+/// after the current time followed by a random suffix and created exclusively,
+/// so it never collides with existing files or files being generated by other
+/// migrator processes.
 void writePerfDataJSON(
     const llvm::StringRef DirectoryName,
     const SourcePerfData &TimingResults);
 
+/// Name under which data not belonging to a single source, like the time
+/// taken to apply the replacements of a transform, is stored.
+extern const char *const AllSourcesPerfKey;
+
 /// Dump a SourcePerfData map to llvm::errs().
 extern void dumpPerfData(const SourcePerfData &Data);
 
@@ -20,6 +20,8 @@
 #include "clang/Frontend/CompilerInstance.h"
 #include "clang/Tooling/Tooling.h"
 #include "llvm/ADT/STLExtras.h"
+#include "llvm/Support/Process.h"
+#include <algorithm>
 
 template class llvm::Registry<TransformFactory>;
 
@@ -32,6 +34,23 @@ namespace {
 using namespace tooling;
 using namespace ast_matchers;
 
+/// \brief ASTConsumer that tells a Transform when parsing of a translation
+/// unit is done before handing it over to the MatchFinder's consumer.
+class EndParseConsumer : public ASTConsumer {
+public:
+  EndParseConsumer(std::unique_ptr<ASTConsumer> Consumer, Transform &Owner)
+      : Consumer(std::move(Consumer)), Owner(Owner) {}
+
+  void HandleTranslationUnit(ASTContext &Context) override {
+    Owner.handleEndParse();
+    Consumer->HandleTranslationUnit(Context);
+  }
+
+private:
+  std::unique_ptr<ASTConsumer> Consumer;
+  Transform &Owner;
+};
+
 /// \brief Custom FrontendActionFactory to produce FrontendActions that simply
 /// forward (Begin|End)SourceFileAction calls to a given Transform.
 class ActionFactory : public clang::tooling::FrontendActionFactory {
@@ -51,7 +70,8 @@ private:
 
     std::unique_ptr<ASTConsumer> CreateASTConsumer(CompilerInstance &,
                                                    StringRef) override {
-      return Finder.newASTConsumer();
+      return llvm::make_unique<EndParseConsumer>(Finder.newASTConsumer(),
+                                                 Owner);
     }
 
     bool BeginSourceFileAction(CompilerInstance &CI,
@@ -78,7 +98,8 @@ private:
 } // namespace
 
 Transform::Transform(llvm::StringRef Name, const TransformOptions &Options)
-    : Name(Name), GlobalOptions(Options) {
+    : Name(Name), GlobalOptions(Options), CurrentSM(nullptr),
+      MatcherLock(nullptr) {
   Reset();
 }
 
@@ -93,23 +114,88 @@ bool Transform::isFileModifiable(const SourceManager &SM,
   if (!FE)
     return false;
 
-  return GlobalOptions.ModifiableFiles.isFileIncluded(FE->getName());
+  llvm::DenseMap<const FileEntry *, bool>::iterator I =
+      ModifiableFileCache.find(FE);
+  if (I != ModifiableFileCache.end())
+    return I->second;
+
+  bool Modifiable = GlobalOptions.ModifiableFiles.isFileIncluded(FE->getName());
+  ModifiableFileCache[FE] = Modifiable;
+  return Modifiable;
 }
 
 bool Transform::handleBeginSource(CompilerInstance &CI, StringRef Filename) {
   CurrentSource = Filename;
+  ModifiableFileCache.clear();
+  CurrentSM = CI.hasSourceManager() ? &CI.getSourceManager() : nullptr;
 
   if (Options().EnableTiming) {
     Timings.push_back(std::make_pair(Filename.str(), llvm::TimeRecord()));
     Timings.back().second -= llvm::TimeRecord::getCurrentTime(true);
+    PhaseStart = Timings.back().second;
   }
+
+  if (MatcherLock)
+    MatcherLock->unlock();
   return true;
 }
 
-void Transform::handleEndSource() {
-  CurrentSource.clear();
+void Transform::handleEndParse() {
+  if (MatcherLock && !MatcherLock->owns_lock())
+    MatcherLock->lock();
   if (Options().EnableTiming)
+    endPhase("parse");
+}
+
+void Transform::handleEndSource() {
+  // The source may have failed to parse before handleEndParse().
+  if (MatcherLock && !MatcherLock->owns_lock())
+    MatcherLock->lock();
+  if (Options().EnableTiming) {
+    endPhase("match");
     Timings.back().second += llvm::TimeRecord::getCurrentTime(false);
+  }
+
+  if (Options().RecordInputs && CurrentSM) {
+    // Paths are made absolute here since the current directory is the one of
+    // the compile command only while the source is being transformed.
+    SourceInputs Record;
+    Record.Source = tooling::getAbsolutePath(CurrentSource);
+    for (SourceManager::fileinfo_iterator I = CurrentSM->fileinfo_begin(),
+                                          E = CurrentSM->fileinfo_end();
+         I != E; ++I)
+      Record.Files.push_back(tooling::getAbsolutePath(I->first->getName()));
+    std::sort(Record.Files.begin(), Record.Files.end());
+    TUReplacementsMap::const_iterator TU = Replacements.find(CurrentSource);
+    if (TU != Replacements.end()) {
+      const std::vector<tooling::Replacement> &TUReplacements =
+          TU->getValue().Replacements;
+      for (std::vector<tooling::Replacement>::const_iterator
+               I = TUReplacements.begin(),
+               E = TUReplacements.end();
+           I != E; ++I)
+        Record.ChangedFiles.push_back(
+            tooling::getAbsolutePath(I->getFilePath()));
+      std::sort(Record.ChangedFiles.begin(), Record.ChangedFiles.end());
+      Record.ChangedFiles.erase(std::unique(Record.ChangedFiles.begin(),
+                                            Record.ChangedFiles.end()),
+                                Record.ChangedFiles.end());
+    }
+    Inputs.push_back(std::move(Record));
+  }
+  CurrentSM = nullptr;
+  CurrentSource.clear();
+}
+
+void Transform::endPhase(llvm::StringRef Phase) {
+  llvm::TimeRecord Now = llvm::TimeRecord::getCurrentTime(false);
+  llvm::TimeRecord Duration = Now;
+  // PhaseStart holds the negated start time, as Timings does.
+  Duration += PhaseStart;
+  PhaseTimings.push_back(PhaseTiming(CurrentSource, Phase, Duration,
+                                     llvm::sys::Process::GetMallocUsage()));
+  PhaseStart = llvm::TimeRecord();
+  PhaseStart -= Now;
 }
 
 void Transform::addTiming(llvm::StringRef Label, llvm::TimeRecord Duration) {
@@ -129,6 +215,27 @@ Transform::addReplacementForCurrentTU(const clang::tooling::Replacement &R) {
   return true;
 }
 
+void Transform::merge(const Transform &Other) {
+  for (TUReplacementsMap::const_iterator I = Other.Replacements.begin(),
+                                         E = Other.Replacements.end();
+       I != E; ++I) {
+    TranslationUnitReplacements &TU = Replacements[I->getKey()];
+    if (TU.MainSourceFile.empty())
+      TU.MainSourceFile = I->getValue().MainSourceFile;
+    TU.Replacements.insert(TU.Replacements.end(),
+                           I->getValue().Replacements.begin(),
+                           I->getValue().Replacements.end());
+  }
+
+  Timings.insert(Timings.end(), Other.Timings.begin(), Other.Timings.end());
+  PhaseTimings.insert(PhaseTimings.end(), Other.PhaseTimings.begin(),
+                      Other.PhaseTimings.end());
+  Inputs.insert(Inputs.end(), Other.Inputs.begin(), Other.Inputs.end());
+  AcceptedChanges += Other.AcceptedChanges;
+  RejectedChanges += Other.RejectedChanges;
+  DeferredChanges += Other.DeferredChanges;
+}
+
 std::unique_ptr<FrontendActionFactory>
 Transform::createActionFactory(MatchFinder &Finder) {
   return llvm::make_unique<ActionFactory>(Finder, /*Owner=*/*this);
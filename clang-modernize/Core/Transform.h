@@ -18,9 +18,11 @@
 
 #include "Core/IncludeExcludeInfo.h"
 #include "Core/Refactoring.h"
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Registry.h"
 #include "llvm/Support/Timer.h"
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -40,6 +42,7 @@ enum RiskLevel {
 // Forward declarations
 namespace clang {
 class CompilerInstance;
+class FileEntry;
 namespace tooling {
 class CompilationDatabase;
 class FrontendActionFactory;
@@ -59,6 +62,9 @@ extern llvm::cl::OptionCategory TransformsOptionsCategory;
 
 /// \brief Container for global options affecting all transforms.
 struct TransformOptions {
+  TransformOptions()
+      : EnableTiming(false), MaxRiskLevel(RL_Safe), RecordInputs(false) {}
+
   /// \brief Enable the use of performance timers.
   bool EnableTiming;
 
@@ -68,6 +74,9 @@ struct TransformOptions {
 
   /// \brief Maximum allowed level of risk.
   RiskLevel MaxRiskLevel;
+
+  /// \brief Record the files read while transforming each source.
+  bool RecordInputs;
 };
 
 /// \brief Abstract base class for all C++11 migration transforms.
@@ -78,7 +87,9 @@ struct TransformOptions {
 ///
 /// If timing is enabled (see TransformOptions), per-source performance timing
 /// is recorded and stored in a TimingVec for later access with timing_begin()
-/// and timing_end().
+/// and timing_end(). The timings of the parse and match phases of each source
+/// are also stored in a PhaseTimingVec, accessed with phase_timing_begin() and
+/// phase_timing_end().
 class Transform {
 public:
   /// \brief Constructor
@@ -121,6 +132,14 @@ public:
   /// \brief Query transform name.
   llvm::StringRef getName() const { return Name; }
 
+  /// \brief Returns the values of the transform's own options (see
+  /// TransformsOptionsCategory) as a string.
+  ///
+  /// The incremental state keys the results of each transform by these
+  /// values, so transforms registering options that affect their changes
+  /// must override this function.
+  virtual std::string getOptionsKey() const { return std::string(); }
+
   /// \brief Reset internal state of the transform.
   ///
   /// Useful if calling apply() several times with one instantiation of a
@@ -133,6 +152,9 @@ public:
 
   /// \brief Tests if the file containing \a Loc is allowed to be modified by
   /// the Modernizer.
+  ///
+  /// The answer for each header is computed once per translation unit and
+  /// then looked up by its FileEntry.
   bool isFileModifiable(const clang::SourceManager &SM,
                         const clang::SourceLocation &Loc) const;
 
@@ -158,6 +180,25 @@ public:
   /// immediately after the corresponding handleBeginSource() call.
   virtual void handleEndSource();
 
+  /// \brief Called once a translation unit has been parsed, before it is
+  /// matched.
+  ///
+  /// Ends the "parse" phase of the current source and starts its "match"
+  /// phase, which covers the match callbacks creating the replacements and
+  /// ends in handleEndSource().
+  void handleEndParse();
+
+  /// \brief Makes the transform release \p Lock while it parses a source, from
+  /// handleBeginSource() to handleEndParse(), and hold it otherwise.
+  ///
+  /// AST matchers share implementations whose reference counts aren't atomic,
+  /// e.g. the one of anything(), even when each thread builds its own. So
+  /// transforms applied on several threads build, run and destroy their
+  /// matchers holding a common lock, and only parse in parallel.
+  void setMatcherLock(std::unique_lock<std::mutex> *Lock) {
+    MatcherLock = Lock;
+  }
+
   /// \brief Performance timing data is stored as a vector of pairs. Pairs are
   /// formed of:
   /// \li Name of source file.
@@ -169,6 +210,50 @@ public:
   /// \brief Return an iterator to the start of collected timing data.
   TimingVec::const_iterator timing_end() const { return Timings.end(); }
 
+  /// \brief Performance timing data of one phase of a source.
+  struct PhaseTiming {
+    PhaseTiming(llvm::StringRef Source, llvm::StringRef Phase,
+                llvm::TimeRecord Duration, size_t MemoryInUse)
+        : Source(Source), Phase(Phase), Duration(Duration),
+          MemoryInUse(MemoryInUse) {}
+
+    /// \brief Name of source file.
+    std::string Source;
+    /// \brief Name of the phase, e.g. "parse" or "match".
+    std::string Phase;
+    /// \brief Elapsed wall, user and system time.
+    llvm::TimeRecord Duration;
+    /// \brief Bytes of heap memory in use at the end of the phase.
+    size_t MemoryInUse;
+  };
+  typedef std::vector<PhaseTiming> PhaseTimingVec;
+
+  /// \brief Return an iterator to the start of collected phase timing data.
+  PhaseTimingVec::const_iterator phase_timing_begin() const {
+    return PhaseTimings.begin();
+  }
+  /// \brief Return an iterator to the end of collected phase timing data.
+  PhaseTimingVec::const_iterator phase_timing_end() const {
+    return PhaseTimings.end();
+  }
+
+  /// \brief Files read while transforming a source.
+  struct SourceInputs {
+    /// \brief Absolute path of the source file.
+    std::string Source;
+    /// \brief Absolute paths of the files read, including the source itself.
+    std::vector<std::string> Files;
+    /// \brief Absolute paths of the files replacements were created for.
+    std::vector<std::string> ChangedFiles;
+  };
+  typedef std::vector<SourceInputs> InputsVec;
+
+  /// \brief Return an iterator to the start of the inputs recorded if
+  /// TransformOptions::RecordInputs is set.
+  InputsVec::const_iterator inputs_begin() const { return Inputs.begin(); }
+  /// \brief Return an iterator to the end of the recorded inputs.
+  InputsVec::const_iterator inputs_end() const { return Inputs.end(); }
+
   /// \brief Add a Replacement to the list for the current translation unit.
   ///
   /// \returns \li true on success
@@ -180,6 +265,13 @@ public:
     return Replacements;
   }
 
+  /// \brief Add the replacements, change counts and timing data collected by
+  /// \p Other to those of this transform.
+  ///
+  /// \p Other is expected to be another instance of the same transform that
+  /// was applied to different sources, e.g. by a worker thread.
+  void merge(const Transform &Other);
+
 protected:
 
   void setAcceptedChanges(unsigned Changes) {
@@ -212,11 +304,27 @@ protected:
   createActionFactory(clang::ast_matchers::MatchFinder &Finder);
 
 private:
+  /// \brief Records the phase of the current source that started at
+  /// PhaseStart as \p Phase and starts the next one.
+  void endPhase(llvm::StringRef Phase);
+
   const std::string Name;
   const TransformOptions &GlobalOptions;
   TUReplacementsMap Replacements;
   std::string CurrentSource;
   TimingVec Timings;
+  PhaseTimingVec PhaseTimings;
+  InputsVec Inputs;
+  /// \brief SourceManager of the current translation unit, used to record its
+  /// inputs.
+  const clang::SourceManager *CurrentSM;
+  /// \brief Negated start time of the current phase of the current source.
+  llvm::TimeRecord PhaseStart;
+  /// \brief Lock released while parsing, see setMatcherLock().
+  std::unique_lock<std::mutex> *MatcherLock;
+  /// \brief Cache of isFileModifiable() results for the current translation
+  /// unit.
+  mutable llvm::DenseMap<const clang::FileEntry *, bool> ModifiableFileCache;
   unsigned AcceptedChanges;
   unsigned RejectedChanges;
   unsigned DeferredChanges;
@@ -25,6 +25,11 @@ Transforms::~Transforms() {
        I != E; ++I)
     delete *I;
 
+  for (std::vector<TransformFactory *>::iterator I = ChosenFactories.begin(),
+                                                 E = ChosenFactories.end();
+       I != E; ++I)
+    delete *I;
+
   for (OptionMap::iterator I = Options.begin(), E = Options.end(); I != E; ++I)
     delete I->getValue();
 }
@@ -62,10 +67,18 @@ Transforms::createSelectedTransforms(const TransformOptions &GlobalOptions,
       continue;
 
     std::unique_ptr<TransformFactory> Factory(I->instantiate());
-    if (Factory->supportsCompilers(RequiredVersions))
+    if (Factory->supportsCompilers(RequiredVersions)) {
       ChosenTransforms.push_back(Factory->createTransform(GlobalOptions));
-    else if (ExplicitlyEnabled)
+      ChosenFactories.push_back(Factory.release());
+    } else if (ExplicitlyEnabled)
       llvm::errs() << "note: " << '-' << I->getName()
                    << ": transform not available for specified compilers\n";
   }
 }
+
+Transform *
+Transforms::createTransformLike(const_iterator I,
+                                const TransformOptions &Options) const {
+  return ChosenFactories[I - ChosenTransforms.begin()]->createTransform(
+      Options);
+}
@@ -28,6 +28,7 @@ class Option;
 } // namespace cl
 } // namespace llvm
 class Transform;
+class TransformFactory;
 struct TransformOptions;
 struct CompilerVersions;
 
@@ -71,6 +72,14 @@ public:
   /// transforms.
   const_iterator end() const { return ChosenTransforms.end(); }
 
+  /// \brief Instantiate another transform of the same kind as the selected
+  /// transform \p I.
+  ///
+  /// Used to give each worker thread its own instance of a transform when
+  /// sources are transformed in parallel. The caller owns the result.
+  Transform *createTransformLike(const_iterator I,
+                                 const TransformOptions &Options) const;
+
 private:
   bool hasAnyExplicitOption() const;
 
@@ -78,6 +87,8 @@ private:
 
 private:
   TransformVec ChosenTransforms;
+  /// \brief The factories of \c ChosenTransforms, in the same order.
+  std::vector<TransformFactory *> ChosenFactories;
   OptionMap Options;
 };
 
@@ -946,7 +946,8 @@ StringRef LoopFixer::checkDeferralsAndRejections(ASTContext *Context,
     return "";
   }
 
-  TUInfo.getParentFinder().gatherAncestors(Context->getTranslationUnitDecl());
+  TUInfo.getParentFinder().gatherAncestors(TheLoop,
+                                           Context->getTranslationUnitDecl());
   // Ensure that we do not try to move an expression dependent on a local
   // variable declared inside the loop outside of it!
   DependencyFinderASTVisitor DependencyFinder(
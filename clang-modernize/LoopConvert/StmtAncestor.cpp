@@ -17,6 +17,42 @@
 
 using namespace clang;
 
+/// \brief Returns the outermost function, method or block containing the
+/// variables declared in the init statement of \p Loop, or null.
+///
+/// Lambdas and local classes are traversed as part of the enclosing function,
+/// so the outermost function is the one to analyze.
+static const Decl *getOutermostFunction(const ForStmt *Loop) {
+  const DeclStmt *Init = dyn_cast_or_null<DeclStmt>(Loop->getInit());
+  if (!Init || Init->decl_begin() == Init->decl_end())
+    return nullptr;
+
+  const Decl *Outermost = nullptr;
+  for (const DeclContext *DC = (*Init->decl_begin())->getDeclContext(); DC;
+       DC = DC->getParent())
+    if (DC->isFunctionOrMethod())
+      Outermost = cast<Decl>(DC);
+  return Outermost;
+}
+
+void StmtAncestorASTVisitor::gatherAncestors(const ForStmt *Loop,
+                                             const TranslationUnitDecl *TU) {
+  // Once the whole translation unit has been analyzed there is nothing left
+  // to do.
+  if (GatheredDecls.count(TU))
+    return;
+
+  const Decl *Scope = getOutermostFunction(Loop);
+  if (!Scope)
+    Scope = TU;
+  if (GatheredDecls.count(Scope))
+    return;
+  GatheredDecls.insert(Scope);
+
+  assert(StmtStack.size() == 1 && "Unbalanced statement stack");
+  TraverseDecl(const_cast<Decl *>(Scope));
+}
+
 /// \brief Tracks a stack of parent statements during traversal.
 ///
 /// All this really does is inject push_back() before running
@@ -87,54 +123,38 @@ bool DependencyFinderASTVisitor::VisitVarDecl(VarDecl *V) {
   return true;
 }
 
-/// \brief If we already created a variable for TheLoop, check to make sure
-/// that the name was not already taken.
+/// \brief If we already created a variable for TheLoop, its name is taken.
 bool DeclFinderASTVisitor::VisitForStmt(ForStmt *TheLoop) {
   StmtGeneratedVarNameMap::const_iterator I = GeneratedDecls->find(TheLoop);
-  if (I != GeneratedDecls->end() && I->second == Name) {
-    Found = true;
-    return false;
-  }
+  if (I != GeneratedDecls->end())
+    Names.insert(I->second);
   return true;
 }
 
-/// \brief If any named declaration within the AST subtree has the same name,
-/// then consider Name already taken.
+/// \brief The name of any named declaration within the AST subtree is taken.
 bool DeclFinderASTVisitor::VisitNamedDecl(NamedDecl *D) {
-  const IdentifierInfo *Ident = D->getIdentifier();
-  if (Ident && Ident->getName() == Name) {
-    Found = true;
-    return false;
-  }
+  if (const IdentifierInfo *Ident = D->getIdentifier())
+    Names.insert(Ident->getName());
   return true;
 }
 
-/// \brief Forward any declaration references to the actual check on the
-/// referenced declaration.
+/// \brief Forward any declaration references to the referenced declaration.
 bool DeclFinderASTVisitor::VisitDeclRefExpr(DeclRefExpr *DeclRef) {
   if (NamedDecl *D = dyn_cast<NamedDecl>(DeclRef->getDecl()))
     return VisitNamedDecl(D);
   return true;
 }
 
-/// \brief If the new variable name conflicts with any type used in the loop,
-/// then we mark that variable name as taken.
+/// \brief The names of the types used in the loop are taken.
 bool DeclFinderASTVisitor::VisitTypeLoc(TypeLoc TL) {
   QualType QType = TL.getType();
 
-  // Check if our name conflicts with a type, to handle for typedefs.
-  if (QType.getAsString() == Name) {
-    Found = true;
-    return false;
-  }
-  // Check for base type conflicts. For example, when a struct is being
+  // Take the name of the type, to handle typedefs.
+  Names.insert(QType.getAsString());
+  // Also take the base type name. For example, when a struct is being
   // referenced in the body of the loop, the above getAsString() will return the
   // whole type (ex. "struct s"), but will be caught here.
-  if (const IdentifierInfo *Ident = QType.getBaseTypeIdentifier()) {
-    if (Ident->getName() == Name) {
-      Found = true;
-      return false;
-    }
-  }
+  if (const IdentifierInfo *Ident = QType.getBaseTypeIdentifier())
+    Names.insert(Ident->getName());
   return true;
 }
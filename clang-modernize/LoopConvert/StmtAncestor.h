@@ -17,6 +17,8 @@
 #define CLANG_MODERNIZE_STMT_ANCESTOR_H
 
 #include "clang/AST/RecursiveASTVisitor.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/StringSet.h"
 
 /// A map used to walk the AST in reverse: maps child Stmt to parent Stmt.
 typedef llvm::DenseMap<const clang::Stmt*, const clang::Stmt*> StmtParentMap;
@@ -46,13 +48,14 @@ public:
     StmtStack.push_back(nullptr);
   }
 
-  /// \brief Run the analysis on the TranslationUnitDecl.
+  /// \brief Run the analysis on the outermost function containing \p Loop.
   ///
-  /// In case we're running this analysis multiple times, don't repeat the work.
-  void gatherAncestors(const clang::TranslationUnitDecl *T) {
-    if (StmtAncestors.empty())
-      TraverseDecl(const_cast<clang::TranslationUnitDecl*>(T));
-  }
+  /// The maps are built lazily, only for the functions containing candidate
+  /// loops, rather than for the whole translation unit \p TU, which includes
+  /// all the headers. Each function is only analyzed once. If \p Loop isn't
+  /// in a function, \p TU is analyzed instead.
+  void gatherAncestors(const clang::ForStmt *Loop,
+                       const clang::TranslationUnitDecl *TU);
 
   /// Accessor for StmtAncestors.
   const StmtParentMap &getStmtToParentStmtMap() {
@@ -70,6 +73,8 @@ private:
   StmtParentMap StmtAncestors;
   DeclParentMap DeclParents;
   llvm::SmallVector<const clang::Stmt*, 16> StmtStack;
+  /// The functions, or translation unit, already analyzed.
+  llvm::SmallPtrSet<const clang::Decl*, 8> GatheredDecls;
 
   bool TraverseStmt(clang::Stmt *Statement);
   bool VisitDeclStmt(clang::DeclStmt *Statement);
@@ -163,34 +168,32 @@ private:
   bool VisitDeclRefExpr(clang::DeclRefExpr *D);
 };
 
-/// Class used to determine if any declarations used in a Stmt would conflict
-/// with a particular identifier. This search includes the names that don't
-/// actually appear in the AST (i.e. created by a refactoring tool) by including
-/// a map from Stmts to generated names associated with those stmts.
+/// Class used to collect the names that a new variable declared in a Stmt
+/// could conflict with: the names of the declarations, declaration references
+/// and types in the Stmt. This includes the names that don't actually appear
+/// in the AST (i.e. created by a refactoring tool) by including a map from
+/// Stmts to generated names associated with those stmts.
 class DeclFinderASTVisitor :
   public clang::RecursiveASTVisitor<DeclFinderASTVisitor> {
 public:
-  DeclFinderASTVisitor(const std::string &Name,
+  DeclFinderASTVisitor(llvm::StringSet<> &Names,
                        const StmtGeneratedVarNameMap *GeneratedDecls) :
-    Name(Name), GeneratedDecls(GeneratedDecls), Found(false) { }
+    Names(Names), GeneratedDecls(GeneratedDecls) { }
 
-  /// Attempts to find any usages of variables name Name in Body, returning
-  /// true when it is used in Body. This includes the generated loop variables
-  /// of ForStmts which have already been transformed.
-  bool findUsages(const clang::Stmt *Body) {
-    Found = false;
+  /// Adds the names used in Body to Names, in a single traversal. This
+  /// includes the generated loop variables of ForStmts which have already
+  /// been transformed.
+  void collectNames(const clang::Stmt *Body) {
     TraverseStmt(const_cast<clang::Stmt *>(Body));
-    return Found;
   }
 
   friend class clang::RecursiveASTVisitor<DeclFinderASTVisitor>;
 
 private:
-  std::string Name;
+  llvm::StringSet<> &Names;
   /// GeneratedDecls keeps track of ForStmts which have been transformed,
   /// mapping each modified ForStmt to the variable generated in the loop.
   const StmtGeneratedVarNameMap *GeneratedDecls;
-  bool Found;
 
   bool VisitForStmt(clang::ForStmt *F);
   bool VisitNamedDecl(clang::NamedDecl *D);
@@ -76,20 +76,34 @@ bool VariableNamer::declarationExists(StringRef Symbol) {
   if (Ident.hasMacroDefinition())
     return true;
 
-  // Determine if the symbol was generated in a parent context.
-  for (const Stmt *S = SourceStmt; S != nullptr; S = ReverseAST->lookup(S)) {
-    StmtGeneratedVarNameMap::const_iterator I = GeneratedDecls->find(S);
-    if (I != GeneratedDecls->end() && I->second == Symbol)
-      return true;
-  }
-
   // FIXME: Rather than detecting conflicts at their usages, we should check the
   // parent context.
   // For some reason, lookup() always returns the pair (NULL, NULL) because its
   // StoredDeclsMap is not initialized (i.e. LookupPtr.getInt() is false inside
   // of DeclContext::lookup()). Why is this?
 
-  // Finally, determine if the symbol was used in the loop or a child context.
-  DeclFinderASTVisitor DeclFinder(Symbol, GeneratedDecls);
-  return DeclFinder.findUsages(SourceStmt);
+  // Finally, determine if the symbol was generated in a parent context, or
+  // used in the loop or a child context.
+  if (!UsedNamesCollected) {
+    collectUsedNames();
+    UsedNamesCollected = true;
+  }
+  return UsedNames.count(Symbol);
+}
+
+/// \brief Collects the names generated by this loop converter for SourceStmt
+/// and its parents, and the names declared or referenced within SourceStmt,
+/// which includes the names generated for the loops nested within it.
+///
+/// createIndexName() tries several candidate names, which are then checked
+/// against this set instead of traversing SourceStmt once per candidate.
+void VariableNamer::collectUsedNames() {
+  for (const Stmt *S = SourceStmt; S != nullptr; S = ReverseAST->lookup(S)) {
+    StmtGeneratedVarNameMap::const_iterator I = GeneratedDecls->find(S);
+    if (I != GeneratedDecls->end())
+      UsedNames.insert(I->second);
+  }
+
+  DeclFinderASTVisitor DeclFinder(UsedNames, GeneratedDecls);
+  DeclFinder.collectNames(SourceStmt);
 }
@@ -34,7 +34,7 @@ class VariableNamer {
       const clang::VarDecl *TheContainer, const clang::ASTContext *Context)
       : GeneratedDecls(GeneratedDecls), ReverseAST(ReverseAST),
         SourceStmt(SourceStmt), OldIndex(OldIndex), TheContainer(TheContainer),
-        Context(Context) {}
+        Context(Context), UsedNamesCollected(false) {}
 
   /// \brief Generate a new index name.
   ///
@@ -51,6 +51,15 @@ class VariableNamer {
   const clang::VarDecl *TheContainer;
   const clang::ASTContext *Context;
 
+  // The names declared or referenced in SourceStmt and the names generated
+  // for SourceStmt and its parents, collected in a single pass the first time
+  // a name is checked.
+  llvm::StringSet<> UsedNames;
+  bool UsedNamesCollected;
+
+  // Collect UsedNames.
+  void collectUsedNames();
+
   // Determine whether or not a declaration that would conflict with Symbol
   // exists in an outer context or in any statement contained in SourceStmt.
   bool declarationExists(llvm::StringRef Symbol);
@@ -31,6 +31,10 @@ UserNullMacroNames("user-null-macros",
                             "macro names that behave like NULL"),
                    cl::cat(TransformsOptionsCategory), cl::init(""));
 
+std::string UseNullptrTransform::getOptionsKey() const {
+  return "user-null-macros=" + UserNullMacroNames;
+}
+
 int UseNullptrTransform::apply(const CompilationDatabase &Database,
                                const std::vector<std::string> &SourcePaths) {
   ClangTool UseNullptrTool(Database, SourcePaths);
@@ -30,6 +30,9 @@ public:
   /// \see Transform::run().
   int apply(const clang::tooling::CompilationDatabase &Database,
             const std::vector<std::string> &SourcePaths) override;
+
+  /// \see Transform::getOptionsKey().
+  std::string getOptionsKey() const override;
 };
 
 #endif // CLANG_MODERNIZE_USE_NULLPTR_H
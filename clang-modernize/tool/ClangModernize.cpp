@@ -15,6 +15,7 @@
 ///
 //===----------------------------------------------------------------------===//
 
+#include "Core/IncrementalState.h"
 #include "Core/PerfSupport.h"
 #include "Core/ReplacementHandling.h"
 #include "Core/Transform.h"
@@ -25,12 +26,22 @@
 #include "clang/Basic/Version.h"
 #include "clang/Format/Format.h"
 #include "clang/Frontend/FrontendActions.h"
+#include "clang/Frontend/TextDiagnosticPrinter.h"
 #include "clang/Tooling/CommonOptionsParser.h"
 #include "clang/Tooling/Tooling.h"
 #include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/StringSet.h"
 #include "llvm/ADT/StringSwitch.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/Path.h"
+#include "llvm/Support/Process.h"
 #include "llvm/Support/Signals.h"
+#include "llvm/Support/Threading.h"
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <thread>
 
 namespace cl = llvm::cl;
 using namespace clang;
@@ -102,9 +113,24 @@ static cl::opt<bool> FinalSyntaxCheck(
     cl::desc("Check for correct syntax after applying transformations"),
     cl::init(false), cl::cat(GeneralCategory));
 
+static cl::opt<unsigned> Jobs(
+    "j",
+    cl::desc("Number of translation units to parse in parallel, or 0 for\n"
+             "the number of hardware threads. Matching is done one\n"
+             "translation unit at a time. More than one job requires the\n"
+             "paths in the compile commands to be absolute. Default: 1\n"),
+    cl::init(1), cl::value_desc("N"), cl::cat(GeneralCategory));
+
 static cl::opt<bool> SummaryMode("summary", cl::desc("Print transform summary"),
                                  cl::init(false), cl::cat(GeneralCategory));
 
+static cl::opt<std::string> IncrementalStateFile(
+    "incremental",
+    cl::desc("Skip sources a transform made no changes to in a previous run\n"
+             "with the same options, unless they or the files they include\n"
+             "changed since. State is kept in the given file.\n"),
+    cl::value_desc("filename"), cl::cat(GeneralCategory));
+
 static cl::opt<std::string>
 TimingDirectoryName("perf",
                     cl::desc("Capture performance data and output to specified "
@@ -298,6 +324,272 @@ static bool isFileExplicitlyExcludedPredicate(llvm::StringRef FilePath) {
   return false;
 }
 
+/// \brief Maps compile command directories to the indexes of the sources
+/// compiled in them.
+typedef std::map<std::string, std::vector<unsigned> > SourcesByDirectoryMap;
+
+/// \brief Groups the absolute paths \p Sources by the directory of their
+/// compile command.
+static SourcesByDirectoryMap
+groupSourcesByDirectory(const CompilationDatabase &Compilations,
+                        const std::vector<std::string> &Sources) {
+  SourcesByDirectoryMap SourcesByDirectory;
+  for (unsigned S = 0, E = Sources.size(); S != E; ++S) {
+    std::vector<CompileCommand> Commands =
+        Compilations.getCompileCommands(Sources[S]);
+    SourcesByDirectory[Commands.empty() ? "" : Commands.front().Directory]
+        .push_back(S);
+  }
+  return SourcesByDirectory;
+}
+
+/// \brief Applies the transform \p I to the sources \p Indexes of
+/// \p Sources, which share a compile command directory, on up to \p NumJobs
+/// threads.
+///
+/// Each worker thread transforms one source at a time with a new instance of
+/// the transform and keeps the replacements, change counts and timings of its
+/// sources in an instance of its own. Those are merged into \p *I once all
+/// the workers are done.
+///
+/// The workers only parse in parallel: they build, run and destroy the AST
+/// matchers of the transform holding a common lock, which the transform
+/// releases while parsing (see Transform::setMatcherLock()).
+static int applyToDirectory(const Transforms &TransformManager,
+                            Transforms::const_iterator I,
+                            const CompilationDatabase &Compilations,
+                            const std::vector<std::string> &Sources,
+                            const std::vector<unsigned> &Indexes,
+                            unsigned NumJobs) {
+  unsigned NumSources = Indexes.size();
+  unsigned NumWorkers = std::min(NumJobs, NumSources);
+
+  std::vector<std::unique_ptr<Transform>> WorkerResults(NumWorkers);
+  std::atomic<unsigned> NextSource(0);
+  std::atomic<int> Result(0);
+  std::mutex MatcherMutex;
+  auto Worker = [&](unsigned WorkerIndex) {
+    std::unique_lock<std::mutex> Lock(MatcherMutex);
+    std::unique_ptr<Transform> &Results = WorkerResults[WorkerIndex];
+    Results.reset(TransformManager.createTransformLike(I, GlobalOptions));
+    for (unsigned S = NextSource++; S < NumSources; S = NextSource++) {
+      std::unique_ptr<Transform> T(
+          TransformManager.createTransformLike(I, GlobalOptions));
+      T->setMatcherLock(&Lock);
+      std::vector<std::string> Source(1, Sources[Indexes[S]]);
+      if (int SourceResult = T->apply(Compilations, Source))
+        Result = SourceResult;
+      // A source that failed to start parsing leaves the lock released.
+      if (!Lock.owns_lock())
+        Lock.lock();
+      Results->merge(*T);
+    }
+  };
+
+  if (NumWorkers <= 1) {
+    Worker(0);
+  } else {
+    std::vector<std::thread> Workers;
+    for (unsigned W = 0; W < NumWorkers; ++W)
+      Workers.push_back(std::thread(Worker, W));
+    for (std::thread &T : Workers)
+      T.join();
+  }
+
+  for (const std::unique_ptr<Transform> &Results : WorkerResults)
+    if (Results)
+      (*I)->merge(*Results);
+  return Result;
+}
+
+/// \brief Applies the transform \p I to \p Sources on up to \p NumJobs
+/// threads.
+///
+/// The tool changes the current directory to the directory of the compile
+/// command, which is process-wide, so only the sources sharing a directory
+/// are transformed in parallel. This does not make relative paths safe: a
+/// tool also restores the directory it started in when it finishes, while
+/// the other workers may still be parsing, and the inputs recorded by
+/// Transform::handleEndSource() are made absolute against the current
+/// directory. More than one job thus requires the paths in the compile
+/// commands to be absolute.
+static int applyInParallel(const Transforms &TransformManager,
+                           Transforms::const_iterator I,
+                           const CompilationDatabase &Compilations,
+                           const std::vector<std::string> &Sources,
+                           unsigned NumJobs) {
+  // Make the paths absolute first since the current directory changes as
+  // sources are transformed.
+  std::vector<std::string> AbsoluteSources;
+  for (unsigned S = 0, E = Sources.size(); S != E; ++S)
+    AbsoluteSources.push_back(getAbsolutePath(Sources[S]));
+  SourcesByDirectoryMap SourcesByDirectory =
+      groupSourcesByDirectory(Compilations, AbsoluteSources);
+
+  int Result = 0;
+  for (SourcesByDirectoryMap::const_iterator
+           DirI = SourcesByDirectory.begin(),
+           DirE = SourcesByDirectory.end();
+       DirI != DirE; ++DirI)
+    if (int DirResult = applyToDirectory(TransformManager, I, Compilations,
+                                         AbsoluteSources, DirI->second,
+                                         NumJobs))
+      Result = DirResult;
+  return Result;
+}
+
+/// \brief Parses the sources \p Sources, given as absolute paths, on up to
+/// \p NumJobs threads to make sure the transforms didn't break them.
+///
+/// The diagnostics of each source are buffered and printed in the order of
+/// \p Sources, followed by the list of sources failing the check.
+///
+/// As in applyInParallel(), only the sources sharing a compile command
+/// directory are parsed at the same time, and more than one job requires the
+/// paths in the compile commands to be absolute: a tool restores the
+/// directory it started in while the other workers may still be parsing.
+///
+/// \returns the number of sources failing the check.
+static unsigned checkSyntax(const CompilationDatabase &Compilations,
+                            const std::vector<std::string> &Sources,
+                            unsigned NumJobs) {
+  std::vector<std::string> Diagnostics(Sources.size());
+  std::vector<char> Failed(Sources.size(), 0);
+
+  SourcesByDirectoryMap SourcesByDirectory =
+      groupSourcesByDirectory(Compilations, Sources);
+  for (SourcesByDirectoryMap::const_iterator
+           DirI = SourcesByDirectory.begin(),
+           DirE = SourcesByDirectory.end();
+       DirI != DirE; ++DirI) {
+    const std::vector<unsigned> &Indexes = DirI->second;
+    std::atomic<unsigned> NextSource(0);
+    auto Worker = [&]() {
+      for (unsigned S = NextSource++; S < Indexes.size(); S = NextSource++) {
+        unsigned Index = Indexes[S];
+        llvm::raw_string_ostream OS(Diagnostics[Index]);
+        llvm::IntrusiveRefCntPtr<DiagnosticOptions> DiagOpts(
+            new DiagnosticOptions());
+        TextDiagnosticPrinter Printer(OS, DiagOpts.get());
+        ClangTool SyntaxTool(Compilations,
+                             std::vector<std::string>(1, Sources[Index]));
+        SyntaxTool.setDiagnosticConsumer(&Printer);
+        int Result =
+            SyntaxTool.run(newFrontendActionFactory<SyntaxOnlyAction>().get());
+        Failed[Index] = Result != 0;
+        OS.flush();
+      }
+    };
+
+    unsigned NumWorkers =
+        std::min(NumJobs, static_cast<unsigned>(Indexes.size()));
+    if (NumWorkers <= 1) {
+      Worker();
+    } else {
+      std::vector<std::thread> Workers;
+      for (unsigned W = 0; W < NumWorkers; ++W)
+        Workers.push_back(std::thread(Worker));
+      for (std::thread &T : Workers)
+        T.join();
+    }
+  }
+
+  unsigned NumFailed = 0;
+  for (unsigned S = 0, E = Sources.size(); S != E; ++S) {
+    llvm::errs() << Diagnostics[S];
+    NumFailed += Failed[S];
+  }
+  for (unsigned S = 0, E = Sources.size(); S != E; ++S)
+    if (Failed[S])
+      llvm::errs() << "Final syntax check failed for " << Sources[S] << "\n";
+  return NumFailed;
+}
+
+/// \brief Returns the contents of the list file \p Path, or an empty string
+/// if no file is given or it cannot be read.
+static std::string getListFileContents(StringRef Path) {
+  if (Path.empty())
+    return std::string();
+  llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer> > Buffer =
+      llvm::MemoryBuffer::getFile(Path);
+  if (!Buffer)
+    return std::string();
+  return Buffer.get()->getBuffer();
+}
+
+/// \brief Returns the global options affecting the changes made by the
+/// transforms, including the contents of the include and exclude list files.
+static std::string getGlobalIncrementalConfig() {
+  std::string Config;
+  llvm::raw_string_ostream OS(Config);
+  OS << "risk=" << GlobalOptions.MaxRiskLevel << '\0'
+     << "for-compilers=" << SupportedCompilers << '\0'
+     << "include=" << IncludePaths << '\0'
+     << "exclude=" << ExcludePaths << '\0'
+     << "include-from=" << getListFileContents(IncludeFromFile) << '\0'
+     << "exclude-from=" << getListFileContents(ExcludeFromFile) << '\0';
+  return OS.str();
+}
+
+/// \brief Returns a digest of \p GlobalConfig and of the options of \p T, to
+/// tell apart the results of runs with different options in the incremental
+/// state.
+static std::string getIncrementalConfig(StringRef GlobalConfig,
+                                        const Transform &T) {
+  llvm::MD5 Hash;
+  Hash.update(GlobalConfig);
+  Hash.update(T.getOptionsKey());
+  llvm::MD5::MD5Result Result;
+  Hash.final(Result);
+  SmallString<32> Digest;
+  llvm::MD5::stringifyResult(Result, Digest);
+  return Digest.str();
+}
+
+/// \brief Returns the compile commands of \p Source flattened into a string.
+static std::string getCommandKey(const CompilationDatabase &Compilations,
+                                 StringRef Source) {
+  std::string Key;
+  std::vector<CompileCommand> Commands =
+      Compilations.getCompileCommands(Source);
+  for (std::vector<CompileCommand>::const_iterator I = Commands.begin(),
+                                                   E = Commands.end();
+       I != E; ++I) {
+    Key += I->Directory;
+    for (std::vector<std::string>::const_iterator
+             ArgI = I->CommandLine.begin(),
+             ArgE = I->CommandLine.end();
+         ArgI != ArgE; ++ArgI) {
+      Key += '\0';
+      Key += *ArgI;
+    }
+    Key += '\n';
+  }
+  return Key;
+}
+
+/// \brief Records the phase \p Phase of \p TransformName that started at the
+/// negated time \p Start under AllSourcesPerfKey.
+///
+/// Replacements are applied by a separate process so only the wall time of the
+/// phases is meaningful.
+///
+/// \returns the negated start time of the next phase.
+static llvm::TimeRecord addPhasePerfData(SourcePerfData &PerfData,
+                                         StringRef TransformName,
+                                         StringRef Phase,
+                                         llvm::TimeRecord Start) {
+  llvm::TimeRecord Now = llvm::TimeRecord::getCurrentTime(false);
+  Start += Now;
+  PerfData[AllSourcesPerfKey].push_back(
+      PerfItem(TransformName, Phase, Start,
+               llvm::sys::Process::GetMallocUsage(), /*UseWallTime=*/true));
+
+  llvm::TimeRecord Next;
+  Next -= Now;
+  return Next;
+}
+
 int main(int argc, const char **argv) {
   llvm::sys::PrintStackTraceOnErrorSignal();
   Transforms TransformManager;
@@ -358,6 +650,8 @@ int main(int argc, const char **argv) {
 
   // Enable timming.
   GlobalOptions.EnableTiming = TimingDirectoryName.getNumOccurrences() > 0;
+  GlobalOptions.RecordInputs =
+      !IncrementalStateFile.empty() || FinalSyntaxCheck;
 
   bool CmdSwitchError = false;
   CompilerVersions RequiredVersions =
@@ -415,20 +709,94 @@ int main(int argc, const char **argv) {
   else
     TempDestinationDir = ReplacementHandler.useTempDestinationDir();
 
+  unsigned NumJobs =
+      Jobs ? unsigned(Jobs) : std::thread::hardware_concurrency();
+  if (!llvm::llvm_is_multithreaded() || NumJobs == 0)
+    NumJobs = 1;
+  bool Parallel = NumJobs > 1 && Sources.size() > 1;
+
   SourcePerfData PerfData;
 
+  // Absolute paths of the sources, computed before any transform changes the
+  // current directory.
+  std::vector<std::string> AbsoluteSources;
+  for (std::vector<std::string>::const_iterator SI = Sources.begin(),
+                                                SE = Sources.end();
+       SI != SE; ++SI)
+    AbsoluteSources.push_back(getAbsolutePath(*SI));
+
+  IncrementalState State;
+  bool Incremental = !IncrementalStateFile.empty();
+  std::string GlobalIncrementalConfig;
+  if (Incremental) {
+    if (std::error_code EC = State.load(IncrementalStateFile))
+      llvm::errs() << "Ignoring incremental state " << IncrementalStateFile
+                   << ": " << EC.message() << "\n";
+    GlobalIncrementalConfig = getGlobalIncrementalConfig();
+  }
+
+  // Files changed by the transforms, and the files read by each source, to
+  // find the sources the final syntax check has to parse again.
+  llvm::StringSet<> ChangedFiles;
+  llvm::StringMap<std::vector<std::string> > SourceInputs;
+
   for (Transforms::const_iterator I = TransformManager.begin(),
                                   E = TransformManager.end();
        I != E; ++I) {
     Transform *T = *I;
 
-    if (T->apply(*Compilations, Sources) != 0) {
+    std::vector<std::string> TransformSources;
+    unsigned Skipped = 0;
+    std::string IncrementalConfig;
+    if (Incremental) {
+      IncrementalConfig = getIncrementalConfig(GlobalIncrementalConfig, *T);
+      for (std::vector<std::string>::const_iterator
+               SI = AbsoluteSources.begin(),
+               SE = AbsoluteSources.end();
+           SI != SE; ++SI) {
+        if (State.isUnchanged(*SI, T->getName(), IncrementalConfig,
+                              getCommandKey(*Compilations, *SI)))
+          ++Skipped;
+        else
+          TransformSources.push_back(*SI);
+      }
+    } else {
+      TransformSources = Sources;
+    }
+
+    int Result = 0;
+    if (!TransformSources.empty())
+      Result = Parallel ? applyInParallel(TransformManager, I, *Compilations,
+                                          TransformSources, NumJobs)
+                        : T->apply(*Compilations, TransformSources);
+    if (Result != 0) {
       // FIXME: Improve ClangTool to not abort if just one file fails.
       return 1;
     }
 
+    for (Transform::InputsVec::const_iterator II = T->inputs_begin(),
+                                              IE = T->inputs_end();
+         II != IE; ++II) {
+      // Hash the inputs as they were read by the transform, before any
+      // replacement is applied.
+      if (Incremental)
+        State.record(II->Source, T->getName(), IncrementalConfig,
+                     getCommandKey(*Compilations, II->Source), II->Files,
+                     /*Changed=*/!II->ChangedFiles.empty());
+
+      if (FinalSyntaxCheck && !SerializeOnly) {
+        std::vector<std::string> &Inputs = SourceInputs[II->Source];
+        Inputs.insert(Inputs.end(), II->Files.begin(), II->Files.end());
+        for (std::vector<std::string>::const_iterator
+                 FI = II->ChangedFiles.begin(),
+                 FE = II->ChangedFiles.end();
+             FI != FE; ++FI)
+          ChangedFiles.insert(*FI);
+      }
+    }
+
     if (GlobalOptions.EnableTiming)
-      collectSourcePerfData(*T, PerfData);
+      collectSourcePerfData(*T, PerfData, /*UseWallTime=*/Parallel);
 
     if (SummaryMode) {
       llvm::outs() << "Transform: " << T->getName()
@@ -437,25 +805,69 @@ int main(int argc, const char **argv) {
         llvm::outs() << " - Rejected: " << T->getRejectedChanges()
                      << " - Deferred: " << T->getDeferredChanges();
       }
+      if (Incremental)
+        llvm::outs() << " - Skipped: " << Skipped;
       llvm::outs() << "\n";
     }
 
+    llvm::TimeRecord PhaseTime;
+    if (GlobalOptions.EnableTiming)
+      PhaseTime -= llvm::TimeRecord::getCurrentTime(true);
+
     if (!ReplacementHandler.serializeReplacements(T->getAllReplacements()))
       return 1;
 
-    if (!SerializeOnly)
+    if (GlobalOptions.EnableTiming)
+      PhaseTime = addPhasePerfData(PerfData, T->getName(), "serialize",
+                                   PhaseTime);
+
+    if (!SerializeOnly) {
       if (!ReplacementHandler.applyReplacements())
         return 1;
+
+      if (GlobalOptions.EnableTiming)
+        addPhasePerfData(PerfData, T->getName(), "apply", PhaseTime);
+
+      State.invalidateFileHashes();
+    }
   }
 
+  if (Incremental)
+    if (std::error_code EC = State.save(IncrementalStateFile))
+      llvm::errs() << "Could not save incremental state to "
+                   << IncrementalStateFile << ": " << EC.message() << "\n";
+
   // Let the user know which temporary directory the replacements got written
   // to.
   if (SerializeOnly && !TempDestinationDir.empty())
     llvm::errs() << "Replacements serialized to: " << TempDestinationDir << "\n";
 
-  if (FinalSyntaxCheck) {
-    ClangTool SyntaxTool(*Compilations, SourcePaths);
-    if (SyntaxTool.run(newFrontendActionFactory<SyntaxOnlyAction>().get()) != 0)
+  if (FinalSyntaxCheck && !ChangedFiles.empty()) {
+    // Only the sources reading a changed file need to be checked. Sources
+    // skipped by all the transforms weren't parsed, so their inputs are
+    // unknown and they are checked too.
+    std::vector<std::string> CheckedSources;
+    for (std::vector<std::string>::const_iterator SI = AbsoluteSources.begin(),
+                                                  SE = AbsoluteSources.end();
+         SI != SE; ++SI) {
+      llvm::StringMap<std::vector<std::string> >::const_iterator InputsI =
+          SourceInputs.find(*SI);
+      bool Check = InputsI == SourceInputs.end();
+      if (!Check)
+        for (std::vector<std::string>::const_iterator
+                 FI = InputsI->getValue().begin(),
+                 FE = InputsI->getValue().end();
+             FI != FE && !Check; ++FI)
+          Check = ChangedFiles.count(*FI) != 0;
+      if (Check)
+        CheckedSources.push_back(*SI);
+    }
+
+    if (SummaryMode)
+      llvm::outs() << "Final syntax check: parsed " << CheckedSources.size()
+                   << " of " << AbsoluteSources.size() << " sources\n";
+
+    if (checkSyntax(*Compilations, CheckedSources, NumJobs) != 0)
       return 1;
   }
 
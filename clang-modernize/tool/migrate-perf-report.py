@@ -0,0 +1,133 @@
+#!/usr/bin/env python
+#
+#===- migrate-perf-report.py - Modernizer perf report ------*- python -*--===#
+#
+#                     The LLVM Compiler Infrastructure
+#
+# This file is distributed under the University of Illinois Open Source
+# License. See LICENSE.TXT for details.
+#
+#===------------------------------------------------------------------------===#
+
+"""
+clang-modernize performance report
+==================================
+
+Merges the JSON files written by clang-modernize -perf, e.g. by many runs of
+clang-modernize over the parts of a project, into a report showing:
+- the total time and the peak heap usage of every phase of every transform.
+- the sources taking the most time, per transform and phase.
+
+Example invocations.
+- Report on all files in ./migrate_perf.
+    migrate-perf-report.py
+
+- Report the 20 slowest sources of runs writing to two directories.
+    migrate-perf-report.py -top 20 perf/a perf/b
+"""
+
+from __future__ import print_function
+
+import argparse
+import json
+import os
+import sys
+
+ALL_SOURCES = '<all sources>'
+
+
+def find_perf_files(paths):
+  """Returns the JSON files given or contained in the directories given."""
+  files = []
+  for path in paths:
+    if os.path.isdir(path):
+      for name in sorted(os.listdir(path)):
+        if name.endswith('.json'):
+          files.append(os.path.join(path, name))
+    else:
+      files.append(path)
+  return files
+
+
+def read_perf_items(file_name):
+  """Yields (source, transform, phase, data) for each item of a file."""
+  with open(file_name) as f:
+    perf = json.load(f)
+  for source in perf.get('Sources', []):
+    # Files written by older versions spell the key with a trailing space.
+    name = source.get('Source', source.get('Source '))
+    for item in source.get('Data', []):
+      yield (name, item['TimerId'], item.get('Phase', 'total'), item)
+
+
+class Stats(object):
+  def __init__(self):
+    self.count = 0
+    self.time = 0.0
+    self.wall = 0.0
+    self.user = 0.0
+    self.system = 0.0
+    self.memory = 0
+
+  def add(self, item):
+    self.count += 1
+    self.time += item['Time']
+    self.wall += item.get('Wall', item['Time'])
+    self.user += item.get('User', 0.0)
+    self.system += item.get('System', 0.0)
+    self.memory = max(self.memory, item.get('Memory', 0))
+
+
+def main():
+  parser = argparse.ArgumentParser(description='Merges clang-modernize -perf '
+                                   'data into a hotspot report.')
+  parser.add_argument('-top', type=int, default=10,
+                      help='number of slowest sources to show per transform '
+                      'and phase')
+  parser.add_argument('paths', nargs='*', default=['migrate_perf'],
+                      help='JSON files or directories containing them')
+  args = parser.parse_args()
+
+  files = find_perf_files(args.paths)
+  if not files:
+    print('Error: no performance data found.', file=sys.stderr)
+    sys.exit(1)
+
+  # (transform, phase) -> Stats over all sources.
+  phases = {}
+  # (transform, phase) -> source -> Stats of that source.
+  sources = {}
+  for file_name in files:
+    try:
+      items = list(read_perf_items(file_name))
+    except (IOError, ValueError, KeyError) as e:
+      print('Warning: skipping %s: %s' % (file_name, e), file=sys.stderr)
+      continue
+    for source, transform, phase, item in items:
+      key = (transform, phase)
+      phases.setdefault(key, Stats()).add(item)
+      if source != ALL_SOURCES:
+        sources.setdefault(key, {}).setdefault(source, Stats()).add(item)
+
+  print('Read %d file(s).\n' % len(files))
+  print('%-24s %-10s %8s %12s %12s %12s %12s %10s' %
+        ('Transform', 'Phase', 'Count', 'Time(ms)', 'Wall(ms)', 'User(ms)',
+         'System(ms)', 'Heap(MB)'))
+  for key in sorted(phases, key=lambda k: -phases[k].time):
+    s = phases[key]
+    print('%-24s %-10s %8d %12.1f %12.1f %12.1f %12.1f %10.1f' %
+          (key[0], key[1], s.count, s.time, s.wall, s.user, s.system,
+           s.memory / (1024.0 * 1024.0)))
+
+  for key in sorted(sources, key=lambda k: -phases[k].time):
+    print('\nSlowest sources for %s (%s):' % key)
+    by_source = sources[key]
+    for source in sorted(by_source,
+                         key=lambda n: -by_source[n].time)[:args.top]:
+      s = by_source[source]
+      share = 100.0 * s.time / phases[key].time if phases[key].time else 0.0
+      print('  %10.1fms %5.1f%%  %s' % (s.time, share, source))
+
+
+if __name__ == '__main__':
+  main()
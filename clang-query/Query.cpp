@@ -12,7 +12,11 @@
 #include "clang/ASTMatchers/ASTMatchFinder.h"
 #include "clang/Frontend/ASTUnit.h"
 #include "clang/Frontend/TextDiagnostic.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/Timer.h"
 #include "llvm/Support/raw_ostream.h"
+#include <algorithm>
 
 using namespace clang::ast_matchers;
 using namespace clang::ast_matchers::dynamic;
@@ -41,90 +45,227 @@ bool HelpQuery::run(llvm::raw_ostream &OS, QuerySession &QS) const {
         "as part of other expressions.\n"
         "  set bind-root (true|false)        "
         "Set whether to bind the root matcher to \"root\".\n"
-        "  set output (diag|print|dump)      "
+        "  set output (diag|print|dump|count)\n"
+        "                                    "
         "Set whether to print bindings as diagnostics,\n"
         "                                    "
-        "AST pretty prints or AST dumps.\n\n";
+        "AST pretty prints or AST dumps, or to only count\n"
+        "                                    "
+        "the matches.\n"
+        "  set limit N                       "
+        "Stop after N matches; 0 for no limit.\n\n";
   return true;
 }
 
+/// Prints the bindings of a match in \p AST.
+static void printMatch(llvm::raw_ostream &OS, const BoundNodes &Match,
+                       ASTUnit &AST, OutputKind OutKind) {
+  for (BoundNodes::IDToNodeMap::const_iterator BI = Match.getMap().begin(),
+                                               BE = Match.getMap().end();
+       BI != BE; ++BI) {
+    switch (OutKind) {
+    case OK_Diag: {
+      clang::SourceRange R = BI->second.getSourceRange();
+      if (R.isValid()) {
+        TextDiagnostic TD(OS, AST.getASTContext().getLangOpts(),
+                          &AST.getDiagnostics().getDiagnosticOptions());
+        TD.emitDiagnostic(
+            R.getBegin(), DiagnosticsEngine::Note,
+            "\"" + BI->first + "\" binds here",
+            CharSourceRange::getTokenRange(R),
+            None, &AST.getSourceManager());
+      }
+      break;
+    }
+    case OK_Print: {
+      OS << "Binding for \"" << BI->first << "\":\n";
+      BI->second.print(OS, AST.getASTContext().getPrintingPolicy());
+      OS << "\n";
+      break;
+    }
+    case OK_Dump: {
+      OS << "Binding for \"" << BI->first << "\":\n";
+      BI->second.dump(OS, AST.getSourceManager());
+      OS << "\n";
+      break;
+    }
+    case OK_Count:
+      break;
+    }
+  }
+
+  if (Match.getMap().empty())
+    OS << "No bindings.\n";
+}
+
 namespace {
 
-struct CollectBoundNodes : MatchFinder::MatchCallback {
-  std::vector<BoundNodes> &Bindings;
-  CollectBoundNodes(std::vector<BoundNodes> &Bindings) : Bindings(Bindings) {}
+/// Formats each match of a query in one AST as soon as it is found, so the
+/// bound nodes of the matches are never stored. The matches are either
+/// printed to \c Direct, or buffered to be printed in the order of the ASTs.
+struct FormatMatches : MatchFinder::MatchCallback {
+  FormatMatches(ASTUnit &AST, OutputKind OutKind)
+      : AST(AST), OutKind(OutKind), Limit(~0U), FirstMatch(0), NumMatches(0),
+        Direct(nullptr) {}
+
   void run(const MatchFinder::MatchResult &Result) override {
-    Bindings.push_back(Result.Nodes);
+    // A MatchFinder can't stop its traversal, so the matches past the limit
+    // are dropped.
+    if (NumMatches >= Limit)
+      return;
+    ++NumMatches;
+    if (OutKind == OK_Count)
+      return;
+    if (Direct) {
+      *Direct << "\nMatch #" << FirstMatch + NumMatches << ":\n\n";
+      printMatch(*Direct, Result.Nodes, AST, OutKind);
+      return;
+    }
+    std::string Text;
+    llvm::raw_string_ostream TextOS(Text);
+    printMatch(TextOS, Result.Nodes, AST, OutKind);
+    Output.push_back(TextOS.str());
+  }
+
+  ASTUnit &AST;
+  OutputKind OutKind;
+  /// The number of matches to keep, ~0U to keep them all.
+  unsigned Limit;
+  /// The number of matches printed before this AST's, when printing directly.
+  unsigned FirstMatch;
+  unsigned NumMatches;
+  llvm::raw_ostream *Direct;
+  std::vector<std::string> Output;
+};
+
+/// Ignores the matches, for checking that matchers are valid.
+struct IgnoreMatches : MatchFinder::MatchCallback {
+  void run(const MatchFinder::MatchResult &Result) override {}
+};
+
+/// The finder matching the queries in one AST, and the matches of each.
+struct ASTMatches {
+  ASTMatches(ASTUnit &AST, OutputKind OutKind, unsigned NumQueries) {
+    for (unsigned I = 0; I != NumQueries; ++I)
+      Formats.push_back(llvm::make_unique<FormatMatches>(AST, OutKind));
   }
+
+  MatchFinder Finder;
+  std::vector<std::unique_ptr<FormatMatches>> Formats;
 };
 
 }  // namespace
 
-bool MatchQuery::run(llvm::raw_ostream &OS, QuerySession &QS) const {
-  unsigned MatchCount = 0;
+/// Runs match queries for \p Matchers, in a single traversal of each AST,
+/// and prints the matches of each query in turn, so the output is the same
+/// as running the queries one after the other.
+static bool runMatchQueries(llvm::raw_ostream &OS, QuerySession &QS,
+                            ArrayRef<DynTypedMatcher> Matchers) {
+  double StartTime = llvm::TimeRecord::getCurrentTime(false).getWallTime();
 
-  for (auto &AST : QS.ASTs) {
-    MatchFinder Finder;
-    std::vector<BoundNodes> Matches;
-    DynTypedMatcher MaybeBoundMatcher = Matcher;
+  std::vector<DynTypedMatcher> MaybeBoundMatchers;
+  for (const DynTypedMatcher &Matcher : Matchers) {
+    MaybeBoundMatchers.push_back(Matcher);
     if (QS.BindRoot) {
       llvm::Optional<DynTypedMatcher> M = Matcher.tryBind("root");
       if (M)
-        MaybeBoundMatcher = *M;
+        MaybeBoundMatchers.back() = *M;
     }
-    CollectBoundNodes Collect(Matches);
-    if (!Finder.addDynamicMatcher(MaybeBoundMatcher, &Collect)) {
-      OS << "Not a valid top-level matcher.\n";
-      return false;
-    }
-    Finder.matchAST(AST->getASTContext());
-
-    for (std::vector<BoundNodes>::iterator MI = Matches.begin(),
-                                           ME = Matches.end();
-         MI != ME; ++MI) {
-      OS << "\nMatch #" << ++MatchCount << ":\n\n";
-
-      for (BoundNodes::IDToNodeMap::const_iterator BI = MI->getMap().begin(),
-                                                   BE = MI->getMap().end();
-           BI != BE; ++BI) {
-        switch (QS.OutKind) {
-        case OK_Diag: {
-          clang::SourceRange R = BI->second.getSourceRange();
-          if (R.isValid()) {
-            TextDiagnostic TD(OS, AST->getASTContext().getLangOpts(),
-                              &AST->getDiagnostics().getDiagnosticOptions());
-            TD.emitDiagnostic(
-                R.getBegin(), DiagnosticsEngine::Note,
-                "\"" + BI->first + "\" binds here",
-                CharSourceRange::getTokenRange(R),
-                None, &AST->getSourceManager());
-          }
-          break;
-        }
-        case OK_Print: {
-          OS << "Binding for \"" << BI->first << "\":\n";
-          BI->second.print(OS, AST->getASTContext().getPrintingPolicy());
-          OS << "\n";
-          break;
-        }
-        case OK_Dump: {
-          OS << "Binding for \"" << BI->first << "\":\n";
-          BI->second.dump(OS, AST->getSourceManager());
-          OS << "\n";
-          break;
-        }
-        }
+  }
+
+  // Register the matchers with a finder for each AST. The ASTs are matched
+  // one at a time: copies of a matcher share a reference count, which is not
+  // atomic and which matching updates. Parsing the query again for each
+  // thread wouldn't help, since matchers such as anything() or decl() share
+  // one implementation across the whole process.
+  unsigned NumQueries = Matchers.size();
+  std::vector<std::unique_ptr<ASTMatches>> Results;
+  for (unsigned I = 0, E = QS.ASTs.size(); I != E; ++I) {
+    Results.push_back(
+        llvm::make_unique<ASTMatches>(*QS.ASTs[I], QS.OutKind, NumQueries));
+    for (unsigned Q = 0; Q != NumQueries; ++Q) {
+      if (!Results.back()->Finder.addDynamicMatcher(
+              MaybeBoundMatchers[Q], Results.back()->Formats[Q].get())) {
+        OS << "Not a valid top-level matcher.\n";
+        return false;
       }
+    }
+  }
 
-      if (MI->getMap().empty())
-        OS << "No bindings.\n";
+  if (NumQueries == 1) {
+    // Print each match as soon as it is found, so no match is kept in
+    // memory, and stop matching ASTs once the limit is reached.
+    unsigned MatchCount = 0;
+    for (auto &Result : Results) {
+      if (QS.Limit && MatchCount >= QS.Limit)
+        break;
+      FormatMatches &Format = *Result->Formats.front();
+      Format.Limit = QS.Limit ? QS.Limit - MatchCount : ~0U;
+      Format.FirstMatch = MatchCount;
+      Format.Direct = &OS;
+      Result->Finder.matchAST(Format.AST.getASTContext());
+      MatchCount += Format.NumMatches;
+    }
+    OS << MatchCount << (MatchCount == 1 ? " match.\n" : " matches.\n");
+  } else {
+    // Match each AST once for all the queries, buffering the output so it is
+    // printed by query, in the order of the ASTs. Only the matches within
+    // the limit are buffered, and none when counting, and ASTs are no longer
+    // matched once every query reached the limit.
+    std::vector<unsigned> MatchCounts(NumQueries);
+    for (auto &Result : Results) {
+      if (QS.Limit &&
+          std::all_of(MatchCounts.begin(), MatchCounts.end(),
+                      [&](unsigned Count) { return Count >= QS.Limit; }))
+        break;
+      for (unsigned Q = 0; Q != NumQueries; ++Q)
+        Result->Formats[Q]->Limit =
+            QS.Limit ? QS.Limit - std::min(MatchCounts[Q], QS.Limit) : ~0U;
+      Result->Finder.matchAST(Result->Formats.front()->AST.getASTContext());
+      for (unsigned Q = 0; Q != NumQueries; ++Q)
+        MatchCounts[Q] += Result->Formats[Q]->NumMatches;
+    }
+    for (unsigned Q = 0; Q != NumQueries; ++Q) {
+      unsigned MatchCount = 0;
+      for (const auto &Result : Results) {
+        const FormatMatches &Format = *Result->Formats[Q];
+        for (unsigned I = 0, E = Format.Output.size(); I != E; ++I)
+          OS << "\nMatch #" << MatchCount + I + 1 << ":\n\n"
+             << Format.Output[I];
+        MatchCount += Format.NumMatches;
+      }
+      OS << MatchCount << (MatchCount == 1 ? " match.\n" : " matches.\n");
     }
   }
 
-  OS << MatchCount << (MatchCount == 1 ? " match.\n" : " matches.\n");
+  if (QS.PrintTiming)
+    llvm::errs() << llvm::format(
+        "clang-query: matched %u queries in %u ASTs in %.3fs\n", NumQueries,
+        unsigned(QS.ASTs.size()),
+        llvm::TimeRecord::getCurrentTime(false).getWallTime() - StartTime);
   return true;
 }
 
+bool MatchQuery::run(llvm::raw_ostream &OS, QuerySession &QS) const {
+  return runMatchQueries(OS, QS, Matcher);
+}
+
+bool MultiMatchQuery::run(llvm::raw_ostream &OS, QuerySession &QS) const {
+  // Answer the queries before an invalid matcher, so the output is the same
+  // as running the queries one after the other.
+  MatchFinder Finder;
+  IgnoreMatches Ignore;
+  for (unsigned I = 0, E = Matchers.size(); I != E; ++I) {
+    if (!Finder.addDynamicMatcher(Matchers[I], &Ignore)) {
+      if (I && !runMatchQueries(OS, QS, makeArrayRef(Matchers).slice(0, I)))
+        return false;
+      OS << "Not a valid top-level matcher.\n";
+      return false;
+    }
+  }
+  return runMatchQueries(OS, QS, Matchers);
+}
+
 bool LetQuery::run(llvm::raw_ostream &OS, QuerySession &QS) const {
   if (Value) {
     QS.NamedValues[Name] = Value;
@@ -137,6 +278,7 @@ bool LetQuery::run(llvm::raw_ostream &OS, QuerySession &QS) const {
 #ifndef _MSC_VER
 const QueryKind SetQueryKind<bool>::value;
 const QueryKind SetQueryKind<OutputKind>::value;
+const QueryKind SetQueryKind<unsigned>::value;
 #endif
 
 } // namespace query
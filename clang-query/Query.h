@@ -11,9 +11,11 @@
 #define LLVM_CLANG_TOOLS_EXTRA_CLANG_QUERY_QUERY_H
 
 #include "clang/ASTMatchers/Dynamic/VariantValue.h"
+#include "llvm/ADT/ArrayRef.h"
 #include "llvm/ADT/IntrusiveRefCntPtr.h"
 #include "llvm/ADT/Optional.h"
 #include <string>
+#include <vector>
 
 namespace clang {
 namespace query {
@@ -21,7 +23,8 @@ namespace query {
 enum OutputKind {
   OK_Diag,
   OK_Print,
-  OK_Dump
+  OK_Dump,
+  OK_Count
 };
 
 enum QueryKind {
@@ -30,8 +33,10 @@ enum QueryKind {
   QK_Help,
   QK_Let,
   QK_Match,
+  QK_MultiMatch,
   QK_SetBool,
   QK_SetOutputKind,
+  QK_SetUnsigned,
 };
 
 class QuerySession;
@@ -87,6 +92,19 @@ struct MatchQuery : Query {
   static bool classof(const Query *Q) { return Q->Kind == QK_Match; }
 };
 
+/// Several consecutive "match MATCHER" queries, answered in a single
+/// traversal of each AST. The output is the same as running the queries one
+/// after the other.
+struct MultiMatchQuery : Query {
+  MultiMatchQuery(ArrayRef<ast_matchers::dynamic::DynTypedMatcher> Matchers)
+      : Query(QK_MultiMatch), Matchers(Matchers.begin(), Matchers.end()) {}
+  bool run(llvm::raw_ostream &OS, QuerySession &QS) const override;
+
+  std::vector<ast_matchers::dynamic::DynTypedMatcher> Matchers;
+
+  static bool classof(const Query *Q) { return Q->Kind == QK_MultiMatch; }
+};
+
 struct LetQuery : Query {
   LetQuery(StringRef Name, const ast_matchers::dynamic::VariantValue &Value)
       : Query(QK_Let), Name(Name), Value(Value) {}
@@ -108,6 +126,10 @@ template <> struct SetQueryKind<OutputKind> {
   static const QueryKind value = QK_SetOutputKind;
 };
 
+template <> struct SetQueryKind<unsigned> {
+  static const QueryKind value = QK_SetUnsigned;
+};
+
 /// Query for "set VAR VALUE".
 template <typename T> struct SetQuery : Query {
   SetQuery(T QuerySession::*Var, T Value)
@@ -116,14 +116,24 @@ QueryRef QueryParser::parseSetOutputKind() {
                          .Case("diag", OK_Diag)
                          .Case("print", OK_Print)
                          .Case("dump", OK_Dump)
+                         .Case("count", OK_Count)
                          .Default(~0u);
   if (OutKind == ~0u) {
-    return new InvalidQuery("expected 'diag', 'print' or 'dump', got '" +
-                            ValStr + "'");
+    return new InvalidQuery("expected 'diag', 'print', 'dump' or 'count', "
+                            "got '" + ValStr + "'");
   }
   return new SetQuery<OutputKind>(&QuerySession::OutKind, OutputKind(OutKind));
 }
 
+QueryRef QueryParser::parseSetUnsigned(unsigned QuerySession::*Var) {
+  StringRef ValStr = lexWord();
+  unsigned Value;
+  if (ValStr.getAsInteger(10, Value)) {
+    return new InvalidQuery("expected a number, got '" + ValStr + "'");
+  }
+  return new SetQuery<unsigned>(Var, Value);
+}
+
 QueryRef QueryParser::endQuery(QueryRef Q) {
   const char *Extra = Begin;
   if (!lexWord().empty())
@@ -147,7 +157,8 @@ enum ParsedQueryKind {
 enum ParsedQueryVariable {
   PQV_Invalid,
   PQV_Output,
-  PQV_BindRoot
+  PQV_BindRoot,
+  PQV_Limit
 };
 
 QueryRef makeInvalidQueryFromDiagnostics(const Diagnostics &Diag) {
@@ -227,6 +238,7 @@ QueryRef QueryParser::doParse() {
     ParsedQueryVariable Var = lexOrCompleteWord<ParsedQueryVariable>(VarStr)
                                   .Case("output", PQV_Output)
                                   .Case("bind-root", PQV_BindRoot)
+                                  .Case("limit", PQV_Limit)
                                   .Default(PQV_Invalid);
     if (VarStr.empty())
       return new InvalidQuery("expected variable name");
@@ -241,6 +253,9 @@ QueryRef QueryParser::doParse() {
     case PQV_BindRoot:
       Q = parseSetBool(&QuerySession::BindRoot);
       break;
+    case PQV_Limit:
+      Q = parseSetUnsigned(&QuerySession::Limit);
+      break;
     case PQV_Invalid:
       llvm_unreachable("Invalid query kind");
     }
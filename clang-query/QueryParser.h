@@ -47,6 +47,7 @@ private:
 
   QueryRef parseSetBool(bool QuerySession::*Var);
   QueryRef parseSetOutputKind();
+  QueryRef parseSetUnsigned(unsigned QuerySession::*Var);
   QueryRef completeMatcherExpression();
 
   QueryRef endQuery(QueryRef Q);
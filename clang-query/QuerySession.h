@@ -25,11 +25,16 @@ namespace query {
 class QuerySession {
 public:
   QuerySession(llvm::ArrayRef<std::unique_ptr<ASTUnit>> ASTs)
-      : ASTs(ASTs), OutKind(OK_Diag), BindRoot(true) {}
+      : ASTs(ASTs), OutKind(OK_Diag), BindRoot(true), Limit(0),
+        PrintTiming(false) {}
 
   llvm::ArrayRef<std::unique_ptr<ASTUnit>> ASTs;
   OutputKind OutKind;
   bool BindRoot;
+  /// The maximum number of matches of a match query, or 0 for no limit.
+  unsigned Limit;
+  /// Whether to print the time taken by each match query to stderr.
+  bool PrintTiming;
   llvm::StringMap<ast_matchers::dynamic::VariantValue> NamedValues;
 };
 
@@ -30,14 +30,27 @@
 #include "QueryParser.h"
 #include "QuerySession.h"
 #include "clang/Frontend/ASTUnit.h"
+#include "clang/Frontend/CompilerInstance.h"
 #include "clang/Tooling/CommonOptionsParser.h"
 #include "clang/Tooling/Tooling.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringExtras.h"
 #include "llvm/LineEditor/LineEditor.h"
 #include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/MD5.h"
 #include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
 #include "llvm/Support/Signals.h"
+#include "llvm/Support/Threading.h"
+#include "llvm/Support/Timer.h"
+#include <algorithm>
+#include <atomic>
 #include <fstream>
+#include <map>
 #include <string>
+#include <thread>
 
 using namespace clang;
 using namespace clang::ast_matchers;
@@ -58,6 +71,234 @@ static cl::list<std::string> CommandFiles("f",
                                           cl::value_desc("file"),
                                           cl::cat(ClangQueryCategory));
 
+static cl::opt<unsigned> Jobs("j",
+                              cl::desc("Number of threads building the ASTs, "
+                                       "or 0 for the number of hardware "
+                                       "threads. More than one thread "
+                                       "requires the paths in the compile "
+                                       "commands to be absolute. Queries "
+                                       "match one AST at a time"),
+                              cl::init(1), cl::cat(ClangQueryCategory));
+
+static cl::opt<bool> PrintTiming("time",
+                                 cl::desc("Print the time taken to build the "
+                                          "ASTs and by each match query"),
+                                 cl::cat(ClangQueryCategory));
+
+static cl::opt<bool> Batch("batch",
+                           cl::desc("Answer consecutive match queries of the "
+                                    "-c and -f commands in a single traversal "
+                                    "of each AST"),
+                           cl::cat(ClangQueryCategory));
+
+static cl::opt<std::string> SnapshotDir(
+    "snapshot-dir",
+    cl::desc("Load the ASTs from the snapshots saved in <dir> when they are "
+             "up to date, and save the ASTs that had to be built there"),
+    cl::value_desc("dir"), cl::cat(ClangQueryCategory));
+
+/// Gets the paths of the snapshots of the ASTs of \p File, one for each of
+/// its compile commands. The paths contain the MD5 hash of the file and of
+/// its compile commands, which is the same in every session, so the
+/// snapshots of a file whose compile commands changed are never used.
+static std::vector<std::string>
+getSnapshotPaths(const CompilationDatabase &Compilations, StringRef File) {
+  std::vector<CompileCommand> FileCommands =
+      Compilations.getCompileCommands(File);
+  // Terminate each string so that moving characters from one to the next
+  // changes the hash.
+  llvm::MD5 Hash;
+  auto AddString = [&Hash](StringRef Str) {
+    Hash.update(Str);
+    Hash.update(StringRef("", 1));
+  };
+  AddString(File);
+  for (const CompileCommand &Command : FileCommands) {
+    AddString(Command.Directory);
+    AddString(utostr(Command.CommandLine.size()));
+    for (const std::string &Arg : Command.CommandLine)
+      AddString(Arg);
+  }
+  llvm::MD5::MD5Result Result;
+  Hash.final(Result);
+  SmallString<32> Digest;
+  llvm::MD5::stringifyResult(Result, Digest);
+
+  std::vector<std::string> Paths;
+  for (unsigned I = 0, E = FileCommands.size(); I != E; ++I) {
+    SmallString<256> Path(SnapshotDir);
+    llvm::sys::path::append(Path, llvm::sys::path::filename(File) + "-" +
+                                      Digest.str() + "-" + Twine(I) + ".ast");
+    Paths.push_back(Path.str());
+  }
+  return Paths;
+}
+
+/// Loads the snapshots of the ASTs of \p File. Returns false, loading none,
+/// if any of them is missing or out of date: the AST reader checks that none
+/// of the user files the AST was built from changed.
+static bool loadSnapshots(const CompilationDatabase &Compilations,
+                          StringRef File,
+                          std::vector<std::unique_ptr<ASTUnit>> &ASTs) {
+  std::vector<std::unique_ptr<ASTUnit>> Loaded;
+  for (const std::string &Path : getSnapshotPaths(Compilations, File)) {
+    if (!llvm::sys::fs::exists(Path))
+      return false;
+    // A snapshot which can't be used is silently rebuilt.
+    IntrusiveRefCntPtr<DiagnosticsEngine> Diags =
+        CompilerInstance::createDiagnostics(new DiagnosticOptions,
+                                            new IgnoringDiagConsumer);
+    std::unique_ptr<ASTUnit> AST =
+        ASTUnit::LoadFromASTFile(Path, Diags, FileSystemOptions());
+    if (!AST)
+      return false;
+    Loaded.push_back(std::move(AST));
+  }
+  if (Loaded.empty())
+    return false;
+  for (auto &AST : Loaded)
+    ASTs.push_back(std::move(AST));
+  return true;
+}
+
+/// Saves snapshots of the ASTs of \p File, to be loaded by later sessions.
+static void saveSnapshots(const CompilationDatabase &Compilations,
+                          StringRef File,
+                          const std::vector<std::unique_ptr<ASTUnit>> &ASTs) {
+  std::vector<std::string> Paths = getSnapshotPaths(Compilations, File);
+  if (Paths.size() != ASTs.size())
+    return;
+  for (unsigned I = 0, E = ASTs.size(); I != E; ++I)
+    // ASTUnit::Save writes to a temporary file and renames it, so a
+    // concurrent session never loads a partially written snapshot.
+    if (ASTs[I]->Save(Paths[I]))
+      llvm::errs() << "clang-query: cannot save snapshot " << Paths[I] << "\n";
+}
+
+/// Builds the ASTs of the files sharing a compile command directory, on up
+/// to \p Jobs threads. The AST of the file \p Indexes[I] is stored in
+/// \p FileASTs[Indexes[I]].
+static bool buildDirectoryASTs(
+    const CompilationDatabase &Compilations,
+    const std::vector<std::string> &Files, const std::vector<unsigned> &Indexes,
+    std::vector<std::vector<std::unique_ptr<ASTUnit>>> &FileASTs,
+    std::atomic<unsigned> &NumLoaded) {
+  unsigned NumFiles = Indexes.size();
+  unsigned NumWorkers = Jobs ? unsigned(Jobs)
+                             : std::thread::hardware_concurrency();
+  if (!llvm::llvm_is_multithreaded() || NumWorkers == 0)
+    NumWorkers = 1;
+  NumWorkers = std::min(NumWorkers, NumFiles);
+
+  std::atomic<unsigned> NextFile(0);
+  std::atomic<bool> HadErrors(false);
+  auto Worker = [&]() {
+    for (unsigned I = NextFile++; I < NumFiles; I = NextFile++) {
+      const std::string &File = Files[Indexes[I]];
+      std::vector<std::unique_ptr<ASTUnit>> &ASTs = FileASTs[Indexes[I]];
+      if (!SnapshotDir.empty() && loadSnapshots(Compilations, File, ASTs)) {
+        ++NumLoaded;
+        continue;
+      }
+      ClangTool Tool(Compilations, File);
+      if (Tool.buildASTs(ASTs) != 0)
+        HadErrors = true;
+      else if (!SnapshotDir.empty())
+        saveSnapshots(Compilations, File, ASTs);
+    }
+  };
+
+  if (NumWorkers <= 1) {
+    Worker();
+  } else {
+    std::vector<std::thread> Workers;
+    for (unsigned I = 0; I < NumWorkers; ++I)
+      Workers.push_back(std::thread(Worker));
+    for (std::thread &T : Workers)
+      T.join();
+  }
+  return !HadErrors;
+}
+
+/// Builds the ASTs of \p Files in parallel, or loads them from their
+/// snapshots, and appends them to \p ASTs in the order of the files, as
+/// ClangTool::buildASTs does.
+///
+/// The tool changes the current directory to the directory of the compile
+/// command, which is process-wide, so only the files sharing a directory are
+/// built in parallel. A tool also restores the directory it started in when
+/// done, while the others may still be building, so relative paths in the
+/// compile commands are only safe with a single job.
+static bool buildASTs(const CompilationDatabase &Compilations,
+                      const std::vector<std::string> &Files,
+                      std::vector<std::unique_ptr<ASTUnit>> &ASTs) {
+  std::map<std::string, std::vector<unsigned>> FilesByDirectory;
+  for (unsigned I = 0, E = Files.size(); I != E; ++I) {
+    auto Commands = Compilations.getCompileCommands(Files[I]);
+    FilesByDirectory[Commands.empty() ? "" : Commands.front().Directory]
+        .push_back(I);
+  }
+
+  if (!SnapshotDir.empty())
+    llvm::sys::fs::create_directories(SnapshotDir);
+
+  std::vector<std::vector<std::unique_ptr<ASTUnit>>> FileASTs(Files.size());
+  std::atomic<unsigned> NumLoaded(0);
+  bool Success = true;
+  for (const auto &Group : FilesByDirectory)
+    if (!buildDirectoryASTs(Compilations, Files, Group.second, FileASTs,
+                            NumLoaded))
+      Success = false;
+  if (PrintTiming && !SnapshotDir.empty())
+    llvm::errs() << "clang-query: loaded " << NumLoaded << " of "
+                 << Files.size() << " files from snapshots\n";
+
+  for (auto &Built : FileASTs)
+    for (auto &AST : Built)
+      ASTs.push_back(std::move(AST));
+  return Success;
+}
+
+namespace {
+
+/// Runs the queries given with -c or -f. With -batch, consecutive match
+/// queries are held back and answered together by a MultiMatchQuery when a
+/// query which may change the session, or the end of the commands, is
+/// reached.
+class CommandRunner {
+public:
+  CommandRunner(QuerySession &QS) : QS(QS) {}
+
+  bool run(StringRef Line) {
+    QueryRef Q = QueryParser::parse(Line, QS);
+    if (Batch) {
+      if (auto *Match = dyn_cast<MatchQuery>(Q.get())) {
+        PendingMatchers.push_back(Match->Matcher);
+        return true;
+      }
+      if (isa<NoOpQuery>(Q.get()))
+        return true;
+    }
+    if (!flush())
+      return false;
+    return Q->run(llvm::outs(), QS);
+  }
+
+  bool flush() {
+    if (PendingMatchers.empty())
+      return true;
+    MultiMatchQuery Q(PendingMatchers);
+    PendingMatchers.clear();
+    return Q.run(llvm::outs(), QS);
+  }
+
+private:
+  QuerySession &QS;
+  std::vector<DynTypedMatcher> PendingMatchers;
+};
+
+} // namespace
+
 int main(int argc, const char **argv) {
   llvm::sys::PrintStackTraceOnErrorSignal();
 
@@ -68,23 +309,32 @@ int main(int argc, const char **argv) {
     return 1;
   }
 
-  ClangTool Tool(OptionsParser.getCompilations(),
-                 OptionsParser.getSourcePathList());
+  double StartTime = TimeRecord::getCurrentTime(false).getWallTime();
   std::vector<std::unique_ptr<ASTUnit>> ASTs;
-  if (Tool.buildASTs(ASTs) != 0)
+  if (!buildASTs(OptionsParser.getCompilations(),
+                 OptionsParser.getSourcePathList(), ASTs))
     return 1;
+  if (PrintTiming)
+    llvm::errs() << format("clang-query: built %u ASTs in %.3fs\n",
+                           unsigned(ASTs.size()),
+                           TimeRecord::getCurrentTime(false).getWallTime() -
+                               StartTime);
 
   QuerySession QS(ASTs);
+  QS.PrintTiming = PrintTiming;
 
   if (!Commands.empty()) {
+    CommandRunner Runner(QS);
     for (cl::list<std::string>::iterator I = Commands.begin(),
                                          E = Commands.end();
          I != E; ++I) {
-      QueryRef Q = QueryParser::parse(I->c_str(), QS);
-      if (!Q->run(llvm::outs(), QS))
+      if (!Runner.run(*I))
         return 1;
     }
+    if (!Runner.flush())
+      return 1;
   } else if (!CommandFiles.empty()) {
+    CommandRunner Runner(QS);
     for (cl::list<std::string>::iterator I = CommandFiles.begin(),
                                          E = CommandFiles.end();
          I != E; ++I) {
@@ -97,11 +347,12 @@ int main(int argc, const char **argv) {
         std::string Line;
         std::getline(Input, Line);
 
-        QueryRef Q = QueryParser::parse(Line.c_str(), QS);
-        if (!Q->run(llvm::outs(), QS))
+        if (!Runner.run(Line))
           return 1;
       }
     }
+    if (!Runner.flush())
+      return 1;
   } else {
     LineEditor LE("clang-query");
     LE.setListCompleter([&QS](StringRef Line, size_t Pos) {
@@ -0,0 +1,90 @@
+//===--- tools/extra/clang-rename/ASTRenamer.cpp - Clang rename tool ------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// \brief Implements renaming with one parse of each file.
+///
+//===----------------------------------------------------------------------===//
+
+#include "ASTRenamer.h"
+#include "RenamingAction.h"
+#include "USRFindingAction.h"
+#include "clang/AST/ASTContext.h"
+#include "clang/Frontend/ASTUnit.h"
+#include "clang/Tooling/CompilationDatabase.h"
+#include "clang/Tooling/Tooling.h"
+
+using namespace llvm;
+
+namespace clang {
+namespace rename {
+
+ASTRenamer::ASTRenamer(const tooling::CompilationDatabase &Compilations,
+                       const std::vector<std::string> &Files, bool Streaming)
+    : Compilations(Compilations), Files(Files), Streaming(Streaming),
+      HadErrors(false) {
+}
+
+ASTRenamer::~ASTRenamer() {
+}
+
+bool ASTRenamer::findUSRs(unsigned SymbolOffset) {
+  if (Files.empty())
+    return false;
+
+  // In streaming mode, only parse the file of the symbol for now.
+  std::vector<std::string> ParsedFiles(Files.begin(),
+                                       Streaming ? Files.begin() + 1
+                                                 : Files.end());
+  tooling::ClangTool Tool(Compilations, ParsedFiles);
+  if (Tool.buildASTs(ASTs) != 0)
+    HadErrors = true;
+
+  // The symbol is looked for in the first AST of the first file. The main
+  // files of the ASTs have absolute paths.
+  std::string MainFile = tooling::getAbsolutePath(Files.front());
+  for (const auto &AST : ASTs) {
+    if (AST->getMainFileName() != MainFile)
+      continue;
+    USRs.clear();
+    SpellingName.clear();
+    return findUSRsAtOffset(AST->getASTContext(), SymbolOffset, USRs,
+                            SpellingName);
+  }
+  errs() << "clang-rename: could not parse " << Files.front() << ".\n";
+  return false;
+}
+
+int ASTRenamer::rename(const std::string &NewName, bool PrintLocations,
+                       tooling::Replacements &Replaces) {
+  // Collect the locations in the ASTs we already have, releasing each one as
+  // soon as we are done with it.
+  for (auto &AST : ASTs) {
+    addRenamingReplacements(AST->getASTContext(), NewName, SpellingName, USRs,
+                            Replaces, PrintLocations);
+    AST.reset();
+  }
+  ASTs.clear();
+
+  int Result = HadErrors ? 1 : 0;
+  if (Streaming && Files.size() > 1) {
+    // Parse the other files one at a time; the tool frees each AST when the
+    // action is done with it.
+    std::vector<std::string> OtherFiles(Files.begin() + 1, Files.end());
+    tooling::ClangTool Tool(Compilations, OtherFiles);
+    RenamingAction Action(NewName, SpellingName, USRs, Replaces,
+                          PrintLocations);
+    if (Tool.run(tooling::newFrontendActionFactory(&Action).get()) != 0)
+      Result = 1;
+  }
+  return Result;
+}
+
+} // namespace rename
+} // namespace clang
@@ -0,0 +1,78 @@
+//===--- tools/extra/clang-rename/ASTRenamer.h - Clang rename tool --------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// \brief Provides renaming that parses each file only once: the ASTs used
+/// to find the USRs at a point are kept to find the locations to rename.
+///
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_CLANG_TOOLS_EXTRA_CLANG_RENAME_AST_RENAMER_H
+#define LLVM_CLANG_TOOLS_EXTRA_CLANG_RENAME_AST_RENAMER_H
+
+#include "clang/Tooling/Refactoring.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace clang {
+class ASTUnit;
+
+namespace tooling {
+class CompilationDatabase;
+}
+
+namespace rename {
+
+// Renames the symbol at an offset in the first of the files, in all the files.
+//
+// By default, the ASTs of all the files are built at once and kept until the
+// renaming is done. In streaming mode, only the ASTs of the first file are
+// built to find the USRs; the other files are then parsed one at a time, so
+// only one AST is in memory at any time.
+class ASTRenamer {
+public:
+  ASTRenamer(const tooling::CompilationDatabase &Compilations,
+             const std::vector<std::string> &Files, bool Streaming);
+  ~ASTRenamer();
+
+  // Parses the files, and finds the USRs at the offset in the first file and
+  // the spelling of the symbol. Returns false if the first file couldn't be
+  // parsed or there is no symbol at the offset.
+  bool findUSRs(unsigned SymbolOffset);
+
+  const std::string &getUSRSpelling() const {
+    return SpellingName;
+  }
+
+  const std::vector<std::string> &getUSRs() const {
+    return USRs;
+  }
+
+  // Adds the replacements renaming the symbol in all the files, reusing the
+  // ASTs built by findUSRs. The ASTs are released afterwards. Returns
+  // non-zero if any of the files failed to parse.
+  int rename(const std::string &NewName, bool PrintLocations,
+             tooling::Replacements &Replaces);
+
+private:
+  const tooling::CompilationDatabase &Compilations;
+  const std::vector<std::string> &Files;
+  bool Streaming;
+  // Set if building the ASTs failed for any of the files.
+  bool HadErrors;
+  std::vector<std::unique_ptr<ASTUnit>> ASTs;
+  std::string SpellingName;
+  std::vector<std::string> USRs;
+};
+
+}
+}
+
+#endif // LLVM_CLANG_TOOLS_EXTRA_CLANG_RENAME_AST_RENAMER_H
@@ -0,0 +1,158 @@
+//===--- tools/extra/clang-rename/ProjectRename.cpp - Clang rename tool ---===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// \brief Implements renaming a symbol in every file of a compilation
+/// database, with a pool of worker threads.
+///
+//===----------------------------------------------------------------------===//
+
+#include "ProjectRename.h"
+#include "RenamingAction.h"
+#include "clang/Tooling/CompilationDatabase.h"
+#include "clang/Tooling/Tooling.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/Threading.h"
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <thread>
+
+using namespace llvm;
+
+namespace clang {
+namespace rename {
+
+std::vector<std::string>
+filterFilesBySpelling(const std::vector<std::string> &Files,
+                      const std::string &Spelling) {
+  std::vector<std::string> Filtered;
+  for (const auto &File : Files) {
+    auto Buffer = MemoryBuffer::getFile(File);
+    // Keep the files we can't read, so the tool reports the error.
+    if (!Buffer ||
+        Buffer.get()->getBuffer().find(Spelling) != StringRef::npos)
+      Filtered.push_back(File);
+  }
+  return Filtered;
+}
+
+std::string getNormalizedPath(StringRef Directory, StringRef Path) {
+  SmallString<256> AbsolutePath;
+  if (sys::path::is_relative(Path))
+    AbsolutePath = Directory;
+  sys::path::append(AbsolutePath, Path);
+
+  SmallString<256> Result(sys::path::root_path(AbsolutePath));
+  SmallVector<StringRef, 16> Components;
+  for (auto I = sys::path::begin(sys::path::relative_path(AbsolutePath)),
+            E = sys::path::end(sys::path::relative_path(AbsolutePath));
+       I != E; ++I) {
+    if (*I == ".")
+      continue;
+    if (*I == "..") {
+      if (!Components.empty())
+        Components.pop_back();
+      continue;
+    }
+    Components.push_back(*I);
+  }
+  for (StringRef Component : Components)
+    sys::path::append(Result, Component);
+  return Result.str();
+}
+
+// Calls Fn for the files sharing a compile command directory, in parallel.
+static bool forEachDirectoryFileInParallel(
+    StringRef Directory, const std::vector<unsigned> &Indexes, unsigned Jobs,
+    const std::function<bool(unsigned Index, StringRef Directory)> &Fn) {
+  // Determine the number of worker threads.
+  unsigned NumFiles = Indexes.size();
+  unsigned NumWorkers = Jobs ? Jobs : std::thread::hardware_concurrency();
+  if (!llvm::llvm_is_multithreaded() || NumWorkers == 0)
+    NumWorkers = 1;
+  NumWorkers = std::min(NumWorkers, NumFiles);
+
+  std::atomic<unsigned> NextFile(0);
+  std::atomic<bool> HadErrors(false);
+  auto Worker = [&]() {
+    for (unsigned I = NextFile++; I < NumFiles; I = NextFile++)
+      if (!Fn(Indexes[I], Directory))
+        HadErrors = true;
+  };
+
+  if (NumWorkers == 1) {
+    Worker();
+  } else {
+    std::vector<std::thread> Workers;
+    for (unsigned I = 0; I < NumWorkers; ++I)
+      Workers.push_back(std::thread(Worker));
+    for (std::thread &T : Workers)
+      T.join();
+  }
+
+  return !HadErrors;
+}
+
+bool forEachFileInParallel(
+    const tooling::CompilationDatabase &Compilations,
+    const std::vector<std::string> &Files, unsigned Jobs,
+    const std::function<bool(unsigned Index, StringRef Directory)> &Fn) {
+  // Group the files by the directory of their compile command, in which the
+  // tool runs them.
+  std::map<std::string, std::vector<unsigned>> FilesByDirectory;
+  for (unsigned I = 0, E = Files.size(); I != E; ++I) {
+    auto Commands = Compilations.getCompileCommands(Files[I]);
+    FilesByDirectory[Commands.empty() ? "" : Commands.front().Directory]
+        .push_back(I);
+  }
+
+  bool Success = true;
+  for (const auto &Group : FilesByDirectory)
+    if (!forEachDirectoryFileInParallel(Group.first, Group.second, Jobs, Fn))
+      Success = false;
+  return Success;
+}
+
+int renameInFiles(const tooling::CompilationDatabase &Compilations,
+                  const std::vector<std::string> &Files,
+                  const std::string &NewName, const std::string &PrevName,
+                  const std::vector<std::string> &USRs, unsigned Jobs,
+                  bool PrintLocations, tooling::Replacements &Replaces) {
+  // Each file gets its own replacements, so the workers don't share any
+  // mutable state.
+  std::vector<tooling::Replacements> FileReplaces(Files.size());
+  bool Success = forEachFileInParallel(
+      Compilations, Files, Jobs, [&](unsigned Index, StringRef Directory) {
+        tooling::Replacements Found;
+        RenamingAction Action(NewName, PrevName, USRs, Found, PrintLocations);
+        tooling::ClangTool Tool(Compilations, Files[Index]);
+        int Result =
+            Tool.run(tooling::newFrontendActionFactory(&Action).get());
+        // Make the paths comparable across translation units.
+        for (const auto &Replace : Found)
+          FileReplaces[Index].insert(tooling::Replacement(
+              getNormalizedPath(Directory, Replace.getFilePath()),
+              Replace.getOffset(), Replace.getLength(),
+              Replace.getReplacementText()));
+        return Result == 0;
+      });
+
+  // Merge the replacements. Replacements is a set, so the replacements
+  // made by several translation units in the same header are only kept once.
+  for (const auto &Found : FileReplaces)
+    Replaces.insert(Found.begin(), Found.end());
+
+  return Success ? 0 : 1;
+}
+
+} // namespace rename
+} // namespace clang
@@ -0,0 +1,75 @@
+//===--- tools/extra/clang-rename/ProjectRename.h - Clang rename tool -----===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// \brief Provides functionality for renaming a symbol in every file of a
+/// compilation database.
+///
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_CLANG_TOOLS_EXTRA_CLANG_RENAME_PROJECT_RENAME_H
+#define LLVM_CLANG_TOOLS_EXTRA_CLANG_RENAME_PROJECT_RENAME_H
+
+#include "clang/Tooling/Refactoring.h"
+#include "llvm/ADT/StringRef.h"
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace clang {
+namespace tooling {
+class CompilationDatabase;
+}
+
+namespace rename {
+
+// Returns the files that contain the spelling of the symbol. A file that
+// doesn't contain it can't reference the symbol itself, although a header it
+// includes may.
+std::vector<std::string>
+filterFilesBySpelling(const std::vector<std::string> &Files,
+                      const std::string &Spelling);
+
+// Makes a path absolute, relative to the directory of a compile command, and
+// removes its "." and ".." components, so a file reached through different
+// relative paths gets the same path.
+std::string getNormalizedPath(StringRef Directory, StringRef Path);
+
+// Calls Fn with the index of each file and the directory of its compile
+// command, on up to Jobs worker threads (0 for the number of hardware
+// threads). Fn typically runs a tool on the file.
+//
+// The tools change the current directory to the directory of the compile
+// command, which is process-wide, so only the files sharing a directory are
+// run in parallel. Even then, a tool restores the directory it started in
+// when done, while the other tools of the group may still be running, so
+// relative paths in the compile commands are only safe with a single job.
+//
+// Returns false if any call to Fn returned false.
+bool forEachFileInParallel(
+    const tooling::CompilationDatabase &Compilations,
+    const std::vector<std::string> &Files, unsigned Jobs,
+    const std::function<bool(unsigned Index, StringRef Directory)> &Fn);
+
+// Runs the renaming action over each file, in parallel, and merges the
+// replacements of all the files into Replaces. Each file gets its own tool,
+// so a header renamed by several translation units only gets one replacement
+// for each location.
+//
+// Returns non-zero if any of the files failed to compile.
+int renameInFiles(const tooling::CompilationDatabase &Compilations,
+                  const std::vector<std::string> &Files,
+                  const std::string &NewName, const std::string &PrevName,
+                  const std::vector<std::string> &USRs, unsigned Jobs,
+                  bool PrintLocations, tooling::Replacements &Replaces);
+
+}
+}
+
+#endif // LLVM_CLANG_TOOLS_EXTRA_CLANG_RENAME_PROJECT_RENAME_H
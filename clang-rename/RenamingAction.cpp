@@ -35,6 +35,32 @@ using namespace llvm;
 namespace clang {
 namespace rename {
 
+void addRenamingReplacements(ASTContext &Context, const std::string &NewName,
+                             const std::string &PrevName,
+                             const std::vector<std::string> &USRs,
+                             tooling::Replacements &Replaces,
+                             bool PrintLocations) {
+  const auto &SourceMgr = Context.getSourceManager();
+  // Find the locations of all the USRs in one traversal.
+  std::vector<SourceLocation> RenamingCandidates =
+      getLocationsOfUSRs(USRs, Context.getTranslationUnitDecl());
+
+  auto PrevNameLen = PrevName.length();
+  if (PrintLocations)
+    for (const auto &Loc : RenamingCandidates) {
+      FullSourceLoc FullLoc(Loc, SourceMgr);
+      errs() << "clang-rename: renamed at: " << SourceMgr.getFilename(Loc)
+             << ":" << FullLoc.getSpellingLineNumber() << ":"
+             << FullLoc.getSpellingColumnNumber() << "\n";
+      Replaces.insert(tooling::Replacement(SourceMgr, Loc, PrevNameLen,
+                                           NewName));
+    }
+  else
+    for (const auto &Loc : RenamingCandidates)
+      Replaces.insert(tooling::Replacement(SourceMgr, Loc, PrevNameLen,
+                                           NewName));
+}
+
 class RenamingASTConsumer : public ASTConsumer {
 public:
   RenamingASTConsumer(const std::string &NewName,
@@ -47,31 +73,8 @@ public:
   }
 
   void HandleTranslationUnit(ASTContext &Context) override {
-    const auto &SourceMgr = Context.getSourceManager();
-    std::vector<SourceLocation> RenamingCandidates;
-    std::vector<SourceLocation> NewCandidates;
-
-    for (const auto &USR : USRs) {
-      NewCandidates = getLocationsOfUSR(USR, Context.getTranslationUnitDecl());
-      RenamingCandidates.insert(RenamingCandidates.end(), NewCandidates.begin(),
-                                NewCandidates.end());
-      NewCandidates.clear();
-    }
-
-    auto PrevNameLen = PrevName.length();
-    if (PrintLocations)
-      for (const auto &Loc : RenamingCandidates) {
-        FullSourceLoc FullLoc(Loc, SourceMgr);
-        errs() << "clang-rename: renamed at: " << SourceMgr.getFilename(Loc)
-               << ":" << FullLoc.getSpellingLineNumber() << ":"
-               << FullLoc.getSpellingColumnNumber() << "\n";
-        Replaces.insert(tooling::Replacement(SourceMgr, Loc, PrevNameLen,
-                                             NewName));
-      }
-    else
-      for (const auto &Loc : RenamingCandidates)
-        Replaces.insert(tooling::Replacement(SourceMgr, Loc, PrevNameLen,
-                                             NewName));
+    addRenamingReplacements(Context, NewName, PrevName, USRs, Replaces,
+                            PrintLocations);
   }
 
 private:
@@ -19,10 +19,19 @@
 
 namespace clang {
 class ASTConsumer;
+class ASTContext;
 class CompilerInstance;
 
 namespace rename {
 
+// \brief Adds the replacements renaming the occurrences of the USRs in the
+// translation unit.
+void addRenamingReplacements(ASTContext &Context, const std::string &NewName,
+                             const std::string &PrevName,
+                             const std::vector<std::string> &USRs,
+                             tooling::Replacements &Replaces,
+                             bool PrintLocations = false);
+
 class RenamingAction {
 public:
   RenamingAction(const std::string &NewName, const std::string &PrevName,
@@ -0,0 +1,873 @@
+//===--- tools/extra/clang-rename/SymbolIndex.cpp - Clang rename tool -----===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// \brief Implements the persistent index of symbol occurrences.
+///
+/// The index file starts with the magic string, followed by the number of
+/// records of each table, the tables, and the string table:
+///
+///   Files:             path offset, path length
+///   Symbols:           USR offset, USR length, name offset, name length,
+///                      kind, parent symbol, first symbol occurrence,
+///                      number of symbol occurrences
+///   TranslationUnits:  main file, first dependency, number of dependencies,
+///                      first occurrence, number of occurrences
+///   Dependencies:      file, modification time (low, high), size (low, high)
+///   Occurrences:       symbol, file, offset, length, role
+///   SymbolOccurrences: occurrence
+///   FileOccurrences:   occurrence
+///   FileDependencies:  dependency
+///
+/// Files are sorted by path and symbols by USR, so they can be found by
+/// binary search. The occurrences of each symbol are listed contiguously in
+/// SymbolOccurrences. FileOccurrences lists all the occurrences sorted by
+/// file and offset, and FileDependencies all the dependencies sorted by file,
+/// so those of a file are found by binary search too.
+///
+//===----------------------------------------------------------------------===//
+
+#include "SymbolIndex.h"
+#include "ProjectRename.h"
+#include "USRFinder.h"
+#include "clang/AST/ASTConsumer.h"
+#include "clang/AST/ASTContext.h"
+#include "clang/AST/RecursiveASTVisitor.h"
+#include "clang/Basic/FileManager.h"
+#include "clang/Basic/SourceManager.h"
+#include "clang/Tooling/CompilationDatabase.h"
+#include "clang/Tooling/Refactoring.h"
+#include "clang/Tooling/Tooling.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <map>
+#include <set>
+#include <tuple>
+
+using namespace llvm;
+
+namespace clang {
+namespace rename {
+
+static const char IndexMagic[8] = {'C', 'R', 'N', 'I', 'D', 'X', '0', '2'};
+
+// The tables of the index, in file order.
+enum TableKind {
+  TK_Files,
+  TK_Symbols,
+  TK_TranslationUnits,
+  TK_Dependencies,
+  TK_Occurrences,
+  TK_SymbolOccurrences,
+  TK_FileOccurrences,
+  TK_FileDependencies,
+  TK_NumberOfTables
+};
+
+// The number of 32-bit fields of the records of each table.
+static const unsigned TableFields[TK_NumberOfTables] = {2, 8, 5, 5, 5, 1, 1, 1};
+
+// The size of the header: the magic string, the number of records of each
+// table, and the size of the string table.
+static const unsigned HeaderSize =
+    sizeof(IndexMagic) + 4 * (TK_NumberOfTables + 1);
+
+static const uint32_t NoSymbol = ~0U;
+
+// Returns true if the file still has the modification time and size it had
+// when it was indexed.
+static bool isFileUnchanged(StringRef Path, uint64_t ModificationTime,
+                            uint64_t Size) {
+  sys::fs::file_status Status;
+  if (sys::fs::status(Path, Status))
+    return false;
+  return Status.getLastModificationTime().toEpochTime() == ModificationTime &&
+         Status.getSize() == Size;
+}
+
+bool IndexedTranslationUnit::isUpToDate() const {
+  for (const auto &File : Files)
+    if (!isFileUnchanged(File.Path, File.ModificationTime, File.Size))
+      return false;
+  return true;
+}
+
+bool SymbolOccurrence::operator<(const SymbolOccurrence &Other) const {
+  if (File != Other.File)
+    return File < Other.File;
+  if (Offset != Other.Offset)
+    return Offset < Other.Offset;
+  if (Length != Other.Length)
+    return Length < Other.Length;
+  return Role < Other.Role;
+}
+
+bool SymbolOccurrence::operator==(const SymbolOccurrence &Other) const {
+  return File == Other.File && Offset == Other.Offset &&
+         Length == Other.Length && Role == Other.Role;
+}
+
+// Indexing:
+
+namespace {
+// \brief This visitor records the occurrence of every named decl and every
+// reference to one, at the same AST nodes as USRLocFindingASTVisitor.
+class IndexingASTVisitor
+    : public clang::RecursiveASTVisitor<IndexingASTVisitor> {
+public:
+  IndexingASTVisitor(const SourceManager &SourceMgr, StringRef Directory,
+                     IndexedTranslationUnit &TU)
+      : SourceMgr(SourceMgr), Directory(Directory), TU(TU) {
+    // Record the files the translation unit depends on.
+    for (auto I = SourceMgr.fileinfo_begin(), E = SourceMgr.fileinfo_end();
+         I != E; ++I) {
+      const FileEntry *Entry = I->first;
+      IndexedFile File;
+      File.Path = getNormalizedPath(Directory, Entry->getName());
+      File.ModificationTime = Entry->getModificationTime();
+      File.Size = Entry->getSize();
+      if (FileIndexes.insert(std::make_pair(File.Path, TU.Files.size())).second)
+        TU.Files.push_back(File);
+    }
+  }
+
+  // Declaration visitors:
+
+  bool VisitNamedDecl(const NamedDecl *Decl) {
+    addOccurrence(Decl, Decl->getLocation(), OR_Declaration);
+    return true;
+  }
+
+  // Expression visitors:
+
+  bool VisitDeclRefExpr(const DeclRefExpr *Expr) {
+    checkNestedNameSpecifierLoc(Expr->getQualifierLoc());
+    addOccurrence(Expr->getFoundDecl(), Expr->getLocation(), OR_Reference);
+    return true;
+  }
+
+  bool VisitMemberExpr(const MemberExpr *Expr) {
+    addOccurrence(Expr->getFoundDecl().getDecl(), Expr->getMemberLoc(),
+                  OR_Reference);
+    return true;
+  }
+
+private:
+  // Namespace traversal:
+  void checkNestedNameSpecifierLoc(NestedNameSpecifierLoc NameLoc) {
+    while (NameLoc) {
+      const auto *Decl = NameLoc.getNestedNameSpecifier()->getAsNamespace();
+      if (Decl)
+        addOccurrence(Decl, NameLoc.getLocalBeginLoc(), OR_Reference);
+      NameLoc = NameLoc.getPrefix();
+    }
+  }
+
+  // \brief Records an occurrence of the decl, at the file and offset the
+  // renaming would replace.
+  void addOccurrence(const NamedDecl *Decl, SourceLocation Loc,
+                     OccurrenceRole Role) {
+    if (SourceMgr.isInSystemHeader(SourceMgr.getSpellingLoc(Loc)))
+      return;
+    int Symbol = getSymbol(Decl);
+    if (Symbol < 0)
+      return;
+    tooling::Replacement Location(SourceMgr, Loc, 0, "");
+    if (!Location.isApplicable())
+      return;
+    IndexedOccurrence Occurrence;
+    Occurrence.Symbol = Symbol;
+    Occurrence.File = getFile(Location.getFilePath());
+    Occurrence.Offset = Location.getOffset();
+    Occurrence.Length = TU.Symbols[Symbol].Name.size();
+    Occurrence.Role = Role;
+    TU.Occurrences.push_back(Occurrence);
+  }
+
+  // \brief Returns the index of the decl's symbol, or -1 if it has no USR.
+  int getSymbol(const NamedDecl *Decl) {
+    auto Cached = SymbolIndexes.find(Decl);
+    if (Cached != SymbolIndexes.end())
+      return Cached->second;
+    int Symbol = -1;
+    IndexedSymbol NewSymbol;
+    NewSymbol.USR = getUSRForDecl(Decl);
+    if (!NewSymbol.USR.empty()) {
+      auto Inserted =
+          USRSymbols.insert(std::make_pair(NewSymbol.USR, TU.Symbols.size()));
+      if (Inserted.second) {
+        NewSymbol.Name = Decl->getNameAsString();
+        NewSymbol.Kind = SK_Other;
+        if (const auto *Ctor = dyn_cast<CXXConstructorDecl>(Decl)) {
+          NewSymbol.Kind = SK_Constructor;
+          NewSymbol.ParentUSR = getUSRForDecl(Ctor->getParent());
+        } else if (const auto *Dtor = dyn_cast<CXXDestructorDecl>(Decl)) {
+          NewSymbol.Kind = SK_Destructor;
+          NewSymbol.ParentUSR = getUSRForDecl(Dtor->getParent());
+        }
+        TU.Symbols.push_back(NewSymbol);
+      }
+      Symbol = Inserted.first->second;
+    }
+    SymbolIndexes[Decl] = Symbol;
+    return Symbol;
+  }
+
+  // \brief Returns the index of the file in the translation unit's files.
+  unsigned getFile(StringRef Path) {
+    std::string NormalizedPath = getNormalizedPath(Directory, Path);
+    auto Inserted =
+        FileIndexes.insert(std::make_pair(NormalizedPath, TU.Files.size()));
+    if (Inserted.second) {
+      // Not a file of the source manager. Without a modification time, the
+      // translation unit is never up to date.
+      IndexedFile File;
+      File.Path = NormalizedPath;
+      File.ModificationTime = 0;
+      File.Size = 0;
+      TU.Files.push_back(File);
+    }
+    return Inserted.first->second;
+  }
+
+  const SourceManager &SourceMgr;
+  StringRef Directory;
+  IndexedTranslationUnit &TU;
+  llvm::StringMap<unsigned> FileIndexes;
+  llvm::StringMap<unsigned> USRSymbols;
+  llvm::DenseMap<const Decl *, int> SymbolIndexes;
+};
+
+class IndexingASTConsumer : public ASTConsumer {
+public:
+  IndexingASTConsumer(StringRef Directory, IndexedTranslationUnit &TU)
+      : Directory(Directory), TU(TU) {
+  }
+
+  void HandleTranslationUnit(ASTContext &Context) override {
+    const auto &SourceMgr = Context.getSourceManager();
+    // If the file has several compile commands, the last one wins.
+    TU = IndexedTranslationUnit();
+    TU.MainFile = getNormalizedPath(
+        Directory,
+        SourceMgr.getFileEntryForID(SourceMgr.getMainFileID())->getName());
+    IndexingASTVisitor Visitor(SourceMgr, Directory, TU);
+    Visitor.TraverseDecl(Context.getTranslationUnitDecl());
+  }
+
+private:
+  StringRef Directory;
+  IndexedTranslationUnit &TU;
+};
+} // namespace
+
+std::unique_ptr<ASTConsumer> IndexingAction::newASTConsumer() {
+  return llvm::make_unique<IndexingASTConsumer>(Directory, TU);
+}
+
+// Writing:
+
+namespace {
+// \brief Lays out the translation units in the tables of the index.
+class IndexWriter {
+public:
+  explicit IndexWriter(const std::vector<IndexedTranslationUnit> &TUs);
+
+  void write(raw_ostream &OS);
+
+private:
+  struct SymbolData {
+    SymbolData() : Kind(SK_Other), Index(0) {}
+    std::string Name;
+    SymbolKind Kind;
+    std::string ParentUSR;
+    unsigned Index;
+    std::vector<uint32_t> Occurrences;
+  };
+
+  uint32_t addString(StringRef Str);
+  uint32_t addFile(StringRef Path);
+
+  void addRecord(TableKind Table, ArrayRef<uint32_t> Fields) {
+    Tables[Table].insert(Tables[Table].end(), Fields.begin(), Fields.end());
+  }
+
+  static void writeWord(raw_ostream &OS, uint32_t Word) {
+    char Bytes[4] = {char(Word), char(Word >> 8), char(Word >> 16),
+                     char(Word >> 24)};
+    OS.write(Bytes, sizeof(Bytes));
+  }
+
+  std::string Strings;
+  llvm::StringMap<uint32_t> StringOffsets;
+  llvm::StringMap<uint32_t> FileIndexes;
+  std::map<std::string, SymbolData> Symbols;
+  std::vector<uint32_t> Tables[TK_NumberOfTables];
+};
+} // namespace
+
+IndexWriter::IndexWriter(const std::vector<IndexedTranslationUnit> &TUs) {
+  // Merge the symbols of all the translation units by USR.
+  for (const auto &TU : TUs) {
+    for (const auto &Symbol : TU.Symbols) {
+      SymbolData &Data = Symbols[Symbol.USR];
+      if (Data.Name.empty()) {
+        Data.Name = Symbol.Name;
+        Data.Kind = Symbol.Kind;
+        Data.ParentUSR = Symbol.ParentUSR;
+      }
+      // Make sure the class of a constructor or destructor has a symbol.
+      if (!Symbol.ParentUSR.empty())
+        Symbols[Symbol.ParentUSR];
+    }
+  }
+  unsigned NextSymbol = 0;
+  for (auto &Symbol : Symbols)
+    Symbol.second.Index = NextSymbol++;
+
+  // Lay out the files in path order.
+  std::set<std::string> Paths;
+  for (const auto &TU : TUs) {
+    Paths.insert(TU.MainFile);
+    for (const auto &File : TU.Files)
+      Paths.insert(File.Path);
+  }
+  for (const auto &Path : Paths)
+    addFile(Path);
+
+  // Lay out the translation units, their dependencies and occurrences, and
+  // collect the files of the dependencies and the locations of the
+  // occurrences to sort them.
+  unsigned NumDependencies = 0, NumOccurrences = 0;
+  std::vector<std::pair<uint32_t, uint32_t> > FileDependencies;
+  std::vector<std::tuple<uint32_t, uint32_t, uint32_t> > FileOccurrences;
+  for (const auto &TU : TUs) {
+    std::vector<uint32_t> Files;
+    for (const auto &File : TU.Files)
+      Files.push_back(addFile(File.Path));
+    addRecord(TK_TranslationUnits,
+              {addFile(TU.MainFile), NumDependencies, uint32_t(Files.size()),
+               NumOccurrences, uint32_t(TU.Occurrences.size())});
+    for (unsigned I = 0, E = TU.Files.size(); I != E; ++I) {
+      const IndexedFile &File = TU.Files[I];
+      FileDependencies.push_back(std::make_pair(Files[I], NumDependencies + I));
+      addRecord(TK_Dependencies,
+                {Files[I], uint32_t(File.ModificationTime),
+                 uint32_t(File.ModificationTime >> 32), uint32_t(File.Size),
+                 uint32_t(File.Size >> 32)});
+    }
+    NumDependencies += Files.size();
+    for (const auto &Occurrence : TU.Occurrences) {
+      SymbolData &Symbol = Symbols[TU.Symbols[Occurrence.Symbol].USR];
+      FileOccurrences.push_back(std::make_tuple(
+          Files[Occurrence.File], Occurrence.Offset, NumOccurrences));
+      Symbol.Occurrences.push_back(NumOccurrences++);
+      addRecord(TK_Occurrences,
+                {Symbol.Index, Files[Occurrence.File], Occurrence.Offset,
+                 Occurrence.Length, uint32_t(Occurrence.Role)});
+    }
+  }
+
+  // Lay out the symbols, in USR order, and their occurrences.
+  uint32_t NumSymbolOccurrences = 0;
+  for (const auto &Symbol : Symbols) {
+    const SymbolData &Data = Symbol.second;
+    uint32_t Parent = NoSymbol;
+    if (!Data.ParentUSR.empty())
+      Parent = Symbols[Data.ParentUSR].Index;
+    uint32_t USR = addString(Symbol.first);
+    uint32_t Name = addString(Data.Name);
+    addRecord(TK_Symbols,
+              {USR, uint32_t(Symbol.first.size()), Name,
+               uint32_t(Data.Name.size()), uint32_t(Data.Kind), Parent,
+               NumSymbolOccurrences, uint32_t(Data.Occurrences.size())});
+    for (uint32_t Occurrence : Data.Occurrences)
+      addRecord(TK_SymbolOccurrences, {Occurrence});
+    NumSymbolOccurrences += Data.Occurrences.size();
+  }
+
+  std::sort(FileOccurrences.begin(), FileOccurrences.end());
+  for (const auto &Occurrence : FileOccurrences)
+    addRecord(TK_FileOccurrences, {std::get<2>(Occurrence)});
+  std::sort(FileDependencies.begin(), FileDependencies.end());
+  for (const auto &Dependency : FileDependencies)
+    addRecord(TK_FileDependencies, {Dependency.second});
+}
+
+uint32_t IndexWriter::addString(StringRef Str) {
+  auto Inserted = StringOffsets.insert(std::make_pair(Str, Strings.size()));
+  if (Inserted.second)
+    Strings += Str;
+  return Inserted.first->second;
+}
+
+uint32_t IndexWriter::addFile(StringRef Path) {
+  auto Inserted = FileIndexes.insert(
+      std::make_pair(Path, Tables[TK_Files].size() / TableFields[TK_Files]));
+  if (Inserted.second)
+    addRecord(TK_Files, {addString(Path), uint32_t(Path.size())});
+  return Inserted.first->second;
+}
+
+void IndexWriter::write(raw_ostream &OS) {
+  OS.write(IndexMagic, sizeof(IndexMagic));
+  for (unsigned Table = 0; Table != TK_NumberOfTables; ++Table)
+    writeWord(OS, Tables[Table].size() / TableFields[Table]);
+  writeWord(OS, Strings.size());
+  for (unsigned Table = 0; Table != TK_NumberOfTables; ++Table)
+    for (uint32_t Word : Tables[Table])
+      writeWord(OS, Word);
+  OS << Strings;
+}
+
+bool writeSymbolIndex(StringRef Path,
+                      const std::vector<IndexedTranslationUnit> &TUs,
+                      std::string &ErrorMessage) {
+  IndexWriter Writer(TUs);
+
+  // Write to a temporary file in the same directory, then rename it.
+  SmallString<256> TempPath(Path);
+  TempPath += ".tmp";
+  {
+    std::error_code EC;
+    raw_fd_ostream OS(TempPath, EC, sys::fs::F_None);
+    if (EC) {
+      ErrorMessage = EC.message();
+      return false;
+    }
+    Writer.write(OS);
+    OS.close();
+    if (OS.has_error()) {
+      OS.clear_error();
+      ErrorMessage = "error writing " + TempPath.str().str();
+      return false;
+    }
+  }
+  if (std::error_code EC = sys::fs::rename(TempPath, Path)) {
+    ErrorMessage = EC.message();
+    return false;
+  }
+  return true;
+}
+
+// Reading:
+
+SymbolIndex::SymbolIndex(std::unique_ptr<MemoryBuffer> Buffer)
+    : Buffer(std::move(Buffer)), MaxOccurrenceLength(0) {
+}
+
+std::unique_ptr<SymbolIndex> SymbolIndex::load(StringRef Path,
+                                               std::string &ErrorMessage) {
+  auto Buffer = MemoryBuffer::getFile(Path, /*FileSize=*/-1,
+                                      /*RequiresNullTerminator=*/false);
+  if (std::error_code EC = Buffer.getError()) {
+    ErrorMessage = EC.message();
+    return nullptr;
+  }
+  std::unique_ptr<SymbolIndex> Index(new SymbolIndex(std::move(Buffer.get())));
+  if (!Index->validate(ErrorMessage))
+    return nullptr;
+  return Index;
+}
+
+static uint32_t readWord(const char *Data) {
+  const unsigned char *Bytes = reinterpret_cast<const unsigned char *>(Data);
+  return uint32_t(Bytes[0]) | (uint32_t(Bytes[1]) << 8) |
+         (uint32_t(Bytes[2]) << 16) | (uint32_t(Bytes[3]) << 24);
+}
+
+// Gets the number of records of a table.
+static unsigned getRecordCount(StringRef Data, TableKind Table) {
+  return readWord(Data.data() + sizeof(IndexMagic) + 4 * Table);
+}
+
+bool SymbolIndex::validate(std::string &ErrorMessage) {
+  StringRef Data = Buffer->getBuffer();
+  if (Data.size() < HeaderSize ||
+      !Data.startswith(StringRef(IndexMagic, sizeof(IndexMagic)))) {
+    ErrorMessage = "not a clang-rename index";
+    return false;
+  }
+  ErrorMessage = "corrupt clang-rename index";
+
+  // Compute the table offsets, checking that everything fits.
+  uint64_t Offset = HeaderSize;
+  for (unsigned Table = 0; Table != TK_NumberOfTables; ++Table) {
+    TableOffsets.push_back(Offset);
+    uint64_t Records = getRecordCount(Data, TableKind(Table));
+    Offset += Records * TableFields[Table] * 4;
+  }
+  TableOffsets.push_back(Offset);
+  uint64_t StringsSize =
+      readWord(Data.data() + sizeof(IndexMagic) + 4 * TK_NumberOfTables);
+  if (Offset + StringsSize != Data.size())
+    return false;
+
+  // Check that the records only refer to existing records and strings, so
+  // the queries don't need to.
+  uint64_t NumFiles = getRecordCount(Data, TK_Files);
+  uint64_t NumSymbols = getRecordCount(Data, TK_Symbols);
+  uint64_t NumDependencies = getRecordCount(Data, TK_Dependencies);
+  uint64_t NumOccurrences = getRecordCount(Data, TK_Occurrences);
+  uint64_t NumSymbolOccurrences = getRecordCount(Data, TK_SymbolOccurrences);
+  auto IsString = [&](uint64_t Offset, uint64_t Length) {
+    return Offset + Length <= StringsSize;
+  };
+  for (unsigned I = 0; I != NumFiles; ++I)
+    if (!IsString(getField(TK_Files, I, 0), getField(TK_Files, I, 1)))
+      return false;
+  for (unsigned I = 0; I != NumSymbols; ++I) {
+    uint32_t Parent = getField(TK_Symbols, I, 5);
+    if (!IsString(getField(TK_Symbols, I, 0), getField(TK_Symbols, I, 1)) ||
+        !IsString(getField(TK_Symbols, I, 2), getField(TK_Symbols, I, 3)) ||
+        getField(TK_Symbols, I, 4) > SK_Destructor ||
+        (Parent != NoSymbol && Parent >= NumSymbols) ||
+        uint64_t(getField(TK_Symbols, I, 6)) + getField(TK_Symbols, I, 7) >
+            NumSymbolOccurrences)
+      return false;
+  }
+  for (unsigned I = 0, E = getRecordCount(Data, TK_TranslationUnits); I != E;
+       ++I)
+    if (getField(TK_TranslationUnits, I, 0) >= NumFiles ||
+        uint64_t(getField(TK_TranslationUnits, I, 1)) +
+                getField(TK_TranslationUnits, I, 2) >
+            NumDependencies ||
+        uint64_t(getField(TK_TranslationUnits, I, 3)) +
+                getField(TK_TranslationUnits, I, 4) >
+            NumOccurrences)
+      return false;
+  for (unsigned I = 0; I != NumDependencies; ++I)
+    if (getField(TK_Dependencies, I, 0) >= NumFiles)
+      return false;
+  for (unsigned I = 0; I != NumOccurrences; ++I) {
+    if (getField(TK_Occurrences, I, 0) >= NumSymbols ||
+        getField(TK_Occurrences, I, 1) >= NumFiles ||
+        getField(TK_Occurrences, I, 4) > OR_Reference)
+      return false;
+    MaxOccurrenceLength =
+        std::max(MaxOccurrenceLength, getField(TK_Occurrences, I, 3));
+  }
+  for (unsigned I = 0; I != NumSymbolOccurrences; ++I)
+    if (getField(TK_SymbolOccurrences, I, 0) >= NumOccurrences)
+      return false;
+  if (getRecordCount(Data, TK_FileOccurrences) != NumOccurrences ||
+      getRecordCount(Data, TK_FileDependencies) != NumDependencies)
+    return false;
+  for (unsigned I = 0; I != NumOccurrences; ++I)
+    if (getField(TK_FileOccurrences, I, 0) >= NumOccurrences)
+      return false;
+  for (unsigned I = 0; I != NumDependencies; ++I)
+    if (getField(TK_FileDependencies, I, 0) >= NumDependencies)
+      return false;
+
+  ErrorMessage.clear();
+  return true;
+}
+
+uint32_t SymbolIndex::getField(unsigned Table, unsigned Record,
+                               unsigned Field) const {
+  return readWord(Buffer->getBufferStart() + TableOffsets[Table] +
+                  4 * (Record * TableFields[Table] + Field));
+}
+
+StringRef SymbolIndex::getString(uint32_t Offset, uint32_t Length) const {
+  StringRef Strings =
+      Buffer->getBuffer().substr(TableOffsets[TK_NumberOfTables]);
+  return Strings.substr(Offset, Length);
+}
+
+StringRef SymbolIndex::getFilePath(unsigned File) const {
+  return getString(getField(TK_Files, File, 0), getField(TK_Files, File, 1));
+}
+
+StringRef SymbolIndex::getSymbolUSR(unsigned Symbol) const {
+  return getString(getField(TK_Symbols, Symbol, 0),
+                   getField(TK_Symbols, Symbol, 1));
+}
+
+StringRef SymbolIndex::getSymbolName(unsigned Symbol) const {
+  return getString(getField(TK_Symbols, Symbol, 2),
+                   getField(TK_Symbols, Symbol, 3));
+}
+
+// Returns the first of Count sorted records for which IsBefore returns false.
+template <typename PredicateT>
+static unsigned findFirst(unsigned Count, PredicateT IsBefore) {
+  unsigned Low = 0;
+  unsigned High = Count;
+  while (Low < High) {
+    unsigned Middle = Low + (High - Low) / 2;
+    if (IsBefore(Middle))
+      Low = Middle + 1;
+    else
+      High = Middle;
+  }
+  return Low;
+}
+
+bool SymbolIndex::findSymbol(StringRef USR, unsigned &Symbol) const {
+  // The symbols are sorted by USR.
+  unsigned NumSymbols = getRecordCount(Buffer->getBuffer(), TK_Symbols);
+  Symbol = findFirst(NumSymbols,
+                     [&](unsigned I) { return getSymbolUSR(I) < USR; });
+  return Symbol != NumSymbols && getSymbolUSR(Symbol) == USR;
+}
+
+bool SymbolIndex::findFile(StringRef Path, unsigned &File) const {
+  // The files are sorted by path.
+  unsigned NumFiles = getRecordCount(Buffer->getBuffer(), TK_Files);
+  File = findFirst(NumFiles,
+                   [&](unsigned I) { return getFilePath(I) < Path; });
+  return File != NumFiles && getFilePath(File) == Path;
+}
+
+bool SymbolIndex::findUSRAt(StringRef File, unsigned Offset,
+                            std::string &USR) const {
+  unsigned FileIndex;
+  if (!findFile(File, FileIndex))
+    return false;
+
+  // Find the first occurrence starting after the offset, then look back at
+  // those of the file starting close enough to contain the offset.
+  auto GetOccurrence = [&](unsigned I) {
+    return getField(TK_FileOccurrences, I, 0);
+  };
+  unsigned End = findFirst(
+      getRecordCount(Buffer->getBuffer(), TK_FileOccurrences),
+      [&](unsigned I) {
+        uint32_t OccurrenceFile = getField(TK_Occurrences, GetOccurrence(I), 1);
+        return OccurrenceFile < FileIndex ||
+               (OccurrenceFile == FileIndex &&
+                getField(TK_Occurrences, GetOccurrence(I), 2) <= Offset);
+      });
+  for (unsigned I = End; I != 0; --I) {
+    uint32_t Occurrence = GetOccurrence(I - 1);
+    uint32_t Start = getField(TK_Occurrences, Occurrence, 2);
+    if (getField(TK_Occurrences, Occurrence, 1) != FileIndex ||
+        Offset - Start >= MaxOccurrenceLength)
+      break;
+    if (Offset - Start < getField(TK_Occurrences, Occurrence, 3)) {
+      USR = getSymbolUSR(getField(TK_Occurrences, Occurrence, 0));
+      return true;
+    }
+  }
+  return false;
+}
+
+std::vector<std::string> SymbolIndex::getRenamingUSRs(StringRef USR,
+                                                      std::string &Name) const {
+  std::vector<std::string> USRs;
+  unsigned Symbol;
+  if (!findSymbol(USR, Symbol))
+    return USRs;
+
+  // A constructor or destructor is renamed as its class.
+  uint32_t Kind = getField(TK_Symbols, Symbol, 4);
+  uint32_t Parent = getField(TK_Symbols, Symbol, 5);
+  if ((Kind == SK_Constructor || Kind == SK_Destructor) && Parent != NoSymbol)
+    Symbol = Parent;
+
+  // A class is renamed with its constructors.
+  for (unsigned I = 0, E = getRecordCount(Buffer->getBuffer(), TK_Symbols);
+       I != E; ++I)
+    if (getField(TK_Symbols, I, 4) == SK_Constructor &&
+        getField(TK_Symbols, I, 5) == Symbol)
+      USRs.push_back(getSymbolUSR(I));
+
+  USRs.push_back(getSymbolUSR(Symbol));
+  Name = getSymbolName(Symbol);
+  return USRs;
+}
+
+std::vector<SymbolOccurrence>
+SymbolIndex::getOccurrences(const std::vector<std::string> &USRs) const {
+  std::vector<SymbolOccurrence> Occurrences;
+  for (const auto &USR : USRs) {
+    unsigned Symbol;
+    if (!findSymbol(USR, Symbol))
+      continue;
+    uint32_t First = getField(TK_Symbols, Symbol, 6);
+    uint32_t Count = getField(TK_Symbols, Symbol, 7);
+    for (uint32_t I = First; I != First + Count; ++I) {
+      uint32_t Occurrence = getField(TK_SymbolOccurrences, I, 0);
+      SymbolOccurrence Found;
+      Found.File = getFilePath(getField(TK_Occurrences, Occurrence, 1));
+      Found.Offset = getField(TK_Occurrences, Occurrence, 2);
+      Found.Length = getField(TK_Occurrences, Occurrence, 3);
+      Found.Role = OccurrenceRole(getField(TK_Occurrences, Occurrence, 4));
+      Occurrences.push_back(Found);
+    }
+  }
+  // Headers are indexed once for each translation unit including them.
+  std::sort(Occurrences.begin(), Occurrences.end());
+  Occurrences.erase(std::unique(Occurrences.begin(), Occurrences.end()),
+                    Occurrences.end());
+  return Occurrences;
+}
+
+bool SymbolIndex::isFileUpToDate(StringRef File) const {
+  unsigned FileIndex;
+  if (!findFile(File, FileIndex))
+    return false;
+
+  // The dependencies on the file are contiguous in FileDependencies.
+  auto GetDependencyFile = [&](unsigned D) {
+    return getField(TK_Dependencies, getField(TK_FileDependencies, D, 0), 0);
+  };
+  unsigned NumDependencies =
+      getRecordCount(Buffer->getBuffer(), TK_FileDependencies);
+  bool Found = false;
+  for (unsigned D = findFirst(NumDependencies,
+                              [&](unsigned D) {
+                                return GetDependencyFile(D) < FileIndex;
+                              });
+       D != NumDependencies && GetDependencyFile(D) == FileIndex; ++D) {
+    uint32_t I = getField(TK_FileDependencies, D, 0);
+    uint64_t ModificationTime =
+        getField(TK_Dependencies, I, 1) |
+        (uint64_t(getField(TK_Dependencies, I, 2)) << 32);
+    uint64_t Size = getField(TK_Dependencies, I, 3) |
+                    (uint64_t(getField(TK_Dependencies, I, 4)) << 32);
+    if (!isFileUnchanged(File, ModificationTime, Size))
+      return false;
+    Found = true;
+  }
+  return Found;
+}
+
+std::vector<IndexedTranslationUnit> SymbolIndex::getTranslationUnits() const {
+  StringRef Data = Buffer->getBuffer();
+  std::vector<IndexedTranslationUnit> TUs;
+  for (unsigned T = 0, TE = getRecordCount(Data, TK_TranslationUnits);
+       T != TE; ++T) {
+    IndexedTranslationUnit TU;
+    TU.MainFile = getFilePath(getField(TK_TranslationUnits, T, 0));
+
+    // Map the global file and symbol indexes to the translation unit's.
+    llvm::DenseMap<uint32_t, unsigned> Files, Symbols;
+    uint32_t FirstDependency = getField(TK_TranslationUnits, T, 1);
+    uint32_t NumDependencies = getField(TK_TranslationUnits, T, 2);
+    for (uint32_t I = FirstDependency; I != FirstDependency + NumDependencies;
+         ++I) {
+      IndexedFile File;
+      uint32_t FileIndex = getField(TK_Dependencies, I, 0);
+      File.Path = getFilePath(FileIndex);
+      File.ModificationTime = getField(TK_Dependencies, I, 1) |
+                              (uint64_t(getField(TK_Dependencies, I, 2)) << 32);
+      File.Size = getField(TK_Dependencies, I, 3) |
+                  (uint64_t(getField(TK_Dependencies, I, 4)) << 32);
+      Files[FileIndex] = TU.Files.size();
+      TU.Files.push_back(File);
+    }
+
+    uint32_t FirstOccurrence = getField(TK_TranslationUnits, T, 3);
+    uint32_t NumOccurrences = getField(TK_TranslationUnits, T, 4);
+    for (uint32_t I = FirstOccurrence; I != FirstOccurrence + NumOccurrences;
+         ++I) {
+      uint32_t GlobalSymbol = getField(TK_Occurrences, I, 0);
+      auto Inserted =
+          Symbols.insert(std::make_pair(GlobalSymbol, TU.Symbols.size()));
+      if (Inserted.second) {
+        IndexedSymbol Symbol;
+        Symbol.USR = getSymbolUSR(GlobalSymbol);
+        Symbol.Name = getSymbolName(GlobalSymbol);
+        Symbol.Kind = SymbolKind(getField(TK_Symbols, GlobalSymbol, 4));
+        uint32_t Parent = getField(TK_Symbols, GlobalSymbol, 5);
+        if (Parent != NoSymbol)
+          Symbol.ParentUSR = getSymbolUSR(Parent);
+        TU.Symbols.push_back(Symbol);
+      }
+      IndexedOccurrence Occurrence;
+      Occurrence.Symbol = Inserted.first->second;
+      Occurrence.File = Files[getField(TK_Occurrences, I, 1)];
+      Occurrence.Offset = getField(TK_Occurrences, I, 2);
+      Occurrence.Length = getField(TK_Occurrences, I, 3);
+      Occurrence.Role = OccurrenceRole(getField(TK_Occurrences, I, 4));
+      TU.Occurrences.push_back(Occurrence);
+    }
+    TUs.push_back(std::move(TU));
+  }
+  return TUs;
+}
+
+// Updating:
+
+int updateSymbolIndex(StringRef Path,
+                      const tooling::CompilationDatabase &Compilations,
+                      const std::vector<std::string> &Files, unsigned Jobs) {
+  // Keep the translation units that are up to date.
+  std::vector<IndexedTranslationUnit> TUs(Files.size());
+  std::vector<std::string> Stale;
+  std::vector<unsigned> StaleIndexes;
+  {
+    llvm::StringMap<IndexedTranslationUnit> Indexed;
+    if (sys::fs::exists(Path)) {
+      std::string ErrorMessage;
+      auto Index = SymbolIndex::load(Path, ErrorMessage);
+      if (!Index) {
+        errs() << "clang-rename: ignoring index " << Path << ": "
+               << ErrorMessage << "\n";
+      } else {
+        for (auto &TU : Index->getTranslationUnits())
+          Indexed[TU.MainFile] = std::move(TU);
+      }
+    }
+    for (unsigned I = 0, E = Files.size(); I != E; ++I) {
+      auto Commands = Compilations.getCompileCommands(Files[I]);
+      std::string MainFile = getNormalizedPath(
+          Commands.empty() ? "" : Commands.front().Directory, Files[I]);
+      auto Found = Indexed.find(MainFile);
+      if (Found != Indexed.end() && Found->second.isUpToDate()) {
+        TUs[I] = std::move(Found->second);
+      } else {
+        Stale.push_back(Files[I]);
+        StaleIndexes.push_back(I);
+      }
+    }
+  }
+
+  // Index the others. A translation unit with compile errors is still
+  // visited, so drop what was recorded of it.
+  bool Success = forEachFileInParallel(
+      Compilations, Stale, Jobs, [&](unsigned Index, StringRef Directory) {
+        IndexedTranslationUnit &TU = TUs[StaleIndexes[Index]];
+        IndexingAction Action(Directory, TU);
+        tooling::ClangTool Tool(Compilations, Stale[Index]);
+        if (Tool.run(tooling::newFrontendActionFactory(&Action).get()) != 0) {
+          TU = IndexedTranslationUnit();
+          return false;
+        }
+        return true;
+      });
+  errs() << "clang-rename: indexed " << Stale.size() << " of " << Files.size()
+         << " files.\n";
+
+  // Leave out the files that failed to parse, so they are indexed again by
+  // the next update.
+  TUs.erase(std::remove_if(TUs.begin(), TUs.end(),
+                           [](const IndexedTranslationUnit &TU) {
+                             return TU.MainFile.empty();
+                           }),
+            TUs.end());
+
+  std::string ErrorMessage;
+  if (!writeSymbolIndex(Path, TUs, ErrorMessage)) {
+    errs() << "clang-rename: error writing index " << Path << ": "
+           << ErrorMessage << "\n";
+    return 1;
+  }
+  return Success ? 0 : 1;
+}
+
+} // namespace rename
+} // namespace clang
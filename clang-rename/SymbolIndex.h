@@ -0,0 +1,197 @@
+//===--- tools/extra/clang-rename/SymbolIndex.h - Clang rename tool -------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// \brief Provides a persistent index of the occurrences of every symbol in a
+/// compilation database, so symbols can be renamed without parsing.
+///
+/// The index records, for every translation unit, the files it depends on
+/// with their modification time and size, and the occurrences of each USR:
+/// file, offset, length and role. A translation unit is indexed again only
+/// when one of the files it depends on changes.
+///
+/// The on-disk format is designed to be used in place from a memory-mapped
+/// file: a header followed by tables of fixed-size little-endian 32-bit
+/// records, which refer to a table of strings by offset and length.
+///
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_CLANG_TOOLS_EXTRA_CLANG_RENAME_SYMBOL_INDEX_H
+#define LLVM_CLANG_TOOLS_EXTRA_CLANG_RENAME_SYMBOL_INDEX_H
+
+#include "clang/Basic/LLVM.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace clang {
+class ASTConsumer;
+
+namespace tooling {
+class CompilationDatabase;
+}
+
+namespace rename {
+
+// The role of a symbol occurrence.
+enum OccurrenceRole { OR_Declaration, OR_Reference };
+
+// The kinds of symbols the renaming treats specially.
+enum SymbolKind { SK_Other, SK_Constructor, SK_Destructor };
+
+// A file a translation unit depends on, and its state when it was indexed.
+struct IndexedFile {
+  std::string Path;
+  uint64_t ModificationTime;
+  uint64_t Size;
+};
+
+// A symbol of a translation unit.
+struct IndexedSymbol {
+  std::string USR;
+  std::string Name;
+  SymbolKind Kind;
+  // The USR of the class of a constructor or destructor, or empty.
+  std::string ParentUSR;
+};
+
+// An occurrence of a symbol in a translation unit. Symbol and File are
+// indexes in the symbols and files of the translation unit.
+struct IndexedOccurrence {
+  unsigned Symbol;
+  unsigned File;
+  unsigned Offset;
+  unsigned Length;
+  OccurrenceRole Role;
+};
+
+// The index of a translation unit.
+struct IndexedTranslationUnit {
+  std::string MainFile;
+  std::vector<IndexedFile> Files;
+  std::vector<IndexedSymbol> Symbols;
+  std::vector<IndexedOccurrence> Occurrences;
+
+  // Returns true if none of the files changed since they were indexed.
+  bool isUpToDate() const;
+};
+
+// An occurrence of a symbol found in the index.
+struct SymbolOccurrence {
+  std::string File;
+  unsigned Offset;
+  unsigned Length;
+  OccurrenceRole Role;
+
+  bool operator<(const SymbolOccurrence &Other) const;
+  bool operator==(const SymbolOccurrence &Other) const;
+};
+
+// Provides an action to index a translation unit. The paths of the files are
+// made absolute relative to Directory. Occurrences in system headers aren't
+// recorded: they can't be renamed, and every translation unit would repeat
+// them.
+class IndexingAction {
+public:
+  IndexingAction(StringRef Directory, IndexedTranslationUnit &TU)
+      : Directory(Directory), TU(TU) {
+  }
+
+  std::unique_ptr<ASTConsumer> newASTConsumer();
+
+private:
+  std::string Directory;
+  IndexedTranslationUnit &TU;
+};
+
+// A symbol index loaded from disk. The index is used in place: loading only
+// checks that its records are consistent, so that a corrupt index is
+// rejected rather than read out of bounds. Symbols, files, and the
+// occurrences and dependencies of a file are found by binary search.
+class SymbolIndex {
+public:
+  // Loads the index from a file. Returns null and sets ErrorMessage if the
+  // file can't be read or isn't an index.
+  static std::unique_ptr<SymbolIndex> load(StringRef Path,
+                                           std::string &ErrorMessage);
+
+  // Finds the USR of the symbol occurring at the offset in the file. Returns
+  // false if there is no symbol there.
+  bool findUSRAt(StringRef File, unsigned Offset, std::string &USR) const;
+
+  // Gets the USRs to rename with the symbol, as USRFindingAction does: a
+  // constructor or destructor is renamed as its class, and a class is
+  // renamed with its constructors. Also gets the name of the symbol.
+  std::vector<std::string> getRenamingUSRs(StringRef USR,
+                                           std::string &Name) const;
+
+  // Gets the unique occurrences of the USRs, sorted by file and offset.
+  std::vector<SymbolOccurrence>
+  getOccurrences(const std::vector<std::string> &USRs) const;
+
+  // Returns true if the file hasn't changed since it was indexed.
+  bool isFileUpToDate(StringRef File) const;
+
+  // Reads back the indexed translation units, for updating the index.
+  std::vector<IndexedTranslationUnit> getTranslationUnits() const;
+
+private:
+  SymbolIndex(std::unique_ptr<llvm::MemoryBuffer> Buffer);
+
+  // Checks the header and table sizes, and that every record only refers to
+  // existing records and strings.
+  bool validate(std::string &ErrorMessage);
+
+  // Gets a field of a record of a table.
+  uint32_t getField(unsigned Table, unsigned Record, unsigned Field) const;
+
+  // Gets a string from the string table.
+  StringRef getString(uint32_t Offset, uint32_t Length) const;
+
+  // Gets the strings of the records of the tables.
+  StringRef getFilePath(unsigned File) const;
+  StringRef getSymbolUSR(unsigned Symbol) const;
+  StringRef getSymbolName(unsigned Symbol) const;
+
+  // Finds a symbol by USR. Returns false if it isn't in the index.
+  bool findSymbol(StringRef USR, unsigned &Symbol) const;
+
+  // Finds a file by path. Returns false if it isn't in the index.
+  bool findFile(StringRef Path, unsigned &File) const;
+
+  std::unique_ptr<llvm::MemoryBuffer> Buffer;
+  // The offset of each table in the buffer.
+  std::vector<uint32_t> TableOffsets;
+  // The length of the longest occurrence, which bounds how far before an
+  // offset findUSRAt() looks for an occurrence containing it.
+  uint32_t MaxOccurrenceLength;
+};
+
+// Writes the index of the translation units to a file. The index is written
+// to a temporary file, which then replaces the file, so an index being used
+// is never seen partially written. Returns false and sets ErrorMessage on
+// failure.
+bool writeSymbolIndex(StringRef Path,
+                      const std::vector<IndexedTranslationUnit> &TUs,
+                      std::string &ErrorMessage);
+
+// Updates the index at Path for the files of the compilation database:
+// loads the index if it exists, indexes the files that aren't up to date on
+// up to Jobs worker threads, drops the files no longer in the database, and
+// writes the index back. Returns non-zero on failure.
+int updateSymbolIndex(StringRef Path,
+                      const tooling::CompilationDatabase &Compilations,
+                      const std::vector<std::string> &Files, unsigned Jobs);
+
+}
+}
+
+#endif // LLVM_CLANG_TOOLS_EXTRA_CLANG_RENAME_SYMBOL_INDEX_H
@@ -63,39 +63,46 @@ static std::vector<std::string> getAllConstructorUSRs(
   return USRs;
 }
 
+bool findUSRsAtOffset(ASTContext &Context, unsigned SymbolOffset,
+                      std::vector<std::string> &USRs,
+                      std::string &SpellingName) {
+  const auto &SourceMgr = Context.getSourceManager();
+  // The file we look for the USR in will always be the main source file.
+  const auto Point = SourceMgr.getLocForStartOfFile(
+      SourceMgr.getMainFileID()).getLocWithOffset(SymbolOffset);
+  if (!Point.isValid())
+    return false;
+  const NamedDecl *FoundDecl = getNamedDeclAt(Context, Point);
+  if (FoundDecl == nullptr) {
+    FullSourceLoc FullLoc(Point, SourceMgr);
+    errs() << "clang-rename: could not find symbol at "
+           << SourceMgr.getFilename(Point) << ":"
+           << FullLoc.getSpellingLineNumber() << ":"
+           << FullLoc.getSpellingColumnNumber() << " (offset " << SymbolOffset
+           << ").\n";
+    return false;
+  }
+
+  // If the decl is a constructor or destructor, we want to instead take the
+  // decl of the parent record.
+  if (const auto *CtorDecl = dyn_cast<CXXConstructorDecl>(FoundDecl))
+    FoundDecl = CtorDecl->getParent();
+  else if (const auto *DtorDecl = dyn_cast<CXXDestructorDecl>(FoundDecl))
+    FoundDecl = DtorDecl->getParent();
+
+  // If the decl is in any way relatedpp to a class, we want to make sure we
+  // search for the constructor and destructor as well as everything else.
+  if (const auto *Record = dyn_cast<CXXRecordDecl>(FoundDecl))
+    USRs = getAllConstructorUSRs(Record);
+
+  USRs.push_back(getUSRForDecl(FoundDecl));
+  SpellingName = FoundDecl->getNameAsString();
+  return true;
+}
+
 struct NamedDeclFindingConsumer : public ASTConsumer {
   void HandleTranslationUnit(ASTContext &Context) override {
-    const auto &SourceMgr = Context.getSourceManager();
-    // The file we look for the USR in will always be the main source file.
-    const auto Point = SourceMgr.getLocForStartOfFile(
-        SourceMgr.getMainFileID()).getLocWithOffset(SymbolOffset);
-    if (!Point.isValid())
-      return;
-    const NamedDecl *FoundDecl = getNamedDeclAt(Context, Point);
-    if (FoundDecl == nullptr) {
-      FullSourceLoc FullLoc(Point, SourceMgr);
-      errs() << "clang-rename: could not find symbol at "
-             << SourceMgr.getFilename(Point) << ":"
-             << FullLoc.getSpellingLineNumber() << ":"
-             << FullLoc.getSpellingColumnNumber() << " (offset " << SymbolOffset
-             << ").\n";
-      return;
-    }
-
-    // If the decl is a constructor or destructor, we want to instead take the
-    // decl of the parent record.
-    if (const auto *CtorDecl = dyn_cast<CXXConstructorDecl>(FoundDecl))
-      FoundDecl = CtorDecl->getParent();
-    else if (const auto *DtorDecl = dyn_cast<CXXDestructorDecl>(FoundDecl))
-      FoundDecl = DtorDecl->getParent();
-
-    // If the decl is in any way relatedpp to a class, we want to make sure we
-    // search for the constructor and destructor as well as everything else.
-    if (const auto *Record = dyn_cast<CXXRecordDecl>(FoundDecl))
-      *USRs = getAllConstructorUSRs(Record);
-
-    USRs->push_back(getUSRForDecl(FoundDecl));
-    *SpellingName = FoundDecl->getNameAsString();
+    findUSRsAtOffset(Context, SymbolOffset, *USRs, *SpellingName);
   }
 
   unsigned SymbolOffset;
@@ -19,11 +19,19 @@
 
 namespace clang {
 class ASTConsumer;
+class ASTContext;
 class CompilerInstance;
 class NamedDecl;
 
 namespace rename {
 
+// \brief Finds the USRs to rename for the symbol at the offset in the main
+// file of the translation unit, and the spelling of the symbol. Returns false
+// if there is no symbol at the offset.
+bool findUSRsAtOffset(ASTContext &Context, unsigned SymbolOffset,
+                      std::vector<std::string> &USRs,
+                      std::string &SpellingName);
+
 struct USRFindingAction {
   USRFindingAction(unsigned Offset) : SymbolOffset(Offset) {
   }
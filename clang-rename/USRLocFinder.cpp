@@ -9,8 +9,8 @@
 ///
 /// \file
 /// \brief Mehtods for finding all instances of a USR. Our strategy is very
-/// simple; we just compare the USR at every relevant AST node with the one
-/// provided.
+/// simple; we just compare the USR at every relevant AST node with the ones
+/// provided, generating the USR of each decl only once.
 ///
 //===----------------------------------------------------------------------===//
 
@@ -20,7 +20,10 @@
 #include "clang/AST/RecursiveASTVisitor.h"
 #include "clang/Basic/SourceLocation.h"
 #include "clang/Index/USRGeneration.h"
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringMap.h"
+#include <algorithm>
 
 using namespace llvm;
 
@@ -28,20 +31,24 @@ namespace clang {
 namespace rename {
 
 namespace {
-// \brief This visitor recursively searches for all instances of a USR in a
-// translation unit and stores them for later usage.
+// \brief This visitor recursively searches for all instances of a set of USRs
+// in a translation unit and stores them for later usage.
+//
+// The USR of every decl met is only generated once; whether it is one of the
+// USRs searched for is cached per decl, as the same decls are referenced over
+// and over again.
 class USRLocFindingASTVisitor
     : public clang::RecursiveASTVisitor<USRLocFindingASTVisitor> {
 public:
-  explicit USRLocFindingASTVisitor(const std::string USR) : USR(USR) {
+  explicit USRLocFindingASTVisitor(const std::vector<std::string> &USRs) {
+    for (unsigned I = 0, E = USRs.size(); I != E; ++I)
+      USRIndexes.insert(std::make_pair(USRs[I], I));
   }
 
   // Declaration visitors:
 
   bool VisitNamedDecl(const NamedDecl *Decl) {
-    if (getUSRForDecl(Decl) == USR) {
-      LocationsFound.push_back(Decl->getLocation());
-    }
+    addLocation(Decl, Decl->getLocation());
     return true;
   }
 
@@ -51,27 +58,35 @@ public:
     const auto *Decl = Expr->getFoundDecl();
 
     checkNestedNameSpecifierLoc(Expr->getQualifierLoc());
-    if (getUSRForDecl(Decl) == USR) {
-      LocationsFound.push_back(Expr->getLocation());
-    }
+    addLocation(Decl, Expr->getLocation());
 
     return true;
   }
 
   bool VisitMemberExpr(const MemberExpr *Expr) {
     const auto *Decl = Expr->getFoundDecl().getDecl();
-    if (getUSRForDecl(Decl) == USR) {
-      LocationsFound.push_back(Expr->getMemberLoc());
-    }
+    addLocation(Decl, Expr->getMemberLoc());
     return true;
   }
 
   // Non-visitors:
 
-  // \brief Returns a list of unique locations. Duplicate or overlapping
-  // locations are erroneous and should be reported!
-  const std::vector<clang::SourceLocation> &getLocationsFound() const {
-    return LocationsFound;
+  // \brief Returns a list of unique locations, grouped by USR. Duplicate or
+  // overlapping locations are erroneous and should be reported!
+  std::vector<clang::SourceLocation> getLocationsFound() {
+    // The locations are found in traversal order, so a stable sort groups
+    // them by USR in the order they were found for each USR.
+    std::stable_sort(
+        LocationsFound.begin(), LocationsFound.end(),
+        [](const std::pair<unsigned, SourceLocation> &LHS,
+           const std::pair<unsigned, SourceLocation> &RHS) {
+      return LHS.first < RHS.first;
+    });
+    std::vector<clang::SourceLocation> Locations;
+    Locations.reserve(LocationsFound.size());
+    for (const auto &Found : LocationsFound)
+      Locations.push_back(Found.second);
+    return Locations;
   }
 
 private:
@@ -79,21 +94,48 @@ private:
   void checkNestedNameSpecifierLoc(NestedNameSpecifierLoc NameLoc) {
     while (NameLoc) {
       const auto *Decl = NameLoc.getNestedNameSpecifier()->getAsNamespace();
-      if (Decl && getUSRForDecl(Decl) == USR)
-        LocationsFound.push_back(NameLoc.getLocalBeginLoc());
+      if (Decl)
+        addLocation(Decl, NameLoc.getLocalBeginLoc());
       NameLoc = NameLoc.getPrefix();
     }
   }
 
-  // All the locations of the USR were found.
-  const std::string USR;
-  std::vector<clang::SourceLocation> LocationsFound;
+  // \brief Records the location if the decl has one of the USRs.
+  void addLocation(const Decl *Decl, SourceLocation Loc) {
+    int Index = getUSRIndex(Decl);
+    if (Index >= 0)
+      LocationsFound.push_back(std::make_pair(unsigned(Index), Loc));
+  }
+
+  // \brief Returns the index of the decl's USR, or -1 if it isn't one of the
+  // USRs searched for.
+  int getUSRIndex(const Decl *Decl) {
+    auto Cached = DeclUSRIndexes.find(Decl);
+    if (Cached != DeclUSRIndexes.end())
+      return Cached->second;
+    auto Found = USRIndexes.find(getUSRForDecl(Decl));
+    int Index = Found == USRIndexes.end() ? -1 : int(Found->second);
+    DeclUSRIndexes[Decl] = Index;
+    return Index;
+  }
+
+  // The USRs to search for, mapped to their index.
+  llvm::StringMap<unsigned> USRIndexes;
+  // The USR index of each decl met so far, or -1.
+  llvm::DenseMap<const Decl *, int> DeclUSRIndexes;
+  // All the locations of the USRs were found, with their USR index.
+  std::vector<std::pair<unsigned, clang::SourceLocation>> LocationsFound;
 };
 } // namespace
 
 std::vector<SourceLocation> getLocationsOfUSR(const std::string USR,
                                               Decl *Decl) {
-  USRLocFindingASTVisitor visitor(USR);
+  return getLocationsOfUSRs(std::vector<std::string>(1, USR), Decl);
+}
+
+std::vector<SourceLocation>
+getLocationsOfUSRs(const std::vector<std::string> &USRs, Decl *Decl) {
+  USRLocFindingASTVisitor visitor(USRs);
 
   visitor.TraverseDecl(Decl);
   return visitor.getLocationsFound();
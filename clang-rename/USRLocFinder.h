@@ -29,6 +29,12 @@ namespace rename {
 // FIXME: make this an AST matcher. Wouldn't that be awesome??? I agree!
 std::vector<SourceLocation> getLocationsOfUSR(const std::string usr,
                                               Decl *decl);
+
+// Finds the locations of all the USRs in a single traversal of the decl. The
+// locations are grouped by USR, in the order of the USRs, as if
+// getLocationsOfUSR had been called for each USR in turn.
+std::vector<SourceLocation>
+getLocationsOfUSRs(const std::vector<std::string> &USRs, Decl *decl);
 }
 }
 
@@ -13,8 +13,9 @@
 ///
 //===----------------------------------------------------------------------===//
 
-#include "../USRFindingAction.h"
-#include "../RenamingAction.h"
+#include "../ASTRenamer.h"
+#include "../ProjectRename.h"
+#include "../SymbolIndex.h"
 #include "clang/AST/ASTConsumer.h"
 #include "clang/AST/ASTContext.h"
 #include "clang/Basic/FileManager.h"
@@ -34,7 +35,9 @@
 #include "clang/Tooling/Refactoring.h"
 #include "clang/Tooling/Tooling.h"
 #include "llvm/ADT/IntrusiveRefCntPtr.h"
+#include "llvm/Support/FileSystem.h"
 #include "llvm/Support/Host.h"
+#include "llvm/Support/MemoryBuffer.h"
 #include <ctype.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -72,6 +75,53 @@ PrintLocations(
     cl::desc("Print the locations affected by renaming to stderr."),
     cl::cat(ClangRenameCategory));
 
+static cl::opt<bool>
+Project(
+    "project",
+    cl::desc("Rename in every file of the compilation database, instead of\n"
+             "only in the <source>s. The symbol is found at <offset> in\n"
+             "<source0>."),
+    cl::cat(ClangRenameCategory));
+static cl::opt<unsigned>
+Jobs(
+    "j",
+    cl::desc("Number of files to rename in parallel with -project, or to\n"
+             "index in parallel with -build-index, or 0 for the number of\n"
+             "hardware threads. More than one job requires the paths in the\n"
+             "compile commands to be absolute."),
+    cl::init(1),
+    cl::cat(ClangRenameCategory));
+static cl::opt<bool>
+Prefilter(
+    "prefilter",
+    cl::desc("With -project, only parse the files containing the symbol's\n"
+             "name. Uses of the symbol in headers are only renamed if a file\n"
+             "including them contains the name."),
+    cl::cat(ClangRenameCategory));
+static cl::opt<bool>
+Streaming(
+    "streaming",
+    cl::desc("Parse the file containing the symbol first, then the other\n"
+             "files one at a time, instead of keeping the ASTs of all the\n"
+             "files in memory."),
+    cl::cat(ClangRenameCategory));
+
+static cl::opt<std::string>
+BuildIndex(
+    "build-index",
+    cl::desc("Index every file of the compilation database into <file>,\n"
+             "only parsing the files that changed since the last update,\n"
+             "and exit."),
+    cl::value_desc("file"),
+    cl::cat(ClangRenameCategory));
+static cl::opt<std::string>
+UseIndex(
+    "use-index",
+    cl::desc("Rename using the occurrences recorded in the index <file>,\n"
+             "without parsing any file."),
+    cl::value_desc("file"),
+    cl::cat(ClangRenameCategory));
+
 #define CLANG_RENAME_VERSION "0.0.1"
 
 static void PrintVersion() {
@@ -83,12 +133,155 @@ using namespace clang;
 const char RenameUsage[] = "A tool to rename symbols in C/C++ code.\n\
 clang-rename renames every occurrence of a symbol found at <offset> in\n\
 <source0>. If -i is specified, the edited files are overwritten to disk.\n\
-Otherwise, the results are written to stdout.\n";
+Otherwise, the results are written to stdout. If -project is specified,\n\
+every file of the compilation database is renamed, in parallel. With\n\
+-build-index and -use-index, the occurrences of every symbol are indexed\n\
+once, and renaming doesn't need to parse the files.\n";
+
+// Applies the replacements and writes the changed files: to disk with -i, or
+// to stdout.
+static int writeChangedFiles(const tooling::Replacements &Replaces) {
+  // Apply the replacements. Only the changed files get an edit buffer.
+  LangOptions DefaultLangOptions;
+  IntrusiveRefCntPtr<DiagnosticOptions> DiagOpts = new DiagnosticOptions();
+  TextDiagnosticPrinter DiagnosticPrinter(errs(), &*DiagOpts);
+  DiagnosticsEngine Diagnostics(
+      IntrusiveRefCntPtr<DiagnosticIDs>(new DiagnosticIDs()), &*DiagOpts,
+      &DiagnosticPrinter, false);
+  FileManager FileMgr((FileSystemOptions()));
+  SourceManager Sources(Diagnostics, FileMgr);
+  Rewriter Rewrite(Sources, DefaultLangOptions);
+  if (!tooling::applyAllReplacements(Replaces, Rewrite)) {
+    errs() << "clang-rename: failed to apply the replacements.\n";
+    return 1;
+  }
+
+  if (Inplace)
+    return Rewrite.overwriteChangedFiles() ? 1 : 0;
+
+  // Write every changed file to stdout, in path order.
+  for (auto I = Rewrite.buffer_begin(), E = Rewrite.buffer_end(); I != E;
+       ++I) {
+    const auto *Entry = Sources.getFileEntryForID(I->first);
+    errs() << "clang-rename: changed file: " << Entry->getName() << "\n";
+    I->second.write(outs());
+  }
+  return 0;
+}
+
+// Renames in every file of the compilation database, and writes the changed
+// files.
+static int renameProject(const tooling::CompilationDatabase &Compilations,
+                         const std::string &MainFile,
+                         const std::string &PrevName,
+                         const std::vector<std::string> &USRs,
+                         const tooling::Replacements &MainFileReplaces,
+                         int res) {
+  // Make the paths of the replacements already made in the main file
+  // comparable with the others, and don't parse the main file again.
+  auto Commands = Compilations.getCompileCommands(MainFile);
+  std::string Directory = Commands.empty() ? "" : Commands.front().Directory;
+  std::string MainPath = rename::getNormalizedPath(Directory, MainFile);
+  tooling::Replacements Replaces;
+  for (const auto &Replace : MainFileReplaces)
+    Replaces.insert(tooling::Replacement(
+        rename::getNormalizedPath(Directory, Replace.getFilePath()),
+        Replace.getOffset(), Replace.getLength(),
+        Replace.getReplacementText()));
+
+  std::vector<std::string> Files;
+  for (const auto &File : Compilations.getAllFiles()) {
+    auto FileCommands = Compilations.getCompileCommands(File);
+    if (rename::getNormalizedPath(
+            FileCommands.empty() ? "" : FileCommands.front().Directory,
+            File) != MainPath)
+      Files.push_back(File);
+  }
+  if (Prefilter)
+    Files = rename::filterFilesBySpelling(Files, PrevName);
+
+  if (rename::renameInFiles(Compilations, Files, NewName, PrevName, USRs, Jobs,
+                            PrintLocations, Replaces))
+    res = 1;
+  if (int WriteRes = writeChangedFiles(Replaces))
+    return WriteRes;
+  return res;
+}
+
+// Computes the line and column of an offset in a file, for printing.
+static void printLocation(StringRef File, unsigned Offset) {
+  unsigned Line = 1, Column = 1;
+  auto Buffer = MemoryBuffer::getFile(File);
+  if (Buffer) {
+    StringRef Text = Buffer.get()->getBuffer().substr(0, Offset);
+    Line += Text.count('\n');
+    Column += Text.size() - (Text.rfind('\n') + 1);
+  }
+  errs() << "clang-rename: renamed at: " << File << ":" << Line << ":"
+         << Column << "\n";
+}
+
+// Renames with the occurrences recorded in the index, and writes the changed
+// files.
+static int renameWithIndex(const std::string &MainFile) {
+  std::string ErrorMessage;
+  auto Index = rename::SymbolIndex::load(UseIndex, ErrorMessage);
+  if (!Index) {
+    errs() << "clang-rename: could not load index " << UseIndex << ": "
+           << ErrorMessage << "\n";
+    return 1;
+  }
+
+  SmallString<256> CurrentDirectory;
+  sys::fs::current_path(CurrentDirectory);
+  std::string File = rename::getNormalizedPath(CurrentDirectory, MainFile);
+  std::string USR;
+  if (!Index->findUSRAt(File, SymbolOffset, USR)) {
+    errs() << "clang-rename: could not find symbol at " << File << ":"
+           << SymbolOffset << " in the index.\n";
+    return 1;
+  }
+  std::string PrevName;
+  auto USRs = Index->getRenamingUSRs(USR, PrevName);
+  if (PrintName)
+    errs() << "clang-rename: found name: " << PrevName;
+
+  auto Occurrences = Index->getOccurrences(USRs);
+  tooling::Replacements Replaces;
+  StringRef CheckedFile;
+  for (const auto &Occurrence : Occurrences) {
+    // Offsets in a changed file may not point to the symbol anymore. The
+    // occurrences are sorted by file, so each file is only checked once.
+    if (Occurrence.File != CheckedFile) {
+      if (!Index->isFileUpToDate(Occurrence.File)) {
+        errs() << "clang-rename: " << Occurrence.File
+               << " changed since it was indexed; update the index with "
+                  "-build-index.\n";
+        return 1;
+      }
+      CheckedFile = Occurrence.File;
+    }
+    if (PrintLocations)
+      printLocation(Occurrence.File, Occurrence.Offset);
+    Replaces.insert(tooling::Replacement(Occurrence.File, Occurrence.Offset,
+                                         PrevName.size(), NewName));
+  }
+  return writeChangedFiles(Replaces);
+}
 
 int main(int argc, const char **argv) {
   cl::SetVersionPrinter(PrintVersion);
   tooling::CommonOptionsParser OP(argc, argv, ClangRenameCategory, RenameUsage);
 
+  if (!BuildIndex.empty()) {
+    auto Files = OP.getCompilations().getAllFiles();
+    // A fixed compilation database doesn't know about any files.
+    if (Files.empty())
+      Files = OP.getSourcePathList();
+    exit(rename::updateSymbolIndex(BuildIndex, OP.getCompilations(), Files,
+                                   Jobs));
+  }
+
   // Check the arguments for correctness.
 
   if (NewName.empty()) {
@@ -97,34 +290,38 @@ int main(int argc, const char **argv) {
     exit(1);
   }
 
-  // Get the USRs.
+  if (!UseIndex.empty())
+    exit(renameWithIndex(OP.getSourcePathList().front()));
+
+  // Get the USRs. In project mode, the symbol is only looked for in the
+  // first source, and the other files are renamed in parallel.
   auto Files = OP.getSourcePathList();
+  if (Project)
+    Files.resize(1);
   tooling::RefactoringTool Tool(OP.getCompilations(), Files);
-  rename::USRFindingAction USRAction(SymbolOffset);
-
-  // Find the USRs.
-  Tool.run(tooling::newFrontendActionFactory(&USRAction).get());
-  const auto &USRs = USRAction.getUSRs();
-  const auto &PrevName = USRAction.getUSRSpelling();
+  rename::ASTRenamer Renamer(OP.getCompilations(), Files, Streaming);
 
-  if (PrevName.empty())
+  // Find the USRs. The ASTs are kept for the renaming.
+  if (!Renamer.findUSRs(SymbolOffset))
     // An error should have already been printed.
     exit(1);
+  const auto &USRs = Renamer.getUSRs();
+  const auto &PrevName = Renamer.getUSRSpelling();
 
   if (PrintName)
     errs() << "clang-rename: found name: " << PrevName;
 
   // Perform the renaming.
-  rename::RenamingAction RenameAction(NewName, PrevName, USRs,
-                                      Tool.getReplacements(), PrintLocations);
-  auto Factory = tooling::newFrontendActionFactory(&RenameAction);
-  int res;
+  int res = Renamer.rename(NewName, PrintLocations, Tool.getReplacements());
+
+  if (Project)
+    exit(renameProject(OP.getCompilations(), Files.front(), PrevName, USRs,
+                       Tool.getReplacements(), res));
 
   if (Inplace) {
-    res = Tool.runAndSave(Factory.get());
+    if (int WriteRes = writeChangedFiles(Tool.getReplacements()))
+      res = WriteRes;
   } else {
-    res = Tool.run(Factory.get());
-
     // Write every file to stdout. Right now we just barf the files without any
     // indication of which files start where, other than that we print the files
     // in the same order we see them.
@@ -27,7 +27,15 @@
 // to preprocess the file, and uses a callback to collect the header files
 // included by the umbrella header or any of its nested includes.  If any
 // front end options are needed for these compiler invocations, these are
-// to be passed in via the CommandLine parameter.
+// to be passed in via the CommandLine parameter.  The umbrella headers are
+// collected while walking the modules, and then preprocessed concurrently
+// (up to the Jobs parameter), each with its own ClangTool.  The results are
+// merged in module map order, so the output doesn't depend on scheduling.
+//
+// The umbrella directory and file system scans share a cache of directory
+// contents, so a directory reached by both is only read once.  The time
+// spent in each phase can be displayed by setting the DisplayTiming
+// parameter.
 //
 // Warning message have the form:
 //
@@ -68,7 +76,12 @@
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/FileSystem.h"
 #include "llvm/Support/Path.h"
+#include "llvm/Support/Threading.h"
+#include "llvm/Support/Timer.h"
 #include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <atomic>
+#include <thread>
 
 using namespace Modularize;
 using namespace clang;
@@ -80,9 +93,12 @@ namespace sys = llvm::sys;
 
 // Preprocessor callbacks.
 // We basically just collect include files.
+// Each umbrella header gets its own header list, so that umbrella
+// headers can be preprocessed concurrently.
 class CoverageCheckerCallbacks : public PPCallbacks {
 public:
-  CoverageCheckerCallbacks(CoverageChecker &Checker) : Checker(Checker) {}
+  CoverageCheckerCallbacks(std::vector<std::string> &IncludedHeaders)
+    : IncludedHeaders(IncludedHeaders) {}
   ~CoverageCheckerCallbacks() override {}
 
   // Include directive callback.
@@ -91,11 +107,13 @@ public:
                           CharSourceRange FilenameRange, const FileEntry *File,
                           StringRef SearchPath, StringRef RelativePath,
                           const Module *Imported) override {
-    Checker.collectUmbrellaHeaderHeader(File->getName());
+    // File is null if the header wasn't found.  The compiler reports that.
+    if (File)
+      IncludedHeaders.push_back(File->getName());
   }
 
 private:
-  CoverageChecker &Checker;
+  std::vector<std::string> &IncludedHeaders;
 };
 
 // Frontend action stuff:
@@ -103,38 +121,42 @@ private:
 // Consumer is responsible for setting up the callbacks.
 class CoverageCheckerConsumer : public ASTConsumer {
 public:
-  CoverageCheckerConsumer(CoverageChecker &Checker, Preprocessor &PP) {
+  CoverageCheckerConsumer(std::vector<std::string> &IncludedHeaders,
+                          Preprocessor &PP) {
     // PP takes ownership.
-    PP.addPPCallbacks(llvm::make_unique<CoverageCheckerCallbacks>(Checker));
+    PP.addPPCallbacks(
+      llvm::make_unique<CoverageCheckerCallbacks>(IncludedHeaders));
   }
 };
 
 class CoverageCheckerAction : public SyntaxOnlyAction {
 public:
-  CoverageCheckerAction(CoverageChecker &Checker) : Checker(Checker) {}
+  CoverageCheckerAction(std::vector<std::string> &IncludedHeaders)
+    : IncludedHeaders(IncludedHeaders) {}
 
 protected:
   std::unique_ptr<ASTConsumer> CreateASTConsumer(CompilerInstance &CI,
     StringRef InFile) override {
-    return llvm::make_unique<CoverageCheckerConsumer>(Checker,
+    return llvm::make_unique<CoverageCheckerConsumer>(IncludedHeaders,
       CI.getPreprocessor());
   }
 
 private:
-  CoverageChecker &Checker;
+  std::vector<std::string> &IncludedHeaders;
 };
 
 class CoverageCheckerFrontendActionFactory : public FrontendActionFactory {
 public:
-  CoverageCheckerFrontendActionFactory(CoverageChecker &Checker)
-    : Checker(Checker) {}
+  CoverageCheckerFrontendActionFactory(
+    std::vector<std::string> &IncludedHeaders)
+    : IncludedHeaders(IncludedHeaders) {}
 
   CoverageCheckerAction *create() override {
-    return new CoverageCheckerAction(Checker);
+    return new CoverageCheckerAction(IncludedHeaders);
   }
 
 private:
-  CoverageChecker &Checker;
+  std::vector<std::string> &IncludedHeaders;
 };
 
 // CoverageChecker class implementation.
@@ -143,19 +165,20 @@ private:
 CoverageChecker::CoverageChecker(StringRef ModuleMapPath,
     std::vector<std::string> &IncludePaths,
     ArrayRef<std::string> CommandLine,
-    clang::ModuleMap *ModuleMap)
+    clang::ModuleMap *ModuleMap, unsigned Jobs, bool DisplayTiming)
   : ModuleMapPath(ModuleMapPath), IncludePaths(IncludePaths),
     CommandLine(CommandLine),
-    ModMap(ModuleMap) {}
+    ModMap(ModuleMap), Jobs(Jobs), DisplayTiming(DisplayTiming) {}
 
 // Create instance of CoverageChecker, to simplify setting up
 // subordinate objects.
 CoverageChecker *CoverageChecker::createCoverageChecker(
   StringRef ModuleMapPath, std::vector<std::string> &IncludePaths,
-  ArrayRef<std::string> CommandLine, clang::ModuleMap *ModuleMap) {
+  ArrayRef<std::string> CommandLine, clang::ModuleMap *ModuleMap,
+  unsigned Jobs, bool DisplayTiming) {
 
   return new CoverageChecker(ModuleMapPath, IncludePaths, CommandLine,
-    ModuleMap);
+    ModuleMap, Jobs, DisplayTiming);
 }
 
 // Do checks.
@@ -170,15 +193,42 @@ CoverageChecker *CoverageChecker::createCoverageChecker(
 std::error_code CoverageChecker::doChecks() {
   std::error_code returnValue;
 
+  // Timers for the phases, only started if we are displaying them.
+  llvm::TimerGroup PhaseTimers("Module map coverage check");
+  llvm::Timer ModuleHeadersTimer("Collect module map headers", PhaseTimers);
+  llvm::Timer UmbrellaHeadersTimer("Preprocess umbrella headers", PhaseTimers);
+  llvm::Timer FileSystemTimer("Collect file system headers", PhaseTimers);
+  llvm::Timer UnaccountedTimer("Find unaccounted-for headers", PhaseTimers);
+
   // Collect the headers referenced in the modules.
-  collectModuleHeaders();
+  {
+    llvm::TimeRegion Region(DisplayTiming ? &ModuleHeadersTimer : nullptr);
+    collectModuleHeaders();
+  }
+
+  // Collect the headers included by the umbrella headers.
+  // Errors were already reported by the compiler, and any headers
+  // that were missed will be reported as unaccounted for.
+  {
+    llvm::TimeRegion Region(DisplayTiming ? &UmbrellaHeadersTimer : nullptr);
+    collectUmbrellaHeaderHeaders();
+  }
 
   // Collect the file system headers.
-  if (!collectFileSystemHeaders())
-    return std::error_code(2, std::generic_category());
+  {
+    llvm::TimeRegion Region(DisplayTiming ? &FileSystemTimer : nullptr);
+    if (!collectFileSystemHeaders())
+      return std::error_code(2, std::generic_category());
+  }
 
   // Do the checks.  These save the problematic file names.
-  findUnaccountedForHeaders();
+  {
+    llvm::TimeRegion Region(DisplayTiming ? &UnaccountedTimer : nullptr);
+    findUnaccountedForHeaders();
+  }
+
+  if (DisplayTiming)
+    PhaseTimers.print(llvm::errs());
 
   // Check for warnings.
   if (!UnaccountedForHeaders.empty())
@@ -202,17 +252,17 @@ void CoverageChecker::collectModuleHeaders() {
 
 // Collect referenced headers from one module.
 // Collects the headers referenced in the given module into
-// ModuleMapHeadersSet.
-// FIXME: Doesn't collect files from umbrella header.
+// ModuleMapHeadersSet.  Umbrella headers are queued in
+// UmbrellaHeaderNames, to be preprocessed later by
+// collectUmbrellaHeaderHeaders.
 bool CoverageChecker::collectModuleHeaders(const Module &Mod) {
 
   if (const FileEntry *UmbrellaHeader = Mod.getUmbrellaHeader().Entry) {
     // Collect umbrella header.
     ModuleMapHeadersSet.insert(ModularizeUtilities::getCanonicalPath(
       UmbrellaHeader->getName()));
-    // Preprocess umbrella header and collect the headers it references.
-    if (!collectUmbrellaHeaderHeaders(UmbrellaHeader->getName()))
-      return false;
+    // Queue umbrella header for preprocessing.
+    UmbrellaHeaderNames.push_back(UmbrellaHeader->getName());
   }
   else if (const DirectoryEntry *UmbrellaDir = Mod.getUmbrellaDir().Entry) {
     // Collect headers in umbrella directory.
@@ -242,57 +292,99 @@ bool CoverageChecker::collectUmbrellaHeaders(StringRef UmbrellaDirName) {
   if (Directory.size() == 0)
     Directory = ".";
   // Walk the directory.
-  std::error_code EC;
-  sys::fs::file_status Status;
-  for (sys::fs::directory_iterator I(Directory.str(), EC), E; I != E;
-    I.increment(EC)) {
-    if (EC)
-      return false;
-    std::string File(I->path());
-    I->status(Status);
-    sys::fs::file_type Type = Status.type();
-    // If the file is a directory, ignore the name and recurse.
-    if (Type == sys::fs::file_type::directory_file) {
-      if (!collectUmbrellaHeaders(File))
-        return false;
-      continue;
-    }
-    // If the file does not have a common header extension, ignore it.
-    if (!ModularizeUtilities::isHeader(File))
-      continue;
-    // Save header name.
-    ModuleMapHeadersSet.insert(ModularizeUtilities::getCanonicalPath(File));
-  }
+  std::vector<std::string> Headers;
+  if (!collectDirectoryHeaders(Directory, Headers))
+    return false;
+  // Save header names.
+  for (const std::string &Header : Headers)
+    ModuleMapHeadersSet.insert(ModularizeUtilities::getCanonicalPath(Header));
   return true;
 }
 
-// Collect headers rferenced from an umbrella file.
-bool
-CoverageChecker::collectUmbrellaHeaderHeaders(StringRef UmbrellaHeaderName) {
+// Collect headers referenced from the queued umbrella files.
+bool CoverageChecker::collectUmbrellaHeaderHeaders() {
+  if (UmbrellaHeaderNames.empty())
+    return true;
 
   SmallString<256> PathBuf(ModuleMapDirectory);
 
-  // If directory is empty, it's the current directory.
+  // If directory is empty, it's the current directory.  Otherwise it might
+  // be relative, so make it absolute: each tool changes the current
+  // directory to it, and a relative path would be resolved against the
+  // directory another tool already changed into.
   if (ModuleMapDirectory.length() == 0)
     sys::fs::current_path(PathBuf);
+  else
+    sys::fs::make_absolute(PathBuf);
+
+  // Create the compilation database, shared by all the tools.
+  FixedCompilationDatabase Compilations(Twine(PathBuf), CommandLine);
+
+  // Determine the number of worker threads.
+  unsigned NumHeaders = UmbrellaHeaderNames.size();
+  unsigned NumWorkers = Jobs ? Jobs : std::thread::hardware_concurrency();
+  if (!llvm::llvm_is_multithreaded() || NumWorkers == 0)
+    NumWorkers = 1;
+  NumWorkers = std::min(NumWorkers, NumHeaders);
+
+  // Each umbrella header gets its own list of included headers, so the
+  // workers don't share any mutable state, except for the current
+  // directory: ClangTool changes it to the module map directory for the
+  // compilation, and restores it when done, possibly while other workers
+  // are still preprocessing.  Relative paths in the command line are then
+  // resolved against the wrong directory, which is why a single worker is
+  // the default.
+  std::vector<std::vector<std::string>> IncludedHeaders(NumHeaders);
+  std::atomic<unsigned> NextHeader(0);
+  std::atomic<bool> HadErrors(false);
+  auto Worker = [&]() {
+    for (unsigned Index = NextHeader++; Index < NumHeaders;
+         Index = NextHeader++) {
+      if (!preprocessUmbrellaHeader(Compilations, UmbrellaHeaderNames[Index],
+                                    IncludedHeaders[Index]))
+        HadErrors = true;
+    }
+  };
+
+  if (NumWorkers == 1) {
+    Worker();
+  } else {
+    std::vector<std::thread> Workers;
+    for (unsigned I = 0; I < NumWorkers; ++I)
+      Workers.push_back(std::thread(Worker));
+    for (std::thread &T : Workers)
+      T.join();
+  }
+
+  // Merge the results in module map order.
+  for (const std::vector<std::string> &Headers : IncludedHeaders)
+    for (const std::string &Header : Headers)
+      collectUmbrellaHeaderHeader(Header);
 
-  // Create the compilation database.
-  std::unique_ptr<CompilationDatabase> Compilations;
-  Compilations.reset(new FixedCompilationDatabase(Twine(PathBuf), CommandLine));
+  UmbrellaHeaderNames.clear();
+
+  // If we had errors, report failure.
+  return !HadErrors;
+}
+
+// Preprocess one umbrella file, collecting the headers it includes.
+bool CoverageChecker::preprocessUmbrellaHeader(
+    const CompilationDatabase &Compilations, StringRef UmbrellaHeaderName,
+    std::vector<std::string> &IncludedHeaders) {
 
   std::vector<std::string> HeaderPath;
   HeaderPath.push_back(UmbrellaHeaderName);
 
   // Create the tool and run the compilation.
-  ClangTool Tool(*Compilations, HeaderPath);
-  int HadErrors = Tool.run(new CoverageCheckerFrontendActionFactory(*this));
+  ClangTool Tool(Compilations, HeaderPath);
+  CoverageCheckerFrontendActionFactory Factory(IncludedHeaders);
+  int HadErrors = Tool.run(&Factory);
 
   // If we had errors, exit early.
   return !HadErrors;
 }
 
-// Called from CoverageCheckerCallbacks to track a header included
-// from an umbrella header.
+// Track a header included from an umbrella header.
 void CoverageChecker::collectUmbrellaHeaderHeader(StringRef HeaderName) {
 
   SmallString<256> PathBuf(ModuleMapDirectory);
@@ -363,29 +455,71 @@ bool CoverageChecker::collectFileSystemHeaders(StringRef IncludePath) {
   }
 
   // Recursively walk the directory tree.
+  std::vector<std::string> Headers;
+  if (!collectDirectoryHeaders(Directory, Headers))
+    return false;
+  // Save header names.
+  for (const std::string &Header : Headers)
+    FileSystemHeaders.push_back(ModularizeUtilities::getCanonicalPath(Header));
+  int Count = Headers.size();
+  if (Count == 0) {
+    llvm::errs() << "warning: No headers found in include path: \""
+      << IncludePath << "\"\n";
+  }
+  return true;
+}
+
+// Get the cached contents of a directory, reading it if needed.
+const CoverageChecker::DirectoryContents *
+CoverageChecker::getDirectoryContents(StringRef Directory) {
+  // Key on the absolute path, so relative and absolute references
+  // to the same directory share an entry.
+  SmallString<256> Key(Directory);
+  sys::fs::make_absolute(Key);
+  llvm::StringMap<DirectoryContents>::iterator Found = DirectoryCache.find(Key);
+  if (Found != DirectoryCache.end())
+    return &Found->second;
+
+  // Read the directory.
+  DirectoryContents Contents;
   std::error_code EC;
   sys::fs::file_status Status;
-  int Count = 0;
-  for (sys::fs::recursive_directory_iterator I(Directory.str(), EC), E; I != E;
+  for (sys::fs::directory_iterator I(Directory, EC), E; I != E;
     I.increment(EC)) {
     if (EC)
-      return false;
-    std::string file(I->path());
+      return nullptr;
+    StringRef File(I->path());
     I->status(Status);
-    sys::fs::file_type type = Status.type();
-    // If the file is a directory, ignore the name (but still recurses).
-    if (type == sys::fs::file_type::directory_file)
+    // If the file is a directory, remember it for recursion.
+    if (Status.type() == sys::fs::file_type::directory_file) {
+      Contents.SubDirectories.push_back(sys::path::filename(File));
       continue;
+    }
     // If the file does not have a common header extension, ignore it.
-    if (!ModularizeUtilities::isHeader(file))
+    if (!ModularizeUtilities::isHeader(File))
       continue;
-    // Save header name.
-    FileSystemHeaders.push_back(ModularizeUtilities::getCanonicalPath(file));
-    Count++;
+    Contents.HeaderFiles.push_back(sys::path::filename(File));
   }
-  if (Count == 0) {
-    llvm::errs() << "warning: No headers found in include path: \""
-      << IncludePath << "\"\n";
+  return &(DirectoryCache[Key] = std::move(Contents));
+}
+
+// Recursively collect the header files in a directory tree,
+// using the directory contents cache.
+bool CoverageChecker::collectDirectoryHeaders(StringRef Directory,
+    std::vector<std::string> &Headers) {
+  const DirectoryContents *Contents = getDirectoryContents(Directory);
+  if (!Contents)
+    return false;
+  for (const std::string &Name : Contents->HeaderFiles) {
+    SmallString<256> File(Directory);
+    sys::path::append(File, Name);
+    Headers.push_back(File.str());
+  }
+  for (const std::string &Name : Contents->SubDirectories) {
+    SmallString<256> SubDirectory(Directory);
+    sys::path::append(SubDirectory, Name);
+    if (!collectDirectoryHeaders(SubDirectory, Headers))
+      return false;
   }
   return true;
 }
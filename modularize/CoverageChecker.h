@@ -25,11 +25,18 @@
 #include "clang/Lex/HeaderSearchOptions.h"
 #include "clang/Lex/ModuleMap.h"
 #include "clang/Lex/Preprocessor.h"
+#include "llvm/ADT/StringMap.h"
 #include "llvm/ADT/StringSet.h"
 #include "llvm/Support/Host.h"
 #include <string>
 #include <vector>
 
+namespace clang {
+namespace tooling {
+class CompilationDatabase;
+}
+}
+
 namespace Modularize {
 
 /// Module map checker class.
@@ -50,9 +57,23 @@ class CoverageChecker {
   llvm::ArrayRef<std::string> CommandLine;
   /// The module map.
   clang::ModuleMap *ModMap;
+  /// Maximum number of umbrella headers to preprocess concurrently.
+  /// Zero means use the number of hardware threads.
+  unsigned Jobs;
+  /// If true, display the time spent in each phase of the check.
+  bool DisplayTiming;
 
   // Internal data.
 
+  /// Contents of one directory, as read from the file system.
+  /// Only the entry names are stored, not full paths.
+  struct DirectoryContents {
+    /// Names of the subdirectories.
+    std::vector<std::string> SubDirectories;
+    /// Names of the non-directory files with a header extension.
+    std::vector<std::string> HeaderFiles;
+  };
+
   /// Directory containing the module map.
   /// Might be relative to the current directory, or absolute.
   std::string ModuleMapDirectory;
@@ -63,6 +84,12 @@ class CoverageChecker {
   std::vector<std::string> FileSystemHeaders;
   /// Headers found in file system, but not in module map.
   std::vector<std::string> UnaccountedForHeaders;
+  /// Umbrella headers found in the module map, waiting to be preprocessed.
+  std::vector<std::string> UmbrellaHeaderNames;
+  /// Directory contents cache, keyed by absolute directory path.
+  /// Shared by the umbrella directory and file system scans, so that
+  /// each directory is only read once.
+  llvm::StringMap<DirectoryContents> DirectoryCache;
 
 public:
   /// Constructor.
@@ -76,10 +103,15 @@ public:
   ///   file directory on down, leave this empty.)
   /// \param CommandLine Compile command line arguments.
   /// \param ModuleMap The module map to check.
+  /// \param Jobs Maximum number of umbrella headers to preprocess
+  ///   concurrently, or zero to use the number of hardware threads.
+  ///   More than one job requires the paths in \p CommandLine to be
+  ///   absolute.
+  /// \param DisplayTiming If true, display the time spent in each phase.
   CoverageChecker(llvm::StringRef ModuleMapPath,
     std::vector<std::string> &IncludePaths,
     llvm::ArrayRef<std::string> CommandLine,
-    clang::ModuleMap *ModuleMap);
+    clang::ModuleMap *ModuleMap, unsigned Jobs, bool DisplayTiming);
 
   /// Create instance of CoverageChecker.
   /// \param ModuleMapPath The module.modulemap file path.
@@ -90,11 +122,17 @@ public:
   ///   file directory on down, leave this empty.)
   /// \param CommandLine Compile command line arguments.
   /// \param ModuleMap The module map to check.
+  /// \param Jobs Maximum number of umbrella headers to preprocess
+  ///   concurrently, or zero to use the number of hardware threads.
+  ///   More than one job requires the paths in \p CommandLine to be
+  ///   absolute.
+  /// \param DisplayTiming If true, display the time spent in each phase.
   /// \returns Initialized CoverageChecker object.
   static CoverageChecker *createCoverageChecker(
     llvm::StringRef ModuleMapPath, std::vector<std::string> &IncludePaths,
     llvm::ArrayRef<std::string> CommandLine,
-    clang::ModuleMap *ModuleMap);
+    clang::ModuleMap *ModuleMap, unsigned Jobs = 1,
+    bool DisplayTiming = false);
 
   /// Do checks.
   /// Starting from the directory of the module.modulemap file,
@@ -116,7 +154,9 @@ public:
 
   /// Collect referenced headers from one module.
   /// Collects the headers referenced in the given module into
-  /// ModuleMapHeadersSet.
+  /// ModuleMapHeadersSet.  Umbrella headers are queued in
+  /// UmbrellaHeaderNames, to be preprocessed later by
+  /// collectUmbrellaHeaderHeaders.
   /// \param Mod The module reference.
   /// \return True if no errors.
   bool collectModuleHeaders(const clang::Module &Mod);
@@ -126,16 +166,41 @@ public:
   /// \return True if no errors.
   bool collectUmbrellaHeaders(llvm::StringRef UmbrellaDirName);
 
-  /// Collect headers rferenced from an umbrella file.
+  /// Collect headers referenced from the queued umbrella files.
+  /// The umbrella headers are preprocessed concurrently, each with
+  /// its own ClangTool, and the results merged in queue order.
+  /// \return True if no errors.
+  bool collectUmbrellaHeaderHeaders();
+
+  /// Preprocess one umbrella file, collecting the headers it includes.
+  /// This is called concurrently, so it must not modify any members.
+  /// \param Compilations The compilation database to use.
   /// \param UmbrellaHeaderName The umbrella file path.
+  /// \param IncludedHeaders Receives the included header paths.
   /// \return True if no errors.
-  bool collectUmbrellaHeaderHeaders(llvm::StringRef UmbrellaHeaderName);
+  bool preprocessUmbrellaHeader(
+    const clang::tooling::CompilationDatabase &Compilations,
+    llvm::StringRef UmbrellaHeaderName,
+    std::vector<std::string> &IncludedHeaders);
 
-  /// Called from CoverageCheckerCallbacks to track a header included
-  /// from an umbrella header.
+  /// Track a header included from an umbrella header.
   /// \param HeaderName The header file path.
   void collectUmbrellaHeaderHeader(llvm::StringRef HeaderName);
 
+  /// Get the cached contents of a directory, reading it if needed.
+  /// \param Directory The directory path.
+  /// \return The directory contents, or null if it could not be read.
+  const DirectoryContents *getDirectoryContents(llvm::StringRef Directory);
+
+  /// Recursively collect the header files in a directory tree,
+  /// using the directory contents cache.
+  /// \param Directory The directory path.  The collected paths
+  ///   are formed by appending to it.
+  /// \param Headers Receives the header file paths.
+  /// \return True if no errors.
+  bool collectDirectoryHeaders(llvm::StringRef Directory,
+                               std::vector<std::string> &Headers);
+
   /// Collect file system header files.
   /// This function scans the file system for header files,
   /// starting at the directory of the module.modulemap file,
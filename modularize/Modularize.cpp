@@ -73,6 +73,13 @@
 //          Don't do the coverage check.
 //    -coverage-check-only
 //          Only do the coverage check.
+//    -coverage-check-jobs=(number of jobs)
+//          Maximum number of umbrella headers to preprocess concurrently
+//          during the coverage check.  The default is 1, and 0 means use
+//          the number of hardware threads.  Paths in the compile options
+//          must be absolute when using more than one job.
+//    -coverage-check-timing
+//          Display the time spent in each phase of the coverage check.
 //    -display-file-lists
 //          Display lists of good files (no compile errors), problem files,
 //          and a combined list with problem files preceded by a '#'.
@@ -324,6 +331,17 @@ static cl::opt<bool>
 CoverageCheckOnly("coverage-check-only", cl::init(false),
 cl::desc("Only do the coverage check."));
 
+// Option for the number of concurrent umbrella header preprocessing jobs.
+static cl::opt<unsigned>
+CoverageCheckJobs("coverage-check-jobs", cl::init(1),
+cl::desc("Maximum number of umbrella headers to preprocess concurrently"
+  " during the coverage check (0 = number of hardware threads)."));
+
+// Option for displaying the coverage check phase timings.
+static cl::opt<bool>
+CoverageCheckTiming("coverage-check-timing", cl::init(false),
+cl::desc("Display the time spent in each phase of the coverage check."));
+
 // Option for displaying lists of good, bad, and mixed files.
 static cl::opt<bool>
 DisplayFileLists("display-file-lists", cl::init(false),
@@ -846,7 +864,8 @@ int main(int Argc, const char **Argv) {
   // If we're doing module maps.
   if (!NoCoverageCheck && ModUtil->HasModuleMap) {
     // Do coverage check.
-    if (ModUtil->doCoverageCheck(IncludePaths, CommandLine))
+    if (ModUtil->doCoverageCheck(IncludePaths, CommandLine, CoverageCheckJobs,
+                                 CoverageCheckTiming))
       HadErrors = 1;
   }
 
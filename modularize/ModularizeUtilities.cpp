@@ -118,14 +118,16 @@ std::error_code ModularizeUtilities::loadAllHeaderListsAndDependencies() {
 // module map path argument was specified.
 std::error_code ModularizeUtilities::doCoverageCheck(
     std::vector<std::string> &IncludePaths,
-    llvm::ArrayRef<std::string> CommandLine) {
+    llvm::ArrayRef<std::string> CommandLine, unsigned Jobs,
+    bool DisplayTiming) {
   int ModuleMapCount = ModuleMaps.size();
   int ModuleMapIndex;
   std::error_code EC;
   for (ModuleMapIndex = 0; ModuleMapIndex < ModuleMapCount; ++ModuleMapIndex) {
     std::unique_ptr<clang::ModuleMap> &ModMap = ModuleMaps[ModuleMapIndex];
     CoverageChecker *Checker = CoverageChecker::createCoverageChecker(
-      InputFilePaths[ModuleMapIndex], IncludePaths, CommandLine, ModMap.get());
+      InputFilePaths[ModuleMapIndex], IncludePaths, CommandLine, ModMap.get(),
+      Jobs, DisplayTiming);
     std::error_code LocalEC = Checker->doChecks();
     if (LocalEC.value() > 0)
       EC = LocalEC;
@@ -100,11 +100,16 @@ public:
   ///   To expect all files to be accounted for from the module.modulemap
   ///   file directory on down, leave this empty.)
   /// \param CommandLine Compile command line arguments.
+  /// \param Jobs Maximum number of umbrella headers to preprocess
+  ///   concurrently, or zero to use the number of hardware threads.
+  /// \param DisplayTiming If true, display the time spent in each phase.
   /// \returns 0 if there were no errors or warnings, 1 if there
   ///   were warnings, 2 if any other problem, such as a bad
   ///   module map path argument was specified.
   std::error_code doCoverageCheck(std::vector<std::string> &IncludePaths,
-                                  llvm::ArrayRef<std::string> CommandLine);
+                                  llvm::ArrayRef<std::string> CommandLine,
+                                  unsigned Jobs = 1,
+                                  bool DisplayTiming = false);
 
   /// Add unique problem file.
   /// Also standardizes the path.
@@ -17,42 +17,10 @@
 #include "PPCallbacksTracker.h"
 #include "clang/Lex/MacroArgs.h"
 #include "llvm/Support/raw_ostream.h"
+#include <algorithm>
 #include <stdarg.h>
 #include <stdio.h>
 
-// Utility functions.
-
-// Get a "file:line:column" source location string.
-static std::string getSourceLocationString(clang::Preprocessor &PP,
-                                           clang::SourceLocation Loc) {
-  if (Loc.isInvalid())
-    return std::string("(none)");
-
-  if (Loc.isFileID()) {
-    clang::PresumedLoc PLoc = PP.getSourceManager().getPresumedLoc(Loc);
-
-    if (PLoc.isInvalid()) {
-      return std::string("(invalid)");
-    }
-
-    std::string Str;
-    llvm::raw_string_ostream SS(Str);
-
-    // The macro expansion and spelling pos is identical for file locs.
-    SS << "\"" << PLoc.getFilename() << ':' << PLoc.getLine() << ':'
-       << PLoc.getColumn() << "\"";
-
-    std::string Result = SS.str();
-
-    // YAML treats backslash as escape, so use forward slashes.
-    std::replace(Result.begin(), Result.end(), '\\', '/');
-
-    return Result;
-  }
-
-  return std::string("(nonfile)");
-}
-
 // Enum string tables.
 
 // FileChangeReason strings.
@@ -86,12 +54,118 @@ static const char *MappingStrings[] = { "0",          "MAP_IGNORE",
                                         "MAP_REMARK", "MAP_WARNING",
                                         "MAP_ERROR",  "MAP_FATAL" };
 
+// Callback names, indexed by CallbackKind.
+static const char *CallbackNames[] = {
+  "FileChanged",          "FileSkipped",           "FileNotFound",
+  "InclusionDirective",   "moduleImport",          "EndOfMainFile",
+  "Ident",                "PragmaDirective",       "PragmaComment",
+  "PragmaDetectMismatch", "PragmaDebug",           "PragmaMessage",
+  "PragmaDiagnosticPush", "PragmaDiagnosticPop",   "PragmaDiagnostic",
+  "PragmaOpenCLExtension", "PragmaWarning",        "PragmaWarningPush",
+  "PragmaWarningPop",     "MacroExpands",          "MacroDefined",
+  "MacroUndefined",       "Defined",               "SourceRangeSkipped",
+  "If",                   "Elif",                  "Ifdef",
+  "Ifndef",               "Else",                  "Endif"
+};
+static_assert(sizeof(CallbackNames) / sizeof(CallbackNames[0]) ==
+                  CK_NumberOfKinds,
+              "CallbackNames out of sync with CallbackKind");
+
+// CallbackFilter functions.
+
+CallbackFilter::CallbackFilter() { Enabled.set(); }
+
+// Get the name of a callback kind.
+const char *CallbackFilter::getCallbackName(CallbackKind Kind) {
+  return CallbackNames[Kind];
+}
+
+// Look up the kind of a callback name.
+bool CallbackFilter::getCallbackKind(llvm::StringRef Name,
+                                     CallbackKind &Kind) {
+  for (int I = 0; I != CK_NumberOfKinds; ++I) {
+    if (Name == CallbackNames[I]) {
+      Kind = CallbackKind(I);
+      return true;
+    }
+  }
+  return false;
+}
+
+// Enable only the named callbacks.
+bool CallbackFilter::setOnly(llvm::ArrayRef<llvm::StringRef> Names,
+                             std::string &ErrorMessage) {
+  Enabled.reset();
+  for (llvm::StringRef Name : Names) {
+    CallbackKind Kind;
+    if (!getCallbackKind(Name, Kind)) {
+      ErrorMessage = "unknown callback name: " + Name.str();
+      return false;
+    }
+    Enabled.set(Kind);
+  }
+  return true;
+}
+
+// Disable the named callbacks.
+bool CallbackFilter::setIgnore(llvm::ArrayRef<llvm::StringRef> Names,
+                               std::string &ErrorMessage) {
+  for (llvm::StringRef Name : Names) {
+    CallbackKind Kind;
+    if (!getCallbackKind(Name, Kind)) {
+      ErrorMessage = "unknown callback name: " + Name.str();
+      return false;
+    }
+    Enabled.reset(Kind);
+  }
+  return true;
+}
+
+// Convert the comma-separated globs to regular expressions.
+void CallbackFilter::setFileGlobs(llvm::StringRef Globs) {
+  llvm::SmallVector<llvm::StringRef, 8> GlobStrings;
+  Globs.split(GlobStrings, ",", /*MaxSplit=*/ -1, /*KeepEmpty=*/false);
+  llvm::StringRef MetaChars("()^$|*+?.[]\\{}");
+  for (llvm::StringRef Glob : GlobStrings) {
+    Glob = Glob.trim();
+    llvm::SmallString<128> RegexText("^");
+    for (char C : Glob) {
+      if (C == '*')
+        RegexText.push_back('.');
+      else if (MetaChars.find(C) != llvm::StringRef::npos)
+        RegexText.push_back('\\');
+      RegexText.push_back(C);
+    }
+    RegexText.push_back('$');
+    FileGlobs.push_back(llvm::Regex(RegexText));
+  }
+}
+
+// Disable the callbacks not in the given list.
+void CallbackFilter::retainOnly(llvm::ArrayRef<CallbackKind> Kinds) {
+  std::bitset<CK_NumberOfKinds> Retained;
+  for (CallbackKind Kind : Kinds)
+    Retained.set(Kind);
+  Enabled &= Retained;
+}
+
+// Does the file name match one of the file globs?
+bool CallbackFilter::matchesFile(llvm::StringRef FileName) {
+  // YAML and globs use forward slashes.
+  llvm::SmallString<256> Path(FileName);
+  std::replace(Path.begin(), Path.end(), '\\', '/');
+  for (llvm::Regex &Glob : FileGlobs)
+    if (Glob.match(Path))
+      return true;
+  return false;
+}
+
 // PPCallbacksTracker functions.
 
-PPCallbacksTracker::PPCallbacksTracker(llvm::SmallSet<std::string, 4> &Ignore,
-                                       std::vector<CallbackCall> &CallbackCalls,
+PPCallbacksTracker::PPCallbacksTracker(CallbackFilter &Filter,
+                                       PPTraceSink &Sink,
                                        clang::Preprocessor &PP)
-    : CallbackCalls(CallbackCalls), Ignore(Ignore), PP(PP) {}
+    : Sink(Sink), Filter(Filter), DisableTrace(false), PP(PP) {}
 
 PPCallbacksTracker::~PPCallbacksTracker() {}
 
@@ -101,7 +175,8 @@ PPCallbacksTracker::~PPCallbacksTracker() {}
 void PPCallbacksTracker::FileChanged(
     clang::SourceLocation Loc, clang::PPCallbacks::FileChangeReason Reason,
     clang::SrcMgr::CharacteristicKind FileType, clang::FileID PrevFID) {
-  beginCallback("FileChanged");
+  if (!beginCallback(CK_FileChanged, Loc))
+    return;
   appendArgument("Loc", Loc);
   appendArgument("Reason", Reason, FileChangeReasonStrings);
   appendArgument("FileType", FileType, CharacteristicKindStrings);
@@ -114,7 +189,8 @@ void
 PPCallbacksTracker::FileSkipped(const clang::FileEntry &SkippedFile,
                                 const clang::Token &FilenameTok,
                                 clang::SrcMgr::CharacteristicKind FileType) {
-  beginCallback("FileSkipped");
+  if (!beginCallback(CK_FileSkipped, FilenameTok.getLocation()))
+    return;
   appendArgument("ParentFile", &SkippedFile);
   appendArgument("FilenameTok", FilenameTok);
   appendArgument("FileType", FileType, CharacteristicKindStrings);
@@ -125,8 +201,8 @@ PPCallbacksTracker::FileSkipped(const clang::FileEntry &SkippedFile,
 bool
 PPCallbacksTracker::FileNotFound(llvm::StringRef FileName,
                                  llvm::SmallVectorImpl<char> &RecoveryPath) {
-  beginCallback("FileNotFound");
-  appendFilePathArgument("FileName", FileName);
+  if (beginCallback(CK_FileNotFound))
+    appendFilePathArgument("FileName", FileName);
   return false;
 }
 
@@ -139,7 +215,8 @@ void PPCallbacksTracker::InclusionDirective(
     clang::CharSourceRange FilenameRange, const clang::FileEntry *File,
     llvm::StringRef SearchPath, llvm::StringRef RelativePath,
     const clang::Module *Imported) {
-  beginCallback("InclusionDirective");
+  if (!beginCallback(CK_InclusionDirective, HashLoc))
+    return;
   appendArgument("IncludeTok", IncludeTok);
   appendFilePathArgument("FileName", FileName);
   appendArgument("IsAngled", IsAngled);
@@ -155,7 +232,8 @@ void PPCallbacksTracker::InclusionDirective(
 void PPCallbacksTracker::moduleImport(clang::SourceLocation ImportLoc,
                                       clang::ModuleIdPath Path,
                                       const clang::Module *Imported) {
-  beginCallback("moduleImport");
+  if (!beginCallback(CK_moduleImport, ImportLoc))
+    return;
   appendArgument("ImportLoc", ImportLoc);
   appendArgument("Path", Path);
   appendArgument("Imported", Imported);
@@ -163,11 +241,12 @@ void PPCallbacksTracker::moduleImport(clang::SourceLocation ImportLoc,
 
 // Callback invoked when the end of the main file is reached.
 // No subsequent callbacks will be made.
-void PPCallbacksTracker::EndOfMainFile() { beginCallback("EndOfMainFile"); }
+void PPCallbacksTracker::EndOfMainFile() { beginCallback(CK_EndOfMainFile); }
 
 // Callback invoked when a #ident or #sccs directive is read.
 void PPCallbacksTracker::Ident(clang::SourceLocation Loc, llvm::StringRef Str) {
-  beginCallback("Ident");
+  if (!beginCallback(CK_Ident, Loc))
+    return;
   appendArgument("Loc", Loc);
   appendArgument("Str", Str);
 }
@@ -176,7 +255,8 @@ void PPCallbacksTracker::Ident(clang::SourceLocation Loc, llvm::StringRef Str) {
 void
 PPCallbacksTracker::PragmaDirective(clang::SourceLocation Loc,
                                     clang::PragmaIntroducerKind Introducer) {
-  beginCallback("PragmaDirective");
+  if (!beginCallback(CK_PragmaDirective, Loc))
+    return;
   appendArgument("Loc", Loc);
   appendArgument("Introducer", Introducer, PragmaIntroducerKindStrings);
 }
@@ -185,7 +265,8 @@ PPCallbacksTracker::PragmaDirective(clang::SourceLocation Loc,
 void PPCallbacksTracker::PragmaComment(clang::SourceLocation Loc,
                                        const clang::IdentifierInfo *Kind,
                                        llvm::StringRef Str) {
-  beginCallback("PragmaComment");
+  if (!beginCallback(CK_PragmaComment, Loc))
+    return;
   appendArgument("Loc", Loc);
   appendArgument("Kind", Kind);
   appendArgument("Str", Str);
@@ -196,7 +277,8 @@ void PPCallbacksTracker::PragmaComment(clang::SourceLocation Loc,
 void PPCallbacksTracker::PragmaDetectMismatch(clang::SourceLocation Loc,
                                               llvm::StringRef Name,
                                               llvm::StringRef Value) {
-  beginCallback("PragmaDetectMismatch");
+  if (!beginCallback(CK_PragmaDetectMismatch, Loc))
+    return;
   appendArgument("Loc", Loc);
   appendArgument("Name", Name);
   appendArgument("Value", Value);
@@ -205,7 +287,8 @@ void PPCallbacksTracker::PragmaDetectMismatch(clang::SourceLocation Loc,
 // Callback invoked when a #pragma clang __debug directive is read.
 void PPCallbacksTracker::PragmaDebug(clang::SourceLocation Loc,
                                      llvm::StringRef DebugType) {
-  beginCallback("PragmaDebug");
+  if (!beginCallback(CK_PragmaDebug, Loc))
+    return;
   appendArgument("Loc", Loc);
   appendArgument("DebugType", DebugType);
 }
@@ -214,7 +297,8 @@ void PPCallbacksTracker::PragmaDebug(clang::SourceLocation Loc,
 void PPCallbacksTracker::PragmaMessage(
     clang::SourceLocation Loc, llvm::StringRef Namespace,
     clang::PPCallbacks::PragmaMessageKind Kind, llvm::StringRef Str) {
-  beginCallback("PragmaMessage");
+  if (!beginCallback(CK_PragmaMessage, Loc))
+    return;
   appendArgument("Loc", Loc);
   appendArgument("Namespace", Namespace);
   appendArgument("Kind", Kind, PragmaMessageKindStrings);
@@ -225,7 +309,8 @@ void PPCallbacksTracker::PragmaMessage(
 // is read.
 void PPCallbacksTracker::PragmaDiagnosticPush(clang::SourceLocation Loc,
                                               llvm::StringRef Namespace) {
-  beginCallback("PragmaDiagnosticPush");
+  if (!beginCallback(CK_PragmaDiagnosticPush, Loc))
+    return;
   appendArgument("Loc", Loc);
   appendArgument("Namespace", Namespace);
 }
@@ -234,7 +319,8 @@ void PPCallbacksTracker::PragmaDiagnosticPush(clang::SourceLocation Loc,
 // is read.
 void PPCallbacksTracker::PragmaDiagnosticPop(clang::SourceLocation Loc,
                                              llvm::StringRef Namespace) {
-  beginCallback("PragmaDiagnosticPop");
+  if (!beginCallback(CK_PragmaDiagnosticPop, Loc))
+    return;
   appendArgument("Loc", Loc);
   appendArgument("Namespace", Namespace);
 }
@@ -244,7 +330,8 @@ void PPCallbacksTracker::PragmaDiagnostic(clang::SourceLocation Loc,
                                           llvm::StringRef Namespace,
                                           clang::diag::Severity Mapping,
                                           llvm::StringRef Str) {
-  beginCallback("PragmaDiagnostic");
+  if (!beginCallback(CK_PragmaDiagnostic, Loc))
+    return;
   appendArgument("Loc", Loc);
   appendArgument("Namespace", Namespace);
   appendArgument("Mapping", (unsigned)Mapping, MappingStrings);
@@ -256,7 +343,8 @@ void PPCallbacksTracker::PragmaDiagnostic(clang::SourceLocation Loc,
 void PPCallbacksTracker::PragmaOpenCLExtension(
     clang::SourceLocation NameLoc, const clang::IdentifierInfo *Name,
     clang::SourceLocation StateLoc, unsigned State) {
-  beginCallback("PragmaOpenCLExtension");
+  if (!beginCallback(CK_PragmaOpenCLExtension, NameLoc))
+    return;
   appendArgument("NameLoc", NameLoc);
   appendArgument("Name", Name);
   appendArgument("StateLoc", StateLoc);
@@ -267,12 +355,13 @@ void PPCallbacksTracker::PragmaOpenCLExtension(
 void PPCallbacksTracker::PragmaWarning(clang::SourceLocation Loc,
                                        llvm::StringRef WarningSpec,
                                        llvm::ArrayRef<int> Ids) {
-  beginCallback("PragmaWarning");
+  if (!beginCallback(CK_PragmaWarning, Loc))
+    return;
   appendArgument("Loc", Loc);
   appendArgument("WarningSpec", WarningSpec);
 
-  std::string Str;
-  llvm::raw_string_ostream SS(Str);
+  Buffer.clear();
+  llvm::raw_svector_ostream SS(Buffer);
   SS << "[";
   for (int i = 0, e = Ids.size(); i != e; ++i) {
     if (i)
@@ -286,14 +375,16 @@ void PPCallbacksTracker::PragmaWarning(clang::SourceLocation Loc,
 // Callback invoked when a #pragma warning(push) directive is read.
 void PPCallbacksTracker::PragmaWarningPush(clang::SourceLocation Loc,
                                            int Level) {
-  beginCallback("PragmaWarningPush");
+  if (!beginCallback(CK_PragmaWarningPush, Loc))
+    return;
   appendArgument("Loc", Loc);
   appendArgument("Level", Level);
 }
 
 // Callback invoked when a #pragma warning(pop) directive is read.
 void PPCallbacksTracker::PragmaWarningPop(clang::SourceLocation Loc) {
-  beginCallback("PragmaWarningPop");
+  if (!beginCallback(CK_PragmaWarningPop, Loc))
+    return;
   appendArgument("Loc", Loc);
 }
 
@@ -304,7 +395,8 @@ PPCallbacksTracker::MacroExpands(const clang::Token &MacroNameTok,
                                  const clang::MacroDefinition &MacroDefinition,
                                  clang::SourceRange Range,
                                  const clang::MacroArgs *Args) {
-  beginCallback("MacroExpands");
+  if (!beginCallback(CK_MacroExpands, MacroNameTok.getLocation()))
+    return;
   appendArgument("MacroNameTok", MacroNameTok);
   appendArgument("MacroDefinition", MacroDefinition);
   appendArgument("Range", Range);
@@ -315,7 +407,8 @@ PPCallbacksTracker::MacroExpands(const clang::Token &MacroNameTok,
 void
 PPCallbacksTracker::MacroDefined(const clang::Token &MacroNameTok,
                                  const clang::MacroDirective *MacroDirective) {
-  beginCallback("MacroDefined");
+  if (!beginCallback(CK_MacroDefined, MacroNameTok.getLocation()))
+    return;
   appendArgument("MacroNameTok", MacroNameTok);
   appendArgument("MacroDirective", MacroDirective);
 }
@@ -324,7 +417,8 @@ PPCallbacksTracker::MacroDefined(const clang::Token &MacroNameTok,
 void PPCallbacksTracker::MacroUndefined(
     const clang::Token &MacroNameTok,
     const clang::MacroDefinition &MacroDefinition) {
-  beginCallback("MacroUndefined");
+  if (!beginCallback(CK_MacroUndefined, MacroNameTok.getLocation()))
+    return;
   appendArgument("MacroNameTok", MacroNameTok);
   appendArgument("MacroDefinition", MacroDefinition);
 }
@@ -333,7 +427,8 @@ void PPCallbacksTracker::MacroUndefined(
 void PPCallbacksTracker::Defined(const clang::Token &MacroNameTok,
                                  const clang::MacroDefinition &MacroDefinition,
                                  clang::SourceRange Range) {
-  beginCallback("Defined");
+  if (!beginCallback(CK_Defined, MacroNameTok.getLocation()))
+    return;
   appendArgument("MacroNameTok", MacroNameTok);
   appendArgument("MacroDefinition", MacroDefinition);
   appendArgument("Range", Range);
@@ -341,7 +436,8 @@ void PPCallbacksTracker::Defined(const clang::Token &MacroNameTok,
 
 // Hook called when a source range is skipped.
 void PPCallbacksTracker::SourceRangeSkipped(clang::SourceRange Range) {
-  beginCallback("SourceRangeSkipped");
+  if (!beginCallback(CK_SourceRangeSkipped, Range.getBegin()))
+    return;
   appendArgument("Range", Range);
 }
 
@@ -349,7 +445,8 @@ void PPCallbacksTracker::SourceRangeSkipped(clang::SourceRange Range) {
 void PPCallbacksTracker::If(clang::SourceLocation Loc,
                             clang::SourceRange ConditionRange,
                             ConditionValueKind ConditionValue) {
-  beginCallback("If");
+  if (!beginCallback(CK_If, Loc))
+    return;
   appendArgument("Loc", Loc);
   appendArgument("ConditionRange", ConditionRange);
   appendArgument("ConditionValue", ConditionValue, ConditionValueKindStrings);
@@ -360,7 +457,8 @@ void PPCallbacksTracker::Elif(clang::SourceLocation Loc,
                               clang::SourceRange ConditionRange,
                               ConditionValueKind ConditionValue,
                               clang::SourceLocation IfLoc) {
-  beginCallback("Elif");
+  if (!beginCallback(CK_Elif, Loc))
+    return;
   appendArgument("Loc", Loc);
   appendArgument("ConditionRange", ConditionRange);
   appendArgument("ConditionValue", ConditionValue, ConditionValueKindStrings);
@@ -371,7 +469,8 @@ void PPCallbacksTracker::Elif(clang::SourceLocation Loc,
 void PPCallbacksTracker::Ifdef(clang::SourceLocation Loc,
                                const clang::Token &MacroNameTok,
                                const clang::MacroDefinition &MacroDefinition) {
-  beginCallback("Ifdef");
+  if (!beginCallback(CK_Ifdef, Loc))
+    return;
   appendArgument("Loc", Loc);
   appendArgument("MacroNameTok", MacroNameTok);
   appendArgument("MacroDefinition", MacroDefinition);
@@ -381,7 +480,8 @@ void PPCallbacksTracker::Ifdef(clang::SourceLocation Loc,
 void PPCallbacksTracker::Ifndef(clang::SourceLocation Loc,
                                 const clang::Token &MacroNameTok,
                                 const clang::MacroDefinition &MacroDefinition) {
-  beginCallback("Ifndef");
+  if (!beginCallback(CK_Ifndef, Loc))
+    return;
   appendArgument("Loc", Loc);
   appendArgument("MacroNameTok", MacroNameTok);
   appendArgument("MacroDefinition", MacroDefinition);
@@ -390,7 +490,8 @@ void PPCallbacksTracker::Ifndef(clang::SourceLocation Loc,
 // Hook called whenever an #else is seen.
 void PPCallbacksTracker::Else(clang::SourceLocation Loc,
                               clang::SourceLocation IfLoc) {
-  beginCallback("Else");
+  if (!beginCallback(CK_Else, Loc))
+    return;
   appendArgument("Loc", Loc);
   appendArgument("IfLoc", IfLoc);
 }
@@ -398,67 +499,98 @@ void PPCallbacksTracker::Else(clang::SourceLocation Loc,
 // Hook called whenever an #endif is seen.
 void PPCallbacksTracker::Endif(clang::SourceLocation Loc,
                                clang::SourceLocation IfLoc) {
-  beginCallback("Endif");
+  if (!beginCallback(CK_Endif, Loc))
+    return;
   appendArgument("Loc", Loc);
   appendArgument("IfLoc", IfLoc);
 }
 
 // Helper functions.
 
-// Start a new callback.
-void PPCallbacksTracker::beginCallback(const char *Name) {
-  DisableTrace = Ignore.count(std::string(Name));
+// Start a new callback, if it is to be traced.
+bool PPCallbacksTracker::beginCallback(CallbackKind Kind,
+                                       clang::SourceLocation Loc) {
+  DisableTrace = !isTraced(Kind, Loc);
   if (DisableTrace)
-    return;
-  CallbackCalls.push_back(CallbackCall(Name));
+    return false;
+  Sink.beginCallback(CallbackFilter::getCallbackName(Kind));
+  return true;
+}
+
+// Does the filter let the callback through?
+bool PPCallbacksTracker::isTraced(CallbackKind Kind,
+                                  clang::SourceLocation Loc) {
+  return Filter.isEnabled(Kind) &&
+         (!Filter.hasFileGlobs() || Loc.isInvalid() || isInFilteredFile(Loc));
+}
+
+// Is the location in a file matching the filter's file globs?
+// The answer is cached per file.
+bool PPCallbacksTracker::isInFilteredFile(clang::SourceLocation Loc) {
+  clang::SourceManager &SM = PP.getSourceManager();
+  clang::FileID FID = SM.getFileID(SM.getExpansionLoc(Loc));
+  auto Cached = FileFilterCache.find(FID);
+  if (Cached != FileFilterCache.end())
+    return Cached->second;
+  const clang::FileEntry *File = SM.getFileEntryForID(FID);
+  bool Matches = File && Filter.matchesFile(File->getName());
+  FileFilterCache[FID] = Matches;
+  return Matches;
 }
 
 // Append a bool argument to the top trace item.
 void PPCallbacksTracker::appendArgument(const char *Name, bool Value) {
-  appendArgument(Name, (Value ? "true" : "false"));
+  if (DisableTrace)
+    return;
+  Sink.appendBoolArgument(Name, Value);
 }
 
 // Append an int argument to the top trace item.
 void PPCallbacksTracker::appendArgument(const char *Name, int Value) {
-  std::string Str;
-  llvm::raw_string_ostream SS(Str);
-  SS << Value;
-  appendArgument(Name, SS.str());
+  if (DisableTrace)
+    return;
+  Sink.appendIntArgument(Name, Value);
 }
 
 // Append a string argument to the top trace item.
 void PPCallbacksTracker::appendArgument(const char *Name, const char *Value) {
-  if (DisableTrace)
-    return;
-  CallbackCalls.back().Arguments.push_back(Argument(Name, Value));
+  appendArgument(Name, llvm::StringRef(Value));
 }
 
-// Append a string object argument to the top trace item.
+// Append a string reference object argument to the top trace item.
 void PPCallbacksTracker::appendArgument(const char *Name,
                                         llvm::StringRef Value) {
-  appendArgument(Name, Value.str());
+  if (DisableTrace)
+    return;
+  Sink.appendArgument(Name, Value);
 }
 
 // Append a string object argument to the top trace item.
 void PPCallbacksTracker::appendArgument(const char *Name,
                                         const std::string &Value) {
-  appendArgument(Name, Value.c_str());
+  appendArgument(Name, llvm::StringRef(Value));
 }
 
 // Append a token argument to the top trace item.
 void PPCallbacksTracker::appendArgument(const char *Name,
                                         const clang::Token &Value) {
-  appendArgument(Name, PP.getSpelling(Value));
+  if (DisableTrace)
+    return;
+  appendArgument(Name, PP.getSpelling(Value, Buffer));
 }
 
 // Append an enum argument to the top trace item.
 void PPCallbacksTracker::appendArgument(const char *Name, int Value,
                                         const char *Strings[]) {
-  appendArgument(Name, Strings[Value]);
+  if (DisableTrace)
+    return;
+  Sink.appendEnumArgument(Name, Strings[Value]);
 }
 
 // Append a FileID argument to the top trace item.
 void PPCallbacksTracker::appendArgument(const char *Name, clang::FileID Value) {
+  if (DisableTrace)
+    return;
   if (Value.isInvalid()) {
     appendArgument(Name, "(invalid)");
     return;
@@ -485,11 +617,13 @@ void PPCallbacksTracker::appendArgument(const char *Name,
 // Append a SourceLocation argument to the top trace item.
 void PPCallbacksTracker::appendArgument(const char *Name,
                                         clang::SourceLocation Value) {
+  if (DisableTrace)
+    return;
   if (Value.isInvalid()) {
     appendArgument(Name, "(invalid)");
     return;
   }
-  appendArgument(Name, getSourceLocationString(PP, Value).c_str());
+  Sink.appendLocationArgument(Name, getTraceLocation(Value));
 }
 
 // Append a SourceRange argument to the top trace item.
@@ -501,21 +635,20 @@ void PPCallbacksTracker::appendArgument(const char *Name,
     appendArgument(Name, "(invalid)");
     return;
   }
-  std::string Str;
-  llvm::raw_string_ostream SS(Str);
-  SS << "[" << getSourceLocationString(PP, Value.getBegin()) << ", "
-     << getSourceLocationString(PP, Value.getEnd()) << "]";
-  appendArgument(Name, SS.str());
+  Sink.appendRangeArgument(Name, getTraceLocation(Value.getBegin()),
+                           getTraceLocation(Value.getEnd()));
 }
 
 // Append a CharSourceRange argument to the top trace item.
 void PPCallbacksTracker::appendArgument(const char *Name,
                                         clang::CharSourceRange Value) {
+  if (DisableTrace)
+    return;
   if (Value.isInvalid()) {
     appendArgument(Name, "(invalid)");
     return;
   }
-  appendArgument(Name, getSourceString(Value).str().c_str());
+  appendArgument(Name, getSourceString(Value));
 }
 
 // Append a SourceLocation argument to the top trace item.
@@ -523,15 +656,17 @@ void PPCallbacksTracker::appendArgument(const char *Name,
                                         clang::ModuleIdPath Value) {
   if (DisableTrace)
     return;
-  std::string Str;
-  llvm::raw_string_ostream SS(Str);
+  Buffer.clear();
+  llvm::raw_svector_ostream SS(Buffer);
   SS << "[";
   for (int I = 0, E = Value.size(); I != E; ++I) {
     if (I)
       SS << ", ";
     SS << "{"
        << "Name: " << Value[I].first->getName() << ", "
-       << "Loc: " << getSourceLocationString(PP, Value[I].second) << "}";
+       << "Loc: ";
+    getTraceLocation(Value[I].second).print(SS);
+    SS << "}";
   }
   SS << "]";
   appendArgument(Name, SS.str());
@@ -544,7 +679,7 @@ void PPCallbacksTracker::appendArgument(const char *Name,
     appendArgument(Name, "(null)");
     return;
   }
-  appendArgument(Name, Value->getName().str().c_str());
+  appendArgument(Name, Value->getName());
 }
 
 // Append a MacroDirective argument to the top trace item.
@@ -560,8 +695,10 @@ void PPCallbacksTracker::appendArgument(const char *Name,
 // Append a MacroDefinition argument to the top trace item.
 void PPCallbacksTracker::appendArgument(const char *Name,
                                         const clang::MacroDefinition &Value) {
-  std::string Str;
-  llvm::raw_string_ostream SS(Str);
+  if (DisableTrace)
+    return;
+  Buffer.clear();
+  llvm::raw_svector_ostream SS(Buffer);
   SS << "[";
   bool Any = false;
   if (Value.getLocalDirective()) {
@@ -579,12 +716,15 @@ void PPCallbacksTracker::appendArgument(const char *Name,
 // Append a MacroArgs argument to the top trace item.
 void PPCallbacksTracker::appendArgument(const char *Name,
                                         const clang::MacroArgs *Value) {
+  if (DisableTrace)
+    return;
   if (!Value) {
     appendArgument(Name, "(null)");
     return;
   }
-  std::string Str;
-  llvm::raw_string_ostream SS(Str);
+  Buffer.clear();
+  llvm::raw_svector_ostream SS(Buffer);
+  llvm::SmallString<32> Spelling;
   SS << "[";
   // The argument tokens might include end tokens, so we reflect how
   // how getUnexpArgument provides the arguments.
@@ -605,7 +745,7 @@ void PPCallbacksTracker::appendArgument(const char *Name,
       // numeric literals.
       if (Current->isAnyIdentifier() ||
           Current->is(clang::tok::numeric_constant)) {
-        SS << PP.getSpelling(*Current);
+        SS << PP.getSpelling(*Current, Spelling);
       } else {
         SS << "<" << Current->getName() << ">";
       }
@@ -622,14 +762,16 @@ void PPCallbacksTracker::appendArgument(const char *Name,
     appendArgument(Name, "(null)");
     return;
   }
-  appendArgument(Name, Value->Name.c_str());
+  appendArgument(Name, Value->Name);
 }
 
 // Append a double-quoted argument to the top trace item.
 void PPCallbacksTracker::appendQuotedArgument(const char *Name,
                                               const std::string &Value) {
-  std::string Str;
-  llvm::raw_string_ostream SS(Str);
+  if (DisableTrace)
+    return;
+  Buffer.clear();
+  llvm::raw_svector_ostream SS(Buffer);
   SS << "\"" << Value << "\"";
   appendArgument(Name, SS.str());
 }
@@ -637,10 +779,27 @@ void PPCallbacksTracker::appendQuotedArgument(const char *Name,
 // Append a double-quoted file path argument to the top trace item.
 void PPCallbacksTracker::appendFilePathArgument(const char *Name,
                                                 llvm::StringRef Value) {
-  std::string Path(Value);
-  // YAML treats backslash as escape, so use forward slashes.
-  std::replace(Path.begin(), Path.end(), '\\', '/');
-  appendQuotedArgument(Name, Path);
+  if (DisableTrace)
+    return;
+  Sink.appendFilePathArgument(Name, Value);
+}
+
+// Get the "file:line:column" form of a source location.
+TraceLocation
+PPCallbacksTracker::getTraceLocation(clang::SourceLocation Loc) {
+  if (Loc.isInvalid())
+    return TraceLocation(TraceLocation::LK_None);
+
+  if (!Loc.isFileID())
+    return TraceLocation(TraceLocation::LK_NonFile);
+
+  clang::PresumedLoc PLoc = PP.getSourceManager().getPresumedLoc(Loc);
+
+  if (PLoc.isInvalid())
+    return TraceLocation(TraceLocation::LK_Invalid);
+
+  // The macro expansion and spelling pos is identical for file locs.
+  return TraceLocation(PLoc.getFilename(), PLoc.getLine(), PLoc.getColumn());
 }
 
 // Get the raw source string of the range.
@@ -12,54 +12,135 @@
 ///
 /// The core definition is the PPCallbacksTracker class, derived from Clang's
 /// PPCallbacks class from the Lex library, which overrides all the callbacks
-/// and collects information about each callback call, saving it in a
-/// data structure built up of CallbackCall and Argument objects, which
-/// record the preprocessor callback name and arguments in high-level string
-/// form for later inspection.
+/// and collects information about each callback call, handing the
+/// preprocessor callback name and arguments in high-level string form
+/// to a PPTraceSink object, which either buffers them for later inspection
+/// or writes them out immediately.
 ///
 //===--------------------------------------------------------------------===//
 
 #ifndef PPTRACE_PPCALLBACKSTRACKER_H
 #define PPTRACE_PPCALLBACKSTRACKER_H
 
+#include "PPTraceSink.h"
 #include "clang/Lex/PPCallbacks.h"
 #include "clang/Lex/Preprocessor.h"
-
-/// \brief This class represents one callback function argument by name
-///   and value.
-class Argument {
-public:
-  Argument(llvm::StringRef Name, llvm::StringRef Value)
-      : Name(Name), Value(Value) {}
-  Argument() {}
-
-  std::string Name;
-  std::string Value;
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/Regex.h"
+#include <bitset>
+
+/// \brief Kinds of callbacks, one per overridden PPCallbacks function.
+enum CallbackKind {
+  CK_FileChanged,
+  CK_FileSkipped,
+  CK_FileNotFound,
+  CK_InclusionDirective,
+  CK_moduleImport,
+  CK_EndOfMainFile,
+  CK_Ident,
+  CK_PragmaDirective,
+  CK_PragmaComment,
+  CK_PragmaDetectMismatch,
+  CK_PragmaDebug,
+  CK_PragmaMessage,
+  CK_PragmaDiagnosticPush,
+  CK_PragmaDiagnosticPop,
+  CK_PragmaDiagnostic,
+  CK_PragmaOpenCLExtension,
+  CK_PragmaWarning,
+  CK_PragmaWarningPush,
+  CK_PragmaWarningPop,
+  CK_MacroExpands,
+  CK_MacroDefined,
+  CK_MacroUndefined,
+  CK_Defined,
+  CK_SourceRangeSkipped,
+  CK_If,
+  CK_Elif,
+  CK_Ifdef,
+  CK_Ifndef,
+  CK_Else,
+  CK_Endif,
+  CK_NumberOfKinds
 };
 
-/// \brief This class represents one callback call by name and an array
-///   of arguments.
-class CallbackCall {
+/// \brief This class determines which callbacks get traced.
+///
+/// The callback names given on the command line are compiled into a
+/// bitmask indexed by callback kind, so checking whether a callback is
+/// enabled is a single bit test.  Callbacks can also be limited to those
+/// located in files matching a list of globs.
+class CallbackFilter {
 public:
-  CallbackCall(llvm::StringRef Name) : Name(Name) {}
-  CallbackCall() {}
-
-  std::string Name;
-  std::vector<Argument> Arguments;
+  /// \brief Construct a filter that enables all callbacks in all files.
+  CallbackFilter();
+
+  /// \brief Get the name of a callback kind.
+  static const char *getCallbackName(CallbackKind Kind);
+
+  /// \brief Enable only the named callbacks.
+  /// \param Names - The callback names.
+  /// \param ErrorMessage - Set to a description of the problem if a name
+  ///   isn't a callback name.
+  /// \returns True if all the names are callback names.
+  bool setOnly(llvm::ArrayRef<llvm::StringRef> Names,
+               std::string &ErrorMessage);
+
+  /// \brief Disable the named callbacks.
+  /// \param Names - The callback names.
+  /// \param ErrorMessage - Set to a description of the problem if a name
+  ///   isn't a callback name.
+  /// \returns True if all the names are callback names.
+  bool setIgnore(llvm::ArrayRef<llvm::StringRef> Names,
+                 std::string &ErrorMessage);
+
+  /// \brief Only trace callbacks located in files matching a glob.
+  /// \param Globs - A comma-separated list of globs, in which '*' matches
+  ///   any sequence of characters.
+  void setFileGlobs(llvm::StringRef Globs);
+
+  /// \brief Disable the callbacks not in the given list, keeping the
+  ///   others as they are.
+  void retainOnly(llvm::ArrayRef<CallbackKind> Kinds);
+
+  /// \brief Is the given callback kind enabled?
+  bool isEnabled(CallbackKind Kind) const { return Enabled[Kind]; }
+
+  /// \brief Are callbacks limited to some files?
+  bool hasFileGlobs() const { return !FileGlobs.empty(); }
+
+  /// \brief Does the file name match one of the file globs?
+  bool matchesFile(llvm::StringRef FileName);
+
+private:
+  /// \brief Look up the kind of a callback name.
+  /// \returns False if it isn't a callback name.
+  static bool getCallbackKind(llvm::StringRef Name, CallbackKind &Kind);
+
+  /// \brief Bit set for each enabled callback kind.
+  std::bitset<CK_NumberOfKinds> Enabled;
+
+  /// \brief Regular expressions for the file globs.
+  std::vector<llvm::Regex> FileGlobs;
 };
 
 /// \brief This class overrides the PPCallbacks class for tracking preprocessor
 ///   activity by means of its callback functions.
 ///
-/// This object is given a vector for storing the trace information, built up
-/// of CallbackCall and subordinate Argument objects for representing the
-/// callback calls and their arguments.  It's a reference so the vector can
-/// exist beyond the lifetime of this object, because it's deleted by the
-/// preprocessor automatically in its destructor.
+/// This object is given a sink for receiving the trace information, which
+/// is handed each callback call and its arguments as soon as the callback
+/// is made.  It's a reference so the sink can exist beyond the lifetime of
+/// this object, because it's deleted by the preprocessor automatically in
+/// its destructor.  The arguments are formatted into a reusable buffer, so
+/// a streaming sink incurs no heap allocation per callback.
 ///
 /// This class supports a mechanism for inhibiting trace output for
-/// specific callbacks by name, for the purpose of eliminating output for
-/// callbacks of no interest that might clutter the output.
+/// specific callbacks by name, or for callbacks located in files of no
+/// interest, for the purpose of eliminating output for callbacks of no
+/// interest that might clutter the output.  See CallbackFilter.  A callback
+/// that isn't traced returns before formatting any of its arguments.
 ///
 /// Following the constructor and destructor function declarations, the
 /// overidden callback functions are defined.  The remaining functions are
@@ -69,11 +150,10 @@ class PPCallbacksTracker : public clang::PPCallbacks {
 public:
   /// \brief Note that all of the arguments are references, and owned
   /// by the caller.
-  /// \param Ignore - Set of names of callbacks to ignore.
-  /// \param CallbackCalls - Trace buffer.
+  /// \param Filter - Which callbacks to trace.
+  /// \param Sink - Trace receiver.
   /// \param PP - The preprocessor.  Needed for getting some argument strings.
-  PPCallbacksTracker(llvm::SmallSet<std::string, 4> &Ignore,
-                     std::vector<CallbackCall> &CallbackCalls,
+  PPCallbacksTracker(CallbackFilter &Filter, PPTraceSink &Sink,
                      clang::Preprocessor &PP);
 
   ~PPCallbacksTracker() override;
@@ -154,8 +234,21 @@ public:
 
   // Helper functions.
 
-  /// \brief Start a new callback.
-  void beginCallback(const char *Name);
+  /// \brief Start a new callback, if it is to be traced.
+  /// \param Kind - The callback kind.
+  /// \param Loc - The location used for filtering by file, if any.
+  /// \returns True if the callback is to be traced.
+  bool beginCallback(CallbackKind Kind,
+                     clang::SourceLocation Loc = clang::SourceLocation());
+
+  /// \brief Does the filter let the callback through?
+  /// \param Kind - The callback kind.
+  /// \param Loc - The location used for filtering by file, if any.
+  bool isTraced(CallbackKind Kind,
+                clang::SourceLocation Loc = clang::SourceLocation());
+
+  /// \brief Is the location in a file matching the filter's file globs?
+  bool isInFilteredFile(clang::SourceLocation Loc);
 
   /// \brief Append a string to the top trace item.
   void append(const char *Str);
@@ -220,16 +313,25 @@ public:
   /// \brief Append a double-quoted file path argument to the top trace item.
   void appendFilePathArgument(const char *Name, llvm::StringRef Value);
 
+  /// \brief Get the "file:line:column" form of a source location.
+  TraceLocation getTraceLocation(clang::SourceLocation Loc);
+
   /// \brief Get the raw source string of the range.
   llvm::StringRef getSourceString(clang::CharSourceRange Range);
 
-  /// \brief Callback trace information.
+  /// \brief Callback trace receiver.
   /// We use a reference so the trace will be preserved for the caller
   /// after this object is destructed.
-  std::vector<CallbackCall> &CallbackCalls;
+  PPTraceSink &Sink;
+
+  /// \brief Reusable buffer for formatting argument strings.
+  llvm::SmallString<128> Buffer;
+
+  /// \brief Which callbacks to trace.
+  CallbackFilter &Filter;
 
-  /// \brief Names of callbacks to ignore.
-  llvm::SmallSet<std::string, 4> &Ignore;
+  /// \brief Cache of whether each file matches the filter's file globs.
+  llvm::DenseMap<clang::FileID, bool> FileFilterCache;
 
   /// \brief Inhibit trace while this is set.
   bool DisableTrace;
@@ -0,0 +1,365 @@
+//===--- PPStatistics.cpp - Preprocessor statistics -*--*----------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===--------------------------------------------------------------------===//
+///
+/// \file
+/// \brief Implementations for aggregated preprocessor statistics.
+///
+/// See the header for details.
+///
+//===--------------------------------------------------------------------===//
+
+#include "PPStatistics.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/Timer.h"
+#include <algorithm>
+#include <iterator>
+
+// FileStatistics functions.
+
+// Add the statistics of the same file from other translation units.
+void FileStatistics::merge(const FileStatistics &Other) {
+  Includes += Other.Includes;
+  Entries += Other.Entries;
+  Skipped += Other.Skipped;
+  TranslationUnits += Other.TranslationUnits;
+  Conditionals += Other.Conditionals;
+  SelfTime += Other.SelfTime;
+  InclusiveTime += Other.InclusiveTime;
+}
+
+// PPStatistics functions.
+
+PPStatistics::PPStatistics() : TranslationUnits(0) {
+  std::fill(std::begin(ConditionalCounts), std::end(ConditionalCounts), 0);
+}
+
+// Add the statistics of other translation units.
+void PPStatistics::merge(const PPStatistics &Other) {
+  TranslationUnits += Other.TranslationUnits;
+  for (unsigned I = 0, E = CK_Endif - CK_If + 1; I != E; ++I)
+    ConditionalCounts[I] += Other.ConditionalCounts[I];
+  for (const auto &File : Other.Files)
+    Files[File.getKey()].merge(File.getValue());
+  for (const auto &Macro : Other.MacroExpansions)
+    MacroExpansions[Macro.getKey()] += Macro.getValue();
+}
+
+namespace {
+typedef llvm::StringMapEntry<FileStatistics> FileStatsEntry;
+typedef llvm::StringMapEntry<unsigned> MacroEntry;
+
+// Collect the entries of a map, sorted by decreasing key, then by name.
+template <typename EntryT, typename MapT, typename KeyFn>
+std::vector<const EntryT *> sortEntries(const MapT &Map, KeyFn Key) {
+  std::vector<const EntryT *> Entries;
+  for (const auto &Entry : Map)
+    Entries.push_back(&Entry);
+  std::sort(Entries.begin(), Entries.end(),
+            [&](const EntryT *LHS, const EntryT *RHS) {
+    auto LHSKey = Key(*LHS);
+    auto RHSKey = Key(*RHS);
+    if (LHSKey != RHSKey)
+      return LHSKey > RHSKey;
+    return LHS->getKey() < RHS->getKey();
+  });
+  return Entries;
+}
+
+// Get the number of rows to print.
+size_t getRowCount(size_t Size, unsigned Limit) {
+  return Limit ? std::min<size_t>(Size, Limit) : Size;
+}
+
+// Write a double-quoted JSON string.
+void writeJSONString(llvm::raw_ostream &OS, llvm::StringRef Str) {
+  OS << '"';
+  for (unsigned char C : Str) {
+    if (C == '"' || C == '\\')
+      OS << '\\' << C;
+    else if (C < 0x20)
+      OS << llvm::format("\\u%04x", C);
+    else
+      OS << C;
+  }
+  OS << '"';
+}
+} // namespace
+
+// Print a text report, with each table sorted by decreasing count or time.
+void PPStatistics::printText(llvm::raw_ostream &OS, unsigned Limit) const {
+  OS << "Translation units: " << TranslationUnits << "\n";
+
+  OS << "\nConditional directives:\n";
+  for (unsigned I = 0, E = CK_Endif - CK_If + 1; I != E; ++I)
+    OS << llvm::format("  %-8s%10u\n",
+                       CallbackFilter::getCallbackName(CallbackKind(CK_If + I)),
+                       ConditionalCounts[I]);
+
+  // Files by time.
+  std::vector<const FileStatsEntry *> ByTime =
+      sortEntries<FileStatsEntry>(Files, [](const FileStatsEntry &E) {
+        return E.getValue().InclusiveTime;
+      });
+  OS << "\nFiles by inclusive time:\n";
+  OS << "  Inclusive(ms)   Self(ms)  Entries  File\n";
+  for (size_t I = 0, E = getRowCount(ByTime.size(), Limit); I != E; ++I) {
+    const FileStatistics &File = ByTime[I]->getValue();
+    OS << llvm::format("  %13.3f %10.3f %8u  ", File.InclusiveTime * 1000.0,
+                       File.SelfTime * 1000.0, File.Entries)
+       << ByTime[I]->getKey() << "\n";
+  }
+
+  // Headers entered more than once in a translation unit.
+  std::vector<const FileStatsEntry *> ByReentries =
+      sortEntries<FileStatsEntry>(Files, [](const FileStatsEntry &E) {
+        return E.getValue().Entries - E.getValue().TranslationUnits;
+      });
+  OS << "\nFiles entered more than once per translation unit:\n";
+  OS << "   Entries      TUs  Skipped  File\n";
+  for (size_t I = 0, E = getRowCount(ByReentries.size(), Limit); I != E; ++I) {
+    const FileStatistics &File = ByReentries[I]->getValue();
+    if (File.Entries <= File.TranslationUnits)
+      break;
+    OS << llvm::format("  %8u %8u %8u  ", File.Entries, File.TranslationUnits,
+                       File.Skipped)
+       << ByReentries[I]->getKey() << "\n";
+  }
+
+  // Files by inclusion directives.
+  std::vector<const FileStatsEntry *> ByIncludes =
+      sortEntries<FileStatsEntry>(Files, [](const FileStatsEntry &E) {
+        return E.getValue().Includes;
+      });
+  OS << "\nFiles by inclusion directives:\n";
+  OS << "  Includes  Conditionals  File\n";
+  for (size_t I = 0, E = getRowCount(ByIncludes.size(), Limit); I != E; ++I) {
+    const FileStatistics &File = ByIncludes[I]->getValue();
+    if (File.Includes == 0)
+      break;
+    OS << llvm::format("  %8u  %12u  ", File.Includes, File.Conditionals)
+       << ByIncludes[I]->getKey() << "\n";
+  }
+
+  // Macros by expansions.
+  std::vector<const MacroEntry *> ByExpansions = sortEntries<MacroEntry>(
+      MacroExpansions, [](const MacroEntry &E) { return E.getValue(); });
+  OS << "\nMacros by expansions:\n";
+  OS << "  Expansions  Macro\n";
+  for (size_t I = 0, E = getRowCount(ByExpansions.size(), Limit); I != E; ++I)
+    OS << llvm::format("  %10u  ", ByExpansions[I]->getValue())
+       << ByExpansions[I]->getKey() << "\n";
+}
+
+// Print all the statistics as a JSON object.
+void PPStatistics::printJSON(llvm::raw_ostream &OS) const {
+  OS << "{\n";
+  OS << "  \"TranslationUnits\": " << TranslationUnits << ",\n";
+
+  OS << "  \"Conditionals\": {";
+  for (unsigned I = 0, E = CK_Endif - CK_If + 1; I != E; ++I) {
+    OS << (I ? ", " : "");
+    writeJSONString(OS,
+                    CallbackFilter::getCallbackName(CallbackKind(CK_If + I)));
+    OS << ": " << ConditionalCounts[I];
+  }
+  OS << "},\n";
+
+  // Sort by name, so the output is stable.
+  std::vector<const FileStatsEntry *> SortedFiles;
+  for (const FileStatsEntry &File : Files)
+    SortedFiles.push_back(&File);
+  std::sort(SortedFiles.begin(), SortedFiles.end(),
+            [](const FileStatsEntry *LHS, const FileStatsEntry *RHS) {
+    return LHS->getKey() < RHS->getKey();
+  });
+  OS << "  \"Files\": [";
+  for (size_t I = 0, E = SortedFiles.size(); I != E; ++I) {
+    const FileStatistics &File = SortedFiles[I]->getValue();
+    OS << (I ? ",\n" : "\n") << "    {\"File\": ";
+    writeJSONString(OS, SortedFiles[I]->getKey());
+    OS << ", \"Includes\": " << File.Includes
+       << ", \"Entries\": " << File.Entries
+       << ", \"Skipped\": " << File.Skipped
+       << ", \"TranslationUnits\": " << File.TranslationUnits
+       << ", \"Conditionals\": " << File.Conditionals
+       << llvm::format(", \"SelfTime\": %.6f", File.SelfTime)
+       << llvm::format(", \"InclusiveTime\": %.6f", File.InclusiveTime)
+       << "}";
+  }
+  OS << (SortedFiles.empty() ? "],\n" : "\n  ],\n");
+
+  std::vector<const MacroEntry *> SortedMacros;
+  for (const MacroEntry &Macro : MacroExpansions)
+    SortedMacros.push_back(&Macro);
+  std::sort(SortedMacros.begin(), SortedMacros.end(),
+            [](const MacroEntry *LHS, const MacroEntry *RHS) {
+    return LHS->getKey() < RHS->getKey();
+  });
+  OS << "  \"Macros\": [";
+  for (size_t I = 0, E = SortedMacros.size(); I != E; ++I) {
+    OS << (I ? ",\n" : "\n") << "    {\"Macro\": ";
+    writeJSONString(OS, SortedMacros[I]->getKey());
+    OS << ", \"Expansions\": " << SortedMacros[I]->getValue() << "}";
+  }
+  OS << (SortedMacros.empty() ? "]\n" : "\n  ]\n");
+  OS << "}\n";
+}
+
+// PPStatisticsTracker functions.
+
+// The callbacks counted.
+static const CallbackKind StatisticsKinds[] = {
+  CK_FileChanged, CK_FileSkipped, CK_InclusionDirective, CK_MacroExpands,
+  CK_If,          CK_Elif,        CK_Ifdef,              CK_Ifndef,
+  CK_Else,        CK_Endif
+};
+
+PPStatisticsTracker::PPStatisticsTracker(CallbackFilter &Filter,
+                                         PPTraceSink &Sink,
+                                         clang::Preprocessor &PP,
+                                         PPStatistics &Stats)
+    : PPCallbacksTracker(Filter, Sink, PP), Stats(Stats),
+      LastChangeTime(0.0) {}
+
+// Get the kinds of the callbacks counted.
+llvm::ArrayRef<CallbackKind> PPStatisticsTracker::getStatisticsKinds() {
+  return StatisticsKinds;
+}
+
+// Track the include stack and the time spent in each file.
+void PPStatisticsTracker::FileChanged(
+    clang::SourceLocation Loc, clang::PPCallbacks::FileChangeReason Reason,
+    clang::SrcMgr::CharacteristicKind FileType, clang::FileID PrevFID) {
+  if (Reason != EnterFile && Reason != ExitFile)
+    return;
+  double Now = chargeSelfTime();
+  if (Reason == ExitFile) {
+    exitFile(Now);
+    return;
+  }
+  FileStatistics *File = nullptr;
+  if (isTraced(CK_FileChanged, Loc)) {
+    File = &getFileStatistics(Loc);
+    ++File->Entries;
+    // Loc is the start of the entered file.
+    clang::SourceManager &SM = PP.getSourceManager();
+    if (EnteredFiles.insert(SM.getBufferName(Loc)).second)
+      ++File->TranslationUnits;
+  }
+  FileStack.push_back(FileRegion(File, Now));
+}
+
+// Count a file skipped by the multiple-include optimization.
+void PPStatisticsTracker::FileSkipped(
+    const clang::FileEntry &SkippedFile, const clang::Token &FilenameTok,
+    clang::SrcMgr::CharacteristicKind FileType) {
+  if (isTraced(CK_FileSkipped, FilenameTok.getLocation()))
+    ++Stats.Files[SkippedFile.getName()].Skipped;
+}
+
+// Count an inclusion directive in the including file.
+void PPStatisticsTracker::InclusionDirective(
+    clang::SourceLocation HashLoc, const clang::Token &IncludeTok,
+    llvm::StringRef FileName, bool IsAngled,
+    clang::CharSourceRange FilenameRange, const clang::FileEntry *File,
+    llvm::StringRef SearchPath, llvm::StringRef RelativePath,
+    const clang::Module *Imported) {
+  if (isTraced(CK_InclusionDirective, HashLoc))
+    ++getFileStatistics(HashLoc).Includes;
+}
+
+// Close the files still open, and finish the translation unit.
+void PPStatisticsTracker::EndOfMainFile() {
+  double Now = chargeSelfTime();
+  while (!FileStack.empty())
+    exitFile(Now);
+  EnteredFiles.clear();
+  ++Stats.TranslationUnits;
+}
+
+// Count a macro expansion.
+void PPStatisticsTracker::MacroExpands(const clang::Token &MacroNameTok,
+                                       const clang::MacroDefinition &MD,
+                                       clang::SourceRange Range,
+                                       const clang::MacroArgs *Args) {
+  if (isTraced(CK_MacroExpands, MacroNameTok.getLocation()))
+    ++Stats.MacroExpansions[MacroNameTok.getIdentifierInfo()->getName()];
+}
+
+void PPStatisticsTracker::If(clang::SourceLocation Loc,
+                             clang::SourceRange ConditionRange,
+                             ConditionValueKind ConditionValue) {
+  countConditional(CK_If, Loc);
+}
+
+void PPStatisticsTracker::Elif(clang::SourceLocation Loc,
+                               clang::SourceRange ConditionRange,
+                               ConditionValueKind ConditionValue,
+                               clang::SourceLocation IfLoc) {
+  countConditional(CK_Elif, Loc);
+}
+
+void PPStatisticsTracker::Ifdef(clang::SourceLocation Loc,
+                                const clang::Token &MacroNameTok,
+                                const clang::MacroDefinition &MD) {
+  countConditional(CK_Ifdef, Loc);
+}
+
+void PPStatisticsTracker::Ifndef(clang::SourceLocation Loc,
+                                 const clang::Token &MacroNameTok,
+                                 const clang::MacroDefinition &MD) {
+  countConditional(CK_Ifndef, Loc);
+}
+
+void PPStatisticsTracker::Else(clang::SourceLocation Loc,
+                               clang::SourceLocation IfLoc) {
+  countConditional(CK_Else, Loc);
+}
+
+void PPStatisticsTracker::Endif(clang::SourceLocation Loc,
+                                clang::SourceLocation IfLoc) {
+  countConditional(CK_Endif, Loc);
+}
+
+// Helper functions.
+
+// Count a conditional directive, in total and in its file.
+void PPStatisticsTracker::countConditional(CallbackKind Kind,
+                                           clang::SourceLocation Loc) {
+  if (!isTraced(Kind, Loc))
+    return;
+  ++Stats.ConditionalCounts[Kind - CK_If];
+  ++getFileStatistics(Loc).Conditionals;
+}
+
+// Get the statistics of the file containing the location.
+FileStatistics &
+PPStatisticsTracker::getFileStatistics(clang::SourceLocation Loc) {
+  clang::SourceManager &SM = PP.getSourceManager();
+  return Stats.Files[SM.getBufferName(SM.getExpansionLoc(Loc))];
+}
+
+// Charge the time since the last file change to the current file.
+double PPStatisticsTracker::chargeSelfTime() {
+  double Now = llvm::TimeRecord::getCurrentTime(false).getWallTime();
+  if (!FileStack.empty() && FileStack.back().Stats)
+    FileStack.back().Stats->SelfTime += Now - LastChangeTime;
+  LastChangeTime = Now;
+  return Now;
+}
+
+// Leave the current file, charging its inclusive time.
+void PPStatisticsTracker::exitFile(double Now) {
+  if (FileStack.empty())
+    return;
+  FileRegion &Region = FileStack.back();
+  if (Region.Stats)
+    Region.Stats->InclusiveTime += Now - Region.EnterTime;
+  FileStack.pop_back();
+}
@@ -0,0 +1,190 @@
+//===--- PPStatistics.h - Preprocessor statistics -*- C++ -*-------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===--------------------------------------------------------------------===//
+///
+/// \file
+/// \brief Classes and definitions for aggregated preprocessor statistics.
+///
+/// Instead of a trace of every callback, the PPStatisticsTracker class
+/// counts the callbacks that matter for finding include bloat and
+/// macro-heavy headers into a PPStatistics object:
+///
+/// - the number of inclusion directives in each file,
+/// - the number of times each file is entered, the number of translation
+///   units it is entered in, and the number of times it is skipped by the
+///   multiple-include optimization, so headers entered more than once per
+///   translation unit (i.e. without include guards) stand out,
+/// - the number of expansions of each macro,
+/// - the number of conditional directives, in total and per file,
+/// - the wall time spent in each file, between the FileChanged callbacks,
+///   both excluding (self) and including the files it includes.
+///
+/// The statistics of many translation units, possibly collected on
+/// different threads, are merged, and then printed as a sorted text report
+/// or as JSON.
+///
+//===--------------------------------------------------------------------===//
+
+#ifndef PPTRACE_PPSTATISTICS_H
+#define PPTRACE_PPSTATISTICS_H
+
+#include "PPCallbacksTracker.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringSet.h"
+#include "llvm/Support/raw_ostream.h"
+#include <vector>
+
+/// \brief Statistics for one file.
+class FileStatistics {
+public:
+  FileStatistics()
+      : Includes(0), Entries(0), Skipped(0), TranslationUnits(0),
+        Conditionals(0), SelfTime(0.0), InclusiveTime(0.0) {}
+
+  /// \brief Add the statistics of the same file from other translation
+  ///   units.
+  void merge(const FileStatistics &Other);
+
+  /// \brief Number of inclusion directives in the file.
+  unsigned Includes;
+  /// \brief Number of times the file was entered.
+  unsigned Entries;
+  /// \brief Number of times the file was skipped by the multiple-include
+  ///   optimization.
+  unsigned Skipped;
+  /// \brief Number of translation units the file was entered in.
+  unsigned TranslationUnits;
+  /// \brief Number of conditional directives in the file.
+  unsigned Conditionals;
+  /// \brief Wall time in seconds spent in the file itself.
+  double SelfTime;
+  /// \brief Wall time in seconds spent in the file and the files it
+  ///   includes.
+  double InclusiveTime;
+};
+
+/// \brief Aggregated statistics for one or more translation units.
+class PPStatistics {
+public:
+  PPStatistics();
+
+  /// \brief Add the statistics of other translation units.
+  void merge(const PPStatistics &Other);
+
+  /// \brief Print a text report, with each table sorted by decreasing
+  ///   count or time.
+  /// \param OS - The output stream.
+  /// \param Limit - The maximum number of rows per table, or 0 for all.
+  void printText(llvm::raw_ostream &OS, unsigned Limit) const;
+
+  /// \brief Print all the statistics as a JSON object, with the files and
+  ///   macros sorted by name.
+  void printJSON(llvm::raw_ostream &OS) const;
+
+  /// \brief Number of translation units.
+  unsigned TranslationUnits;
+  /// \brief Number of conditional directives of each kind, indexed by
+  ///   callback kind starting at CK_If.
+  unsigned ConditionalCounts[CK_Endif - CK_If + 1];
+  /// \brief Statistics per file, keyed by file name.
+  llvm::StringMap<FileStatistics> Files;
+  /// \brief Number of expansions per macro, keyed by macro name.
+  llvm::StringMap<unsigned> MacroExpansions;
+};
+
+/// \brief This class collects PPStatistics from the preprocessor callbacks.
+///
+/// It only overrides the callbacks it counts; the filter should be limited
+/// to those with CallbackFilter::retainOnly(getStatisticsKinds()), so the
+/// other callbacks return without formatting anything for the sink.  The
+/// callbacks it counts are subject to the filter like traced ones, except
+/// that the FileChanged regions are always tracked, so the time of files
+/// that are filtered out is still excluded from the self time of the files
+/// including them.
+class PPStatisticsTracker : public PPCallbacksTracker {
+public:
+  /// \param Filter - Which callbacks to count.
+  /// \param Sink - Trace receiver for the callbacks not counted.
+  /// \param PP - The preprocessor.
+  /// \param Stats - The statistics to add to.
+  PPStatisticsTracker(CallbackFilter &Filter, PPTraceSink &Sink,
+                      clang::Preprocessor &PP, PPStatistics &Stats);
+
+  /// \brief Get the kinds of the callbacks counted.
+  static llvm::ArrayRef<CallbackKind> getStatisticsKinds();
+
+  void FileChanged(clang::SourceLocation Loc,
+                   clang::PPCallbacks::FileChangeReason Reason,
+                   clang::SrcMgr::CharacteristicKind FileType,
+                   clang::FileID PrevFID = clang::FileID()) override;
+  void FileSkipped(const clang::FileEntry &SkippedFile,
+                   const clang::Token &FilenameTok,
+                   clang::SrcMgr::CharacteristicKind FileType) override;
+  void InclusionDirective(clang::SourceLocation HashLoc,
+                          const clang::Token &IncludeTok,
+                          llvm::StringRef FileName, bool IsAngled,
+                          clang::CharSourceRange FilenameRange,
+                          const clang::FileEntry *File,
+                          llvm::StringRef SearchPath,
+                          llvm::StringRef RelativePath,
+                          const clang::Module *Imported) override;
+  void EndOfMainFile() override;
+  void MacroExpands(const clang::Token &MacroNameTok,
+                    const clang::MacroDefinition &MD, clang::SourceRange Range,
+                    const clang::MacroArgs *Args) override;
+  void If(clang::SourceLocation Loc, clang::SourceRange ConditionRange,
+          ConditionValueKind ConditionValue) override;
+  void Elif(clang::SourceLocation Loc, clang::SourceRange ConditionRange,
+            ConditionValueKind ConditionValue,
+            clang::SourceLocation IfLoc) override;
+  void Ifdef(clang::SourceLocation Loc, const clang::Token &MacroNameTok,
+             const clang::MacroDefinition &MD) override;
+  void Ifndef(clang::SourceLocation Loc, const clang::Token &MacroNameTok,
+              const clang::MacroDefinition &MD) override;
+  void Else(clang::SourceLocation Loc, clang::SourceLocation IfLoc) override;
+  void Endif(clang::SourceLocation Loc, clang::SourceLocation IfLoc) override;
+
+private:
+  /// \brief A file being preprocessed, on the include stack.
+  struct FileRegion {
+    FileRegion(FileStatistics *Stats, double EnterTime)
+        : Stats(Stats), EnterTime(EnterTime) {}
+
+    /// \brief The file's statistics, or null if it's filtered out.
+    FileStatistics *Stats;
+    /// \brief Wall time the file was entered.
+    double EnterTime;
+  };
+
+  /// \brief Count a conditional directive.
+  void countConditional(CallbackKind Kind, clang::SourceLocation Loc);
+
+  /// \brief Get the statistics of the file containing the location.
+  FileStatistics &getFileStatistics(clang::SourceLocation Loc);
+
+  /// \brief Charge the time since the last file change to the current
+  ///   file, and get the current time.
+  double chargeSelfTime();
+
+  /// \brief Leave the current file.
+  void exitFile(double Now);
+
+  /// \brief The statistics to add to.
+  PPStatistics &Stats;
+
+  /// \brief The include stack.
+  std::vector<FileRegion> FileStack;
+
+  /// \brief Wall time of the last file change.
+  double LastChangeTime;
+
+  /// \brief Files entered in this translation unit.
+  llvm::StringSet<> EnteredFiles;
+};
+
+#endif // PPTRACE_PPSTATISTICS_H
@@ -23,12 +23,28 @@
 // Basically you put the pp-trace options first, then the source file or files,
 // and then any options you want to pass to the compiler.
 //
+// It also supports converting a binary trace to another format:
+//
+//    pp-trace -convert (binary trace file) [pp-trace output options]
+//
 // These are the pp-trace options:
 //
 //    -ignore (callback list)     Don't display output for a comma-separated
 //                                list of callbacks, i.e.:
 //                                  -ignore "FileChanged,InclusionDirective"
 //
+//    -only (callback list)       Only display output for a comma-separated
+//                                list of callbacks, i.e.:
+//                                  -only "InclusionDirective"
+//
+//    -files (glob list)          Only display output for callbacks located
+//                                in files matching a comma-separated list of
+//                                globs, in which '*' matches any sequence of
+//                                characters, i.e.:
+//                                  -files "*/include/*,*.inc"
+//                                Callbacks without a location are always
+//                                displayed.
+//
 //    -output (file)              Output trace to the given file in a YAML
 //                                format, e.g.:
 //
@@ -39,14 +55,57 @@
 //                                  (etc.)
 //                                  ...
 //
-// Future Directions:
+//    -stream                     Write each callback to the output as soon
+//                                as it is made, instead of buffering the
+//                                whole trace until the compilation is done.
+//                                This keeps memory use flat on large
+//                                translation units, but a partial trace is
+//                                written if there are compilation errors.
+//
+//    -output-format (format)     Output trace in the given format:
+//                                  yaml    The YAML format above (default).
+//                                  csv     One "Index,Callback,Argument,Value"
+//                                          row per argument.
+//                                  binary  A compact binary format, with
+//                                          interned file paths and numeric
+//                                          source locations.  It is always
+//                                          streamed.  See PPTraceBinary.h.
+//
+//    -convert (file)             Convert the given binary trace to the
+//                                format given by -output-format, instead of
+//                                running the preprocessor.
 //
-// 1. Add option opposite to "-ignore" that specifys a comma-separated option
-// list of callbacs.  Perhaps "-only" or "-exclusive".
+//    -source-list (file)         Read more source file names, one per
+//                                line, from the given file.  Only one
+//                                source file can be given on the command
+//                                line, as the arguments after it are
+//                                passed to the compiler.
+//
+//    -stats                      Output aggregated statistics for all the
+//                                source files instead of a trace: inclusion
+//                                directives per file, entries per header,
+//                                expansions per macro, conditional
+//                                directives, and the time spent in each
+//                                file.  The -only, -ignore and -files
+//                                options limit what is counted.
+//
+//    -stats-format (format)      Output statistics in the given format:
+//                                  text    A report sorted by decreasing
+//                                          count or time (default).
+//                                  json    A JSON object.
+//
+//    -stats-limit (count)        Maximum number of rows per table of the
+//                                text report, or 0 for all (default 20).
+//
+//    -j (count)                  Number of source files to preprocess in
+//                                parallel with -stats.  The default of 0
+//                                uses the number of hardware threads.
 //
 //===----------------------------------------------------------------------===//
 
 #include "PPCallbacksTracker.h"
+#include "PPStatistics.h"
+#include "PPTraceBinary.h"
 #include "clang/AST/ASTConsumer.h"
 #include "clang/AST/ASTContext.h"
 #include "clang/AST/RecursiveASTVisitor.h"
@@ -65,11 +124,14 @@
 #include "llvm/Support/FileSystem.h"
 #include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/Path.h"
+#include "llvm/Support/Threading.h"
 #include "llvm/Support/ToolOutputFile.h"
 #include <algorithm>
+#include <atomic>
 #include <fstream>
 #include <iterator>
 #include <string>
+#include <thread>
 #include <vector>
 
 using namespace clang;
@@ -84,18 +146,84 @@ using namespace llvm::opt;
 // Collect the source files.
 static cl::list<std::string> SourcePaths(cl::Positional,
                                          cl::desc("<source0> [... <sourceN>]"),
-                                         cl::OneOrMore);
+                                         cl::ZeroOrMore);
 
 // Option to specify a list or one or more callback names to ignore.
 static cl::opt<std::string> IgnoreCallbacks(
     "ignore", cl::init(""),
     cl::desc("Ignore callbacks, i.e. \"Callback1, Callback2...\"."));
 
+// Option to specify a list or one or more callback names to trace.
+static cl::opt<std::string> OnlyCallbacks(
+    "only", cl::init(""),
+    cl::desc("Only trace callbacks, i.e. \"Callback1, Callback2...\"."));
+
+// Option to specify globs for the files whose callbacks are traced.
+static cl::opt<std::string> FileGlobs(
+    "files", cl::init(""),
+    cl::desc("Only trace callbacks in files matching the globs,"
+             " i.e. \"*/include/*, *.inc...\"."));
+
 // Option to specify the trace output file name.
 static cl::opt<std::string> OutputFileName(
     "output", cl::init(""),
     cl::desc("Output trace to the given file name or '-' for stdout."));
 
+// Option to write the trace as the callbacks are made.
+static cl::opt<bool> StreamTrace(
+    "stream", cl::init(false),
+    cl::desc("Write each callback as it is made, instead of buffering."));
+
+// Output formats.
+enum OutputFormatKind { OF_YAML, OF_CSV, OF_Binary };
+
+// Option to specify the trace output format.
+static cl::opt<OutputFormatKind> OutputFormat(
+    "output-format", cl::init(OF_YAML),
+    cl::desc("Output trace in the given format."),
+    cl::values(clEnumValN(OF_YAML, "yaml", "YAML (default)"),
+               clEnumValN(OF_CSV, "csv", "Comma-separated values"),
+               clEnumValN(OF_Binary, "binary", "Compact binary format"),
+               clEnumValEnd));
+
+// Option to convert a binary trace instead of running the preprocessor.
+static cl::opt<std::string> ConvertFileName(
+    "convert", cl::init(""),
+    cl::desc("Convert the given binary trace to the output format."));
+
+// Option to specify a file listing more source files.
+static cl::opt<std::string> SourceListFileName(
+    "source-list", cl::init(""),
+    cl::desc("Read more source file names, one per line, from the given"
+             " file."));
+
+// Option to output aggregated statistics instead of a trace.
+static cl::opt<bool> Statistics(
+    "stats", cl::init(false),
+    cl::desc("Output aggregated statistics instead of a trace."));
+
+// Statistics output formats.
+enum StatisticsFormatKind { SF_Text, SF_JSON };
+
+// Option to specify the statistics output format.
+static cl::opt<StatisticsFormatKind> StatisticsFormat(
+    "stats-format", cl::init(SF_Text),
+    cl::desc("Output statistics in the given format."),
+    cl::values(clEnumValN(SF_Text, "text", "Sorted text report (default)"),
+               clEnumValN(SF_JSON, "json", "JSON object"),
+               clEnumValEnd));
+
+// Option to limit the rows of the statistics report.
+static cl::opt<unsigned> StatisticsLimit(
+    "stats-limit", cl::init(20),
+    cl::desc("Maximum number of rows per statistics table, or 0 for all."));
+
+// Option to specify the number of source files preprocessed in parallel.
+static cl::opt<unsigned> Jobs(
+    "j", cl::init(0),
+    cl::desc("Number of source files to preprocess in parallel with -stats,"
+             " or 0 for the number of hardware threads."));
+
 // Collect all other arguments, which will be passed to the front end.
 static cl::list<std::string>
     CC1Arguments(cl::ConsumeAfter,
@@ -107,71 +235,242 @@ namespace {
 // Consumer is responsible for setting up the callbacks.
 class PPTraceConsumer : public ASTConsumer {
 public:
-  PPTraceConsumer(SmallSet<std::string, 4> &Ignore,
-                  std::vector<CallbackCall> &CallbackCalls, Preprocessor &PP) {
+  PPTraceConsumer(CallbackFilter &Filter, PPTraceSink &Sink,
+                  Preprocessor &PP) {
     // PP takes ownership.
-    PP.addPPCallbacks(llvm::make_unique<PPCallbacksTracker>(Ignore,
-                                                            CallbackCalls, PP));
+    PP.addPPCallbacks(llvm::make_unique<PPCallbacksTracker>(Filter, Sink, PP));
   }
 };
 
 class PPTraceAction : public SyntaxOnlyAction {
 public:
-  PPTraceAction(SmallSet<std::string, 4> &Ignore,
-                std::vector<CallbackCall> &CallbackCalls)
-      : Ignore(Ignore), CallbackCalls(CallbackCalls) {}
+  PPTraceAction(CallbackFilter &Filter, PPTraceSink &Sink)
+      : Filter(Filter), Sink(Sink) {}
 
 protected:
   std::unique_ptr<clang::ASTConsumer>
   CreateASTConsumer(CompilerInstance &CI, StringRef InFile) override {
-    return llvm::make_unique<PPTraceConsumer>(Ignore, CallbackCalls,
+    return llvm::make_unique<PPTraceConsumer>(Filter, Sink,
                                               CI.getPreprocessor());
   }
 
 private:
-  SmallSet<std::string, 4> &Ignore;
-  std::vector<CallbackCall> &CallbackCalls;
+  CallbackFilter &Filter;
+  PPTraceSink &Sink;
 };
 
 class PPTraceFrontendActionFactory : public FrontendActionFactory {
 public:
-  PPTraceFrontendActionFactory(SmallSet<std::string, 4> &Ignore,
-                               std::vector<CallbackCall> &CallbackCalls)
-      : Ignore(Ignore), CallbackCalls(CallbackCalls) {}
+  PPTraceFrontendActionFactory(CallbackFilter &Filter,
+                               PPTraceSink &Sink)
+      : Filter(Filter), Sink(Sink) {}
 
   PPTraceAction *create() override {
-    return new PPTraceAction(Ignore, CallbackCalls);
+    return new PPTraceAction(Filter, Sink);
+  }
+
+private:
+  CallbackFilter &Filter;
+  PPTraceSink &Sink;
+};
+// Action for collecting statistics.  Only the preprocessor is run.
+class PPStatisticsAction : public PreprocessOnlyAction {
+public:
+  PPStatisticsAction(CallbackFilter &Filter, PPTraceSink &Sink,
+                     PPStatistics &Stats)
+      : Filter(Filter), Sink(Sink), Stats(Stats) {}
+
+protected:
+  bool BeginSourceFileAction(CompilerInstance &CI,
+                             StringRef Filename) override {
+    if (!PreprocessOnlyAction::BeginSourceFileAction(CI, Filename))
+      return false;
+    Preprocessor &PP = CI.getPreprocessor();
+    // PP takes ownership.
+    PP.addPPCallbacks(
+        llvm::make_unique<PPStatisticsTracker>(Filter, Sink, PP, Stats));
+    return true;
+  }
+
+private:
+  CallbackFilter &Filter;
+  PPTraceSink &Sink;
+  PPStatistics &Stats;
+};
+
+class PPStatisticsFrontendActionFactory : public FrontendActionFactory {
+public:
+  PPStatisticsFrontendActionFactory(CallbackFilter &Filter,
+                                    PPStatistics &Stats)
+      : Filter(Filter), Stats(Stats) {}
+
+  PPStatisticsAction *create() override {
+    return new PPStatisticsAction(Filter, Sink, Stats);
   }
 
 private:
-  SmallSet<std::string, 4> &Ignore;
-  std::vector<CallbackCall> &CallbackCalls;
+  CallbackFilter &Filter;
+  // The callbacks not counted aren't traced.
+  NullTraceSink Sink;
+  PPStatistics &Stats;
 };
 } // namespace
 
-// Output the trace given its data structure and a stream.
-static int outputPPTrace(std::vector<CallbackCall> &CallbackCalls,
-                         llvm::raw_ostream &OS) {
-  // Mark start of document.
-  OS << "---\n";
-
-  for (std::vector<CallbackCall>::const_iterator I = CallbackCalls.begin(),
-                                                 E = CallbackCalls.end();
-       I != E; ++I) {
-    const CallbackCall &Callback = *I;
-    OS << "- Callback: " << Callback.Name << "\n";
-
-    for (std::vector<Argument>::const_iterator AI = Callback.Arguments.begin(),
-                                               AE = Callback.Arguments.end();
-         AI != AE; ++AI) {
-      const Argument &Arg = *AI;
-      OS << "  " << Arg.Name << ": " << Arg.Value << "\n";
+// Parse a comma-separated callback list into names.
+static void parseCallbackList(StringRef List,
+                              SmallVectorImpl<StringRef> &Names) {
+  SmallVector<StringRef, 32> Strings;
+  List.split(Strings, ",", /*MaxSplit=*/ -1, /*KeepEmpty=*/false);
+  for (StringRef Name : Strings) {
+    Name = Name.trim();
+    if (!Name.empty())
+      Names.push_back(Name);
+  }
+}
+
+// Create the writer for the output format.
+static std::unique_ptr<PPTraceSink> createTraceWriter(llvm::raw_ostream &OS) {
+  switch (OutputFormat) {
+  case OF_YAML:
+    break;
+  case OF_CSV:
+    return llvm::make_unique<CSVTraceWriter>(OS);
+  case OF_Binary:
+    return llvm::make_unique<BinaryTraceWriter>(OS);
+  }
+  return llvm::make_unique<YAMLTraceWriter>(OS);
+}
+
+// Determine if callbacks are written as they are made, rather than
+// buffered until the compilation is done.  The binary format is always
+// streamed, as the buffered trace doesn't keep the argument types.
+static bool isTraceStreamed() {
+  return StreamTrace || OutputFormat == OF_Binary;
+}
+
+// Run the tool, tracing to the given stream.
+static int runPPTrace(ClangTool &Tool, CallbackFilter &Filter,
+                      llvm::raw_ostream &OS) {
+  std::unique_ptr<PPTraceSink> Writer = createTraceWriter(OS);
+
+  // Write each callback as it is made.
+  if (isTraceStreamed()) {
+    Writer->beginTrace();
+    PPTraceFrontendActionFactory Factory(Filter, *Writer);
+    int HadErrors = Tool.run(&Factory);
+    Writer->endTrace();
+    return HadErrors;
+  }
+
+  // Store the callback trace information here.
+  std::vector<CallbackCall> CallbackCalls;
+  CallbackCallsSink Sink(CallbackCalls);
+  PPTraceFrontendActionFactory Factory(Filter, Sink);
+  int HadErrors = Tool.run(&Factory);
+
+  // If we had errors, exit early.
+  if (HadErrors)
+    return HadErrors;
+
+  // Do the output.
+  replayCallbackCalls(CallbackCalls, *Writer);
+  return 0;
+}
+
+// Collect statistics for all the source files, and output them to the
+// given stream.  Each worker thread preprocesses one source file at a time
+// with its own ClangTool, into its own statistics, which are merged at the
+// end.
+static int runPPStatistics(const CompilationDatabase &Compilations,
+                           ArrayRef<std::string> Sources,
+                           CallbackFilter &Filter, llvm::raw_ostream &OS) {
+  // Only the counted callbacks need to be made.
+  Filter.retainOnly(PPStatisticsTracker::getStatisticsKinds());
+
+  // Determine the number of worker threads.
+  unsigned NumSources = Sources.size();
+  unsigned NumWorkers = Jobs ? Jobs : std::thread::hardware_concurrency();
+  if (!llvm::llvm_is_multithreaded() || NumWorkers == 0)
+    NumWorkers = 1;
+  NumWorkers = std::min(NumWorkers, NumSources);
+
+  std::vector<PPStatistics> WorkerStats(NumWorkers);
+  std::atomic<unsigned> NextSource(0);
+  std::atomic<bool> HadErrors(false);
+  auto Worker = [&](unsigned WorkerIndex) {
+    PPStatisticsFrontendActionFactory Factory(Filter,
+                                              WorkerStats[WorkerIndex]);
+    for (unsigned Index = NextSource++; Index < NumSources;
+         Index = NextSource++) {
+      ClangTool Tool(Compilations, Sources[Index]);
+      if (Tool.run(&Factory))
+        HadErrors = true;
     }
+  };
+
+  if (NumWorkers == 1) {
+    Worker(0);
+  } else {
+    std::vector<std::thread> Workers;
+    for (unsigned I = 0; I < NumWorkers; ++I)
+      Workers.push_back(std::thread(Worker, I));
+    for (std::thread &T : Workers)
+      T.join();
+  }
+
+  // If we had errors, exit early.
+  if (HadErrors)
+    return 1;
+
+  // Merge and output the statistics.
+  PPStatistics Stats;
+  for (const PPStatistics &Other : WorkerStats)
+    Stats.merge(Other);
+  if (StatisticsFormat == SF_JSON)
+    Stats.printJSON(OS);
+  else
+    Stats.printText(OS, StatisticsLimit);
+  return 0;
+}
+
+// Add the source file names listed in a file, one per line.
+static bool readSourceList(StringRef ListFileName,
+                           std::vector<std::string> &Sources) {
+  ErrorOr<std::unique_ptr<MemoryBuffer>> Buffer =
+      MemoryBuffer::getFileOrSTDIN(ListFileName);
+  if (std::error_code EC = Buffer.getError()) {
+    llvm::errs() << "pp-trace: error reading " << ListFileName << ":"
+                 << EC.message() << "\n";
+    return false;
+  }
+  SmallVector<StringRef, 32> Lines;
+  Buffer.get()->getBuffer().split(Lines, "\n", /*MaxSplit=*/ -1,
+                                  /*KeepEmpty=*/false);
+  for (StringRef Line : Lines) {
+    Line = Line.trim();
+    if (!Line.empty())
+      Sources.push_back(Line);
   }
+  return true;
+}
 
-  // Mark end of document.
-  OS << "...\n";
+// Convert a binary trace to the given stream.
+static int convertPPTrace(llvm::raw_ostream &OS) {
+  ErrorOr<std::unique_ptr<MemoryBuffer>> Buffer =
+      MemoryBuffer::getFileOrSTDIN(ConvertFileName);
+  if (std::error_code EC = Buffer.getError()) {
+    llvm::errs() << "pp-trace: error reading " << ConvertFileName << ":"
+                 << EC.message() << "\n";
+    return 1;
+  }
 
+  std::unique_ptr<PPTraceSink> Writer = createTraceWriter(OS);
+  std::string ErrorMessage;
+  if (!readBinaryTrace(Buffer.get()->getBuffer(), *Writer, ErrorMessage)) {
+    llvm::errs() << "pp-trace: error reading " << ConvertFileName << ":"
+                 << ErrorMessage << "\n";
+    return 1;
+  }
   return 0;
 }
 
@@ -181,15 +480,38 @@ int main(int Argc, const char **Argv) {
   // Parse command line.
   cl::ParseCommandLineOptions(Argc, Argv, "pp-trace.\n");
 
-  // Parse the IgnoreCallbacks list into strings.
+  // Collect the source files.
+  std::vector<std::string> Sources(SourcePaths.begin(), SourcePaths.end());
+  if (!SourceListFileName.empty() &&
+      !readSourceList(SourceListFileName, Sources))
+    return 1;
+
+  // We need either sources or a trace to convert.
+  bool Converting = !ConvertFileName.empty();
+  if (Converting == !Sources.empty()) {
+    llvm::errs() << "pp-trace: specify either source files or -convert\n";
+    return 1;
+  }
+
+  // Compile the callback filter options.
+  CallbackFilter Filter;
+  std::string ErrorMessage;
+  if (!OnlyCallbacks.empty()) {
+    SmallVector<StringRef, 32> OnlyCallbacksStrings;
+    parseCallbackList(OnlyCallbacks, OnlyCallbacksStrings);
+    if (!Filter.setOnly(OnlyCallbacksStrings, ErrorMessage)) {
+      llvm::errs() << "pp-trace: -only: " << ErrorMessage << "\n";
+      return 1;
+    }
+  }
   SmallVector<StringRef, 32> IgnoreCallbacksStrings;
-  StringRef(IgnoreCallbacks).split(IgnoreCallbacksStrings, ",",
-                                   /*MaxSplit=*/ -1, /*KeepEmpty=*/false);
-  SmallSet<std::string, 4> Ignore;
-  for (SmallVector<StringRef, 32>::iterator I = IgnoreCallbacksStrings.begin(),
-                                            E = IgnoreCallbacksStrings.end();
-       I != E; ++I)
-    Ignore.insert(*I);
+  parseCallbackList(IgnoreCallbacks, IgnoreCallbacksStrings);
+  if (!Filter.setIgnore(IgnoreCallbacksStrings, ErrorMessage)) {
+    llvm::errs() << "pp-trace: -ignore: " << ErrorMessage << "\n";
+    return 1;
+  }
+  if (!FileGlobs.empty())
+    Filter.setFileGlobs(FileGlobs);
 
   // Create the compilation database.
   SmallString<256> PathBuf;
@@ -198,37 +520,43 @@ int main(int Argc, const char **Argv) {
   Compilations.reset(
       new FixedCompilationDatabase(Twine(PathBuf), CC1Arguments));
 
-  // Store the callback trace information here.
-  std::vector<CallbackCall> CallbackCalls;
-
-  // Create the tool and run the compilation.
-  ClangTool Tool(*Compilations, SourcePaths);
-  PPTraceFrontendActionFactory Factory(Ignore, CallbackCalls);
-  int HadErrors = Tool.run(&Factory);
-
-  // If we had errors, exit early.
-  if (HadErrors)
-    return HadErrors;
+  // Create the tool.
+  ClangTool Tool(*Compilations, Sources);
 
   // Do the output.
   if (!OutputFileName.size()) {
-    HadErrors = outputPPTrace(CallbackCalls, llvm::outs());
-  } else {
-    // Set up output file.
-    std::error_code EC;
-    llvm::tool_output_file Out(OutputFileName, EC, llvm::sys::fs::F_Text);
-    if (EC) {
-      llvm::errs() << "pp-trace: error creating " << OutputFileName << ":"
-                   << EC.message() << "\n";
-      return 1;
-    }
-
-    HadErrors = outputPPTrace(CallbackCalls, Out.os());
+    if (Converting)
+      return convertPPTrace(llvm::outs());
+    if (Statistics)
+      return runPPStatistics(*Compilations, Sources, Filter, llvm::outs());
+    return runPPTrace(Tool, Filter, llvm::outs());
+  }
 
-    // Tell tool_output_file that we want to keep the file.
-    if (HadErrors == 0)
-      Out.keep();
+  // Set up output file.
+  std::error_code EC;
+  llvm::tool_output_file Out(OutputFileName, EC,
+                             OutputFormat == OF_Binary && !Statistics
+                                 ? llvm::sys::fs::F_None
+                                 : llvm::sys::fs::F_Text);
+  if (EC) {
+    llvm::errs() << "pp-trace: error creating " << OutputFileName << ":"
+                 << EC.message() << "\n";
+    return 1;
   }
 
+  int HadErrors;
+  if (Converting)
+    HadErrors = convertPPTrace(Out.os());
+  else if (Statistics)
+    HadErrors = runPPStatistics(*Compilations, Sources, Filter, Out.os());
+  else
+    HadErrors = runPPTrace(Tool, Filter, Out.os());
+
+  // Tell tool_output_file that we want to keep the file.  A streamed trace
+  // is kept even if there were compilation errors, as it holds the
+  // callbacks made up to the errors.
+  if (HadErrors == 0 || (!Converting && !Statistics && isTraceStreamed()))
+    Out.keep();
+
   return HadErrors;
 }
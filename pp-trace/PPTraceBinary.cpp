@@ -0,0 +1,342 @@
+//===--- PPTraceBinary.cpp - Binary preprocessor trace -*--*-------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===--------------------------------------------------------------------===//
+///
+/// \file
+/// \brief Implementations for the compact binary trace format.
+///
+/// See the header for details.
+///
+//===--------------------------------------------------------------------===//
+
+#include "PPTraceBinary.h"
+#include "llvm/Support/LEB128.h"
+#include <vector>
+
+const char BinaryTraceMagic[8] = {'P', 'P', 'T', 'R', 'A', 'C', 'E', '1'};
+
+// BinaryTraceWriter functions.
+
+// Write the magic string.
+void BinaryTraceWriter::beginTrace() {
+  OS.write(BinaryTraceMagic, sizeof(BinaryTraceMagic));
+}
+
+// Write the end record.
+void BinaryTraceWriter::endTrace() { OS << char(RK_End); }
+
+// Write a callback record.
+void BinaryTraceWriter::beginCallback(llvm::StringRef Name) {
+  unsigned NameIndex = intern(Name);
+  OS << char(RK_Callback);
+  llvm::encodeULEB128(NameIndex, OS);
+}
+
+// Write a string argument record.
+void BinaryTraceWriter::appendArgument(llvm::StringRef Name,
+                                       llvm::StringRef Value) {
+  writeArgumentHeader(Name, AK_String);
+  llvm::encodeULEB128(Value.size(), OS);
+  OS << Value;
+}
+
+// Write a bool argument record.
+void BinaryTraceWriter::appendBoolArgument(llvm::StringRef Name, bool Value) {
+  writeArgumentHeader(Name, AK_Bool);
+  OS << char(Value);
+}
+
+// Write an int argument record.
+void BinaryTraceWriter::appendIntArgument(llvm::StringRef Name, int Value) {
+  writeArgumentHeader(Name, AK_Int);
+  llvm::encodeSLEB128(Value, OS);
+}
+
+// Write an enum argument record.
+void BinaryTraceWriter::appendEnumArgument(llvm::StringRef Name,
+                                           llvm::StringRef Value) {
+  unsigned ValueIndex = intern(Value);
+  writeArgumentHeader(Name, AK_Enum);
+  llvm::encodeULEB128(ValueIndex, OS);
+}
+
+// Write a file path argument record.
+void BinaryTraceWriter::appendFilePathArgument(llvm::StringRef Name,
+                                               llvm::StringRef Path) {
+  unsigned PathIndex = intern(Path);
+  writeArgumentHeader(Name, AK_FilePath);
+  llvm::encodeULEB128(PathIndex, OS);
+}
+
+// Write a source location argument record.
+void BinaryTraceWriter::appendLocationArgument(llvm::StringRef Name,
+                                               const TraceLocation &Loc) {
+  // Intern the file name before starting the record.
+  if (Loc.Kind == TraceLocation::LK_File)
+    intern(Loc.FileName);
+  writeArgumentHeader(Name, AK_Location);
+  writeLocation(Loc);
+}
+
+// Write a source range argument record.
+void BinaryTraceWriter::appendRangeArgument(llvm::StringRef Name,
+                                            const TraceLocation &Begin,
+                                            const TraceLocation &End) {
+  // Intern the file names before starting the record.
+  if (Begin.Kind == TraceLocation::LK_File)
+    intern(Begin.FileName);
+  if (End.Kind == TraceLocation::LK_File)
+    intern(End.FileName);
+  writeArgumentHeader(Name, AK_Range);
+  writeLocation(Begin);
+  writeLocation(End);
+}
+
+// Get the index of an interned string, writing its definition if needed.
+unsigned BinaryTraceWriter::intern(llvm::StringRef Str) {
+  auto Inserted = Strings.insert(std::make_pair(Str, Strings.size()));
+  if (Inserted.second) {
+    OS << char(RK_String);
+    llvm::encodeULEB128(Str.size(), OS);
+    OS << Str;
+  }
+  return Inserted.first->second;
+}
+
+// Write the start of an argument record.
+void BinaryTraceWriter::writeArgumentHeader(llvm::StringRef Name,
+                                            ArgumentKind Kind) {
+  unsigned NameIndex = intern(Name);
+  OS << char(RK_Argument);
+  llvm::encodeULEB128(NameIndex, OS);
+  OS << char(Kind);
+}
+
+// Write a location.  The file name must already be interned.
+void BinaryTraceWriter::writeLocation(const TraceLocation &Loc) {
+  OS << char(Loc.Kind);
+  if (Loc.Kind != TraceLocation::LK_File)
+    return;
+  llvm::encodeULEB128(Strings.find(Loc.FileName)->second, OS);
+  llvm::encodeULEB128(Loc.Line, OS);
+  llvm::encodeULEB128(Loc.Column, OS);
+}
+
+// Binary trace reader.
+
+namespace {
+class BinaryTraceReader {
+public:
+  BinaryTraceReader(llvm::StringRef Data, PPTraceSink &Sink,
+                    std::string &ErrorMessage)
+      : Data(Data), Sink(Sink), ErrorMessage(ErrorMessage), Pos(0) {}
+
+  // Read the whole trace.
+  bool read() {
+    llvm::StringRef Magic(BinaryTraceMagic, sizeof(BinaryTraceMagic));
+    if (!Data.startswith(Magic))
+      return error("not a binary pp-trace file");
+    Pos = Magic.size();
+    Sink.beginTrace();
+    bool InCallback = false;
+    for (;;) {
+      uint8_t Kind;
+      if (!readByte(Kind))
+        return false;
+      switch (Kind) {
+      case BinaryTraceWriter::RK_String: {
+        llvm::StringRef Str;
+        if (!readString(Str))
+          return false;
+        Strings.push_back(Str);
+        break;
+      }
+      case BinaryTraceWriter::RK_Callback: {
+        llvm::StringRef Name;
+        if (!readInterned(Name))
+          return false;
+        Sink.beginCallback(Name);
+        InCallback = true;
+        break;
+      }
+      case BinaryTraceWriter::RK_Argument:
+        if (!InCallback)
+          return error("argument outside of a callback");
+        if (!readArgument())
+          return false;
+        break;
+      case BinaryTraceWriter::RK_End:
+        Sink.endTrace();
+        return true;
+      default:
+        return error("unknown record kind");
+      }
+    }
+  }
+
+private:
+  // Read an argument record, after its kind.
+  bool readArgument() {
+    llvm::StringRef Name;
+    uint8_t Kind;
+    if (!readInterned(Name) || !readByte(Kind))
+      return false;
+    switch (Kind) {
+    case BinaryTraceWriter::AK_String: {
+      llvm::StringRef Value;
+      if (!readString(Value))
+        return false;
+      Sink.appendArgument(Name, Value);
+      return true;
+    }
+    case BinaryTraceWriter::AK_Bool: {
+      uint8_t Value;
+      if (!readByte(Value))
+        return false;
+      Sink.appendBoolArgument(Name, Value != 0);
+      return true;
+    }
+    case BinaryTraceWriter::AK_Int: {
+      int64_t Value;
+      if (!readSLEB(Value))
+        return false;
+      Sink.appendIntArgument(Name, int(Value));
+      return true;
+    }
+    case BinaryTraceWriter::AK_Enum: {
+      llvm::StringRef Value;
+      if (!readInterned(Value))
+        return false;
+      Sink.appendEnumArgument(Name, Value);
+      return true;
+    }
+    case BinaryTraceWriter::AK_FilePath: {
+      llvm::StringRef Path;
+      if (!readInterned(Path))
+        return false;
+      Sink.appendFilePathArgument(Name, Path);
+      return true;
+    }
+    case BinaryTraceWriter::AK_Location: {
+      TraceLocation Loc;
+      if (!readLocation(Loc))
+        return false;
+      Sink.appendLocationArgument(Name, Loc);
+      return true;
+    }
+    case BinaryTraceWriter::AK_Range: {
+      TraceLocation Begin, End;
+      if (!readLocation(Begin) || !readLocation(End))
+        return false;
+      Sink.appendRangeArgument(Name, Begin, End);
+      return true;
+    }
+    default:
+      return error("unknown argument kind");
+    }
+  }
+
+  // Read a location.
+  bool readLocation(TraceLocation &Loc) {
+    uint8_t Kind;
+    if (!readByte(Kind))
+      return false;
+    if (Kind > TraceLocation::LK_File)
+      return error("unknown location kind");
+    Loc = TraceLocation(TraceLocation::LocationKind(Kind));
+    if (Kind != TraceLocation::LK_File)
+      return true;
+    uint64_t Line, Column;
+    if (!readInterned(Loc.FileName) || !readULEB(Line) || !readULEB(Column))
+      return false;
+    Loc.Line = Line;
+    Loc.Column = Column;
+    return true;
+  }
+
+  // Read an interned string reference.
+  bool readInterned(llvm::StringRef &Str) {
+    uint64_t Index;
+    if (!readULEB(Index))
+      return false;
+    if (Index >= Strings.size())
+      return error("undefined string index");
+    Str = Strings[Index];
+    return true;
+  }
+
+  // Read a length-prefixed string.
+  bool readString(llvm::StringRef &Str) {
+    uint64_t Length;
+    if (!readULEB(Length))
+      return false;
+    if (Length > Data.size() - Pos)
+      return error("unexpected end of file");
+    Str = Data.substr(Pos, Length);
+    Pos += Length;
+    return true;
+  }
+
+  bool readByte(uint8_t &Byte) {
+    if (Pos >= Data.size())
+      return error("unexpected end of file");
+    Byte = Data[Pos++];
+    return true;
+  }
+
+  bool readULEB(uint64_t &Value) {
+    Value = 0;
+    unsigned Shift = 0;
+    uint8_t Byte;
+    do {
+      if (!readByte(Byte))
+        return false;
+      if (Shift >= 64)
+        return error("malformed number");
+      Value |= uint64_t(Byte & 0x7f) << Shift;
+      Shift += 7;
+    } while (Byte & 0x80);
+    return true;
+  }
+
+  bool readSLEB(int64_t &Value) {
+    Value = 0;
+    unsigned Shift = 0;
+    uint8_t Byte;
+    do {
+      if (!readByte(Byte))
+        return false;
+      if (Shift >= 64)
+        return error("malformed number");
+      Value |= int64_t(Byte & 0x7f) << Shift;
+      Shift += 7;
+    } while (Byte & 0x80);
+    // Sign extend negative numbers.
+    if ((Byte & 0x40) && Shift < 64)
+      Value |= -1ULL << Shift;
+    return true;
+  }
+
+  bool error(const char *Message) {
+    ErrorMessage = Message;
+    return false;
+  }
+
+  llvm::StringRef Data;
+  PPTraceSink &Sink;
+  std::string &ErrorMessage;
+  size_t Pos;
+  std::vector<llvm::StringRef> Strings;
+};
+} // namespace
+
+// Read a binary trace, replaying it into a sink.
+bool readBinaryTrace(llvm::StringRef Data, PPTraceSink &Sink,
+                     std::string &ErrorMessage) {
+  return BinaryTraceReader(Data, Sink, ErrorMessage).read();
+}
@@ -0,0 +1,111 @@
+//===--- PPTraceBinary.h - Binary preprocessor trace -*- C++ -*----------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===--------------------------------------------------------------------===//
+///
+/// \file
+/// \brief Classes and definitions for the compact binary trace format.
+///
+/// The binary trace is a magic string followed by a sequence of records,
+/// each starting with a RecordKind byte.  Numbers are ULEB128 encoded,
+/// except for int arguments, which are SLEB128 encoded.
+///
+/// Callback names, argument names, enum values and file paths are interned:
+/// the first time one is used, an RK_String record defines it, and it is
+/// referred to by its index from then on.  Source locations are encoded as a
+/// LocationKind byte, followed, for file locations, by the interned file
+/// path and the line and column numbers.
+///
+/// A binary trace can be converted back to the YAML or CSV trace by
+/// replaying it into the corresponding PPTraceSink with readBinaryTrace.
+///
+//===--------------------------------------------------------------------===//
+
+#ifndef PPTRACE_PPTRACEBINARY_H
+#define PPTRACE_PPTRACEBINARY_H
+
+#include "PPTraceSink.h"
+#include "llvm/ADT/StringMap.h"
+
+/// \brief Magic string at the start of a binary trace.
+extern const char BinaryTraceMagic[8];
+
+/// \brief Sink for writing the trace to a stream in the binary format
+///   as the callbacks are made.
+class BinaryTraceWriter : public PPTraceSink {
+public:
+  /// \brief Kinds of records.
+  enum RecordKind {
+    /// \brief Define the next interned string: length, bytes.
+    RK_String = 1,
+    /// \brief Start a callback: name string index.
+    RK_Callback,
+    /// \brief Append an argument: name string index, ArgumentKind, value.
+    RK_Argument,
+    /// \brief End of trace.
+    RK_End
+  };
+
+  /// \brief Kinds of argument values.
+  enum ArgumentKind {
+    /// \brief Any other string: length, bytes.
+    AK_String = 1,
+    /// \brief A bool: one byte.
+    AK_Bool,
+    /// \brief An int: SLEB128 value.
+    AK_Int,
+    /// \brief An enum: value name string index.
+    AK_Enum,
+    /// \brief A file path: path string index.
+    AK_FilePath,
+    /// \brief A source location: location.
+    AK_Location,
+    /// \brief A source range: begin and end locations.
+    AK_Range
+  };
+
+  BinaryTraceWriter(llvm::raw_ostream &OS) : OS(OS) {}
+
+  void beginTrace() override;
+  void endTrace() override;
+  void beginCallback(llvm::StringRef Name) override;
+  void appendArgument(llvm::StringRef Name, llvm::StringRef Value) override;
+  void appendBoolArgument(llvm::StringRef Name, bool Value) override;
+  void appendIntArgument(llvm::StringRef Name, int Value) override;
+  void appendEnumArgument(llvm::StringRef Name, llvm::StringRef Value) override;
+  void appendFilePathArgument(llvm::StringRef Name,
+                              llvm::StringRef Path) override;
+  void appendLocationArgument(llvm::StringRef Name,
+                              const TraceLocation &Loc) override;
+  void appendRangeArgument(llvm::StringRef Name, const TraceLocation &Begin,
+                           const TraceLocation &End) override;
+
+private:
+  /// \brief Get the index of an interned string, defining it if needed.
+  unsigned intern(llvm::StringRef Str);
+
+  /// \brief Write the start of an argument record.
+  void writeArgumentHeader(llvm::StringRef Name, ArgumentKind Kind);
+
+  /// \brief Write a location.
+  void writeLocation(const TraceLocation &Loc);
+
+  llvm::raw_ostream &OS;
+  /// \brief Interned string indexes.
+  llvm::StringMap<unsigned> Strings;
+};
+
+/// \brief Read a binary trace, replaying it into a sink.
+/// \param Data The binary trace.
+/// \param Sink The sink to replay the trace into.
+/// \param ErrorMessage Set to a description of the problem if the trace
+///   is malformed.
+/// \returns True if the trace was read successfully.
+bool readBinaryTrace(llvm::StringRef Data, PPTraceSink &Sink,
+                     std::string &ErrorMessage);
+
+#endif // PPTRACE_PPTRACEBINARY_H
@@ -0,0 +1,199 @@
+//===--- PPTraceSink.cpp - Preprocessor trace output -*--*---------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===--------------------------------------------------------------------===//
+///
+/// \file
+/// \brief Implementations for receiving the preprocessor trace.
+///
+/// See the header for details.
+///
+//===--------------------------------------------------------------------===//
+
+#include "PPTraceSink.h"
+#include "llvm/ADT/SmallString.h"
+#include <algorithm>
+
+// TraceLocation functions.
+
+// Print a "file:line:column" source location string.
+void TraceLocation::print(llvm::raw_ostream &OS) const {
+  switch (Kind) {
+  case LK_None:
+    OS << "(none)";
+    return;
+  case LK_NonFile:
+    OS << "(nonfile)";
+    return;
+  case LK_Invalid:
+    OS << "(invalid)";
+    return;
+  case LK_File:
+    break;
+  }
+  // YAML treats backslash as escape, so use forward slashes.
+  OS << "\"";
+  for (char C : FileName)
+    OS << (C == '\\' ? '/' : C);
+  OS << ':' << Line << ':' << Column << "\"";
+}
+
+// PPTraceSink functions.
+
+PPTraceSink::~PPTraceSink() {}
+
+// Append a bool argument to the current callback.
+void PPTraceSink::appendBoolArgument(llvm::StringRef Name, bool Value) {
+  appendArgument(Name, (Value ? "true" : "false"));
+}
+
+// Append an int argument to the current callback.
+void PPTraceSink::appendIntArgument(llvm::StringRef Name, int Value) {
+  llvm::SmallString<16> Str;
+  llvm::raw_svector_ostream SS(Str);
+  SS << Value;
+  appendArgument(Name, SS.str());
+}
+
+// Append an enum argument to the current callback.
+void PPTraceSink::appendEnumArgument(llvm::StringRef Name,
+                                     llvm::StringRef Value) {
+  appendArgument(Name, Value);
+}
+
+// Append a double-quoted file path argument to the current callback.
+void PPTraceSink::appendFilePathArgument(llvm::StringRef Name,
+                                         llvm::StringRef Path) {
+  llvm::SmallString<256> Str;
+  Str.push_back('"');
+  Str.append(Path.begin(), Path.end());
+  Str.push_back('"');
+  // YAML treats backslash as escape, so use forward slashes.
+  std::replace(Str.begin(), Str.end(), '\\', '/');
+  appendArgument(Name, Str.str());
+}
+
+// Append a source location argument to the current callback.
+void PPTraceSink::appendLocationArgument(llvm::StringRef Name,
+                                         const TraceLocation &Loc) {
+  llvm::SmallString<256> Str;
+  llvm::raw_svector_ostream SS(Str);
+  Loc.print(SS);
+  appendArgument(Name, SS.str());
+}
+
+// Append a source range argument to the current callback.
+void PPTraceSink::appendRangeArgument(llvm::StringRef Name,
+                                      const TraceLocation &Begin,
+                                      const TraceLocation &End) {
+  llvm::SmallString<256> Str;
+  llvm::raw_svector_ostream SS(Str);
+  SS << "[";
+  Begin.print(SS);
+  SS << ", ";
+  End.print(SS);
+  SS << "]";
+  appendArgument(Name, SS.str());
+}
+
+// CallbackCallsSink functions.
+
+// Start a new callback.
+void CallbackCallsSink::beginCallback(llvm::StringRef Name) {
+  CallbackCalls.push_back(CallbackCall(Name));
+}
+
+// Append an argument to the current callback.
+void CallbackCallsSink::appendArgument(llvm::StringRef Name,
+                                       llvm::StringRef Value) {
+  CallbackCalls.back().Arguments.push_back(Argument(Name, Value));
+}
+
+// YAMLTraceWriter functions.
+
+// Mark start of document.
+void YAMLTraceWriter::beginTrace() { OS << "---\n"; }
+
+// Mark end of document.
+void YAMLTraceWriter::endTrace() { OS << "...\n"; }
+
+// Write the callback name.
+void YAMLTraceWriter::beginCallback(llvm::StringRef Name) {
+  OS << "- Callback: " << Name << "\n";
+}
+
+// Write one argument of the current callback.
+void YAMLTraceWriter::appendArgument(llvm::StringRef Name,
+                                     llvm::StringRef Value) {
+  OS << "  " << Name << ": " << Value << "\n";
+}
+
+// CSVTraceWriter functions.
+
+// Write the header row.
+void CSVTraceWriter::beginTrace() { OS << "Index,Callback,Argument,Value\n"; }
+
+// Finish the last callback.
+void CSVTraceWriter::endTrace() { finishCallback(); }
+
+// Start the rows of a new callback.
+void CSVTraceWriter::beginCallback(llvm::StringRef Name) {
+  finishCallback();
+  ++CallbackIndex;
+  CallbackName = Name;
+  HasArguments = false;
+}
+
+// Write the row for one argument of the current callback.
+void CSVTraceWriter::appendArgument(llvm::StringRef Name,
+                                    llvm::StringRef Value) {
+  OS << CallbackIndex << ",";
+  writeField(CallbackName);
+  OS << ",";
+  writeField(Name);
+  OS << ",";
+  writeField(Value);
+  OS << "\n";
+  HasArguments = true;
+}
+
+// Write the row of a callback without arguments.
+void CSVTraceWriter::finishCallback() {
+  if (HasArguments)
+    return;
+  OS << CallbackIndex << ",";
+  writeField(CallbackName);
+  OS << ",,\n";
+  HasArguments = true;
+}
+
+// Write a field, quoting it if it contains a separator, quote or newline.
+void CSVTraceWriter::writeField(llvm::StringRef Field) {
+  if (Field.find_first_of(",\"\r\n") == llvm::StringRef::npos) {
+    OS << Field;
+    return;
+  }
+  OS << '"';
+  for (char C : Field) {
+    if (C == '"')
+      OS << '"';
+    OS << C;
+  }
+  OS << '"';
+}
+
+// Replay a buffered trace into a sink.
+void replayCallbackCalls(const std::vector<CallbackCall> &CallbackCalls,
+                         PPTraceSink &Sink) {
+  Sink.beginTrace();
+  for (const CallbackCall &Callback : CallbackCalls) {
+    Sink.beginCallback(Callback.Name);
+    for (const Argument &Arg : Callback.Arguments)
+      Sink.appendArgument(Arg.Name, Arg.Value);
+  }
+  Sink.endTrace();
+}
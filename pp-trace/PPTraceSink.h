@@ -0,0 +1,209 @@
+//===--- PPTraceSink.h - Preprocessor trace output -*- C++ -*------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===--------------------------------------------------------------------===//
+///
+/// \file
+/// \brief Classes and definitions for receiving the preprocessor trace.
+///
+/// The PPCallbacksTracker class hands each callback call and its arguments
+/// to a PPTraceSink object as soon as the callback is made.  The sink
+/// either buffers the trace in a data structure built up of CallbackCall
+/// and Argument objects for later inspection (CallbackCallsSink), or
+/// writes it out immediately (YAMLTraceWriter, CSVTraceWriter, and
+/// BinaryTraceWriter in PPTraceBinary.h).
+///
+/// Arguments with a structure that a compact format can take advantage of,
+/// such as source locations and file paths, are passed through typed
+/// functions.  By default these format the argument as a string and pass
+/// it to appendArgument.
+///
+//===--------------------------------------------------------------------===//
+
+#ifndef PPTRACE_PPTRACESINK_H
+#define PPTRACE_PPTRACESINK_H
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/raw_ostream.h"
+#include <string>
+#include <vector>
+
+/// \brief This class represents one callback function argument by name
+///   and value.
+class Argument {
+public:
+  Argument(llvm::StringRef Name, llvm::StringRef Value)
+      : Name(Name), Value(Value) {}
+  Argument() {}
+
+  std::string Name;
+  std::string Value;
+};
+
+/// \brief This class represents one callback call by name and an array
+///   of arguments.
+class CallbackCall {
+public:
+  CallbackCall(llvm::StringRef Name) : Name(Name) {}
+  CallbackCall() {}
+
+  std::string Name;
+  std::vector<Argument> Arguments;
+};
+
+/// \brief This class represents a source location argument in a
+///   preprocessor independent form.
+class TraceLocation {
+public:
+  /// \brief What kind of location this is.
+  enum LocationKind {
+    /// \brief No location, i.e. an invalid SourceLocation.
+    LK_None,
+    /// \brief A location that isn't a file location, i.e. a macro location.
+    LK_NonFile,
+    /// \brief A file location that doesn't have a valid presumed location.
+    LK_Invalid,
+    /// \brief A "file:line:column" location.
+    LK_File
+  };
+
+  TraceLocation(LocationKind Kind = LK_None)
+      : Kind(Kind), Line(0), Column(0) {}
+  TraceLocation(llvm::StringRef FileName, unsigned Line, unsigned Column)
+      : Kind(LK_File), FileName(FileName), Line(Line), Column(Column) {}
+
+  /// \brief Print in the form used in the YAML trace, i.e. a double-quoted
+  ///   "file:line:column" string, or "(none)", "(nonfile)" or "(invalid)".
+  void print(llvm::raw_ostream &OS) const;
+
+  LocationKind Kind;
+  llvm::StringRef FileName;
+  unsigned Line;
+  unsigned Column;
+};
+
+/// \brief Interface for receiving the trace of callback calls.
+///
+/// The string arguments are only valid for the duration of the call,
+/// so a sink that keeps them must copy them.
+class PPTraceSink {
+public:
+  virtual ~PPTraceSink();
+
+  /// \brief Called once before any callbacks are traced.
+  virtual void beginTrace() {}
+
+  /// \brief Called once after all callbacks have been traced.
+  virtual void endTrace() {}
+
+  /// \brief Start a new callback.
+  virtual void beginCallback(llvm::StringRef Name) = 0;
+
+  /// \brief Append an argument to the current callback.
+  virtual void appendArgument(llvm::StringRef Name, llvm::StringRef Value) = 0;
+
+  /// \brief Append a bool argument to the current callback.
+  virtual void appendBoolArgument(llvm::StringRef Name, bool Value);
+
+  /// \brief Append an int argument to the current callback.
+  virtual void appendIntArgument(llvm::StringRef Name, int Value);
+
+  /// \brief Append an enum argument to the current callback, by the
+  ///   name of its value.
+  virtual void appendEnumArgument(llvm::StringRef Name, llvm::StringRef Value);
+
+  /// \brief Append a file path argument to the current callback.
+  virtual void appendFilePathArgument(llvm::StringRef Name,
+                                      llvm::StringRef Path);
+
+  /// \brief Append a source location argument to the current callback.
+  virtual void appendLocationArgument(llvm::StringRef Name,
+                                      const TraceLocation &Loc);
+
+  /// \brief Append a source range argument to the current callback.
+  virtual void appendRangeArgument(llvm::StringRef Name,
+                                   const TraceLocation &Begin,
+                                   const TraceLocation &End);
+};
+
+/// \brief Sink for buffering the trace in a vector of CallbackCall objects.
+///
+/// The vector is a reference so the trace can exist beyond the lifetime
+/// of the preprocessor run.
+class CallbackCallsSink : public PPTraceSink {
+public:
+  CallbackCallsSink(std::vector<CallbackCall> &CallbackCalls)
+      : CallbackCalls(CallbackCalls) {}
+
+  void beginCallback(llvm::StringRef Name) override;
+  void appendArgument(llvm::StringRef Name, llvm::StringRef Value) override;
+
+private:
+  std::vector<CallbackCall> &CallbackCalls;
+};
+
+/// \brief Sink that discards the trace, for trackers that only look at
+///   the callbacks themselves.
+class NullTraceSink : public PPTraceSink {
+public:
+  void beginCallback(llvm::StringRef Name) override {}
+  void appendArgument(llvm::StringRef Name, llvm::StringRef Value) override {}
+};
+
+/// \brief Sink for writing the trace to a stream in a YAML format
+///   as the callbacks are made.
+class YAMLTraceWriter : public PPTraceSink {
+public:
+  YAMLTraceWriter(llvm::raw_ostream &OS) : OS(OS) {}
+
+  void beginTrace() override;
+  void endTrace() override;
+  void beginCallback(llvm::StringRef Name) override;
+  void appendArgument(llvm::StringRef Name, llvm::StringRef Value) override;
+
+private:
+  llvm::raw_ostream &OS;
+};
+
+/// \brief Sink for writing the trace to a stream in a CSV format
+///   as the callbacks are made.
+///
+/// There is one "Index,Callback,Argument,Value" row per argument, or
+/// one row with empty argument and value for a callback without
+/// arguments.
+class CSVTraceWriter : public PPTraceSink {
+public:
+  CSVTraceWriter(llvm::raw_ostream &OS)
+      : OS(OS), CallbackIndex(0), HasArguments(true) {}
+
+  void beginTrace() override;
+  void endTrace() override;
+  void beginCallback(llvm::StringRef Name) override;
+  void appendArgument(llvm::StringRef Name, llvm::StringRef Value) override;
+
+private:
+  /// \brief Finish the row of a callback without arguments.
+  void finishCallback();
+
+  /// \brief Write a field, quoting it if needed.
+  void writeField(llvm::StringRef Field);
+
+  llvm::raw_ostream &OS;
+  /// \brief Index of the current callback, starting at 1.
+  unsigned CallbackIndex;
+  /// \brief Name of the current callback.
+  std::string CallbackName;
+  /// \brief Set once an argument row has been written for the current
+  ///   callback.
+  bool HasArguments;
+};
+
+/// \brief Replay a buffered trace into a sink.
+void replayCallbackCalls(const std::vector<CallbackCall> &CallbackCalls,
+                         PPTraceSink &Sink);
+
+#endif // PPTRACE_PPTRACESINK_H
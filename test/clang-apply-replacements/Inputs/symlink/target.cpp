@@ -0,0 +1,2 @@
+int z = 0;
+// CHECK: {{^long z = 0;$}}
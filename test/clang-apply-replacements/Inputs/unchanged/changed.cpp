@@ -0,0 +1,2 @@
+int y = 0;
+// CHECK: {{^long y = 0;$}}
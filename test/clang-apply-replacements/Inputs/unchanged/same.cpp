@@ -0,0 +1,2 @@
+int x = 0;
+// CHECK: {{^int x = 0;$}}
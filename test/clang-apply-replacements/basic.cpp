@@ -2,7 +2,10 @@
 // RUN: grep -Ev "// *[A-Z-]+:" %S/Inputs/basic/basic.h > %T/Inputs/basic/basic.h
 // RUN: sed "s#\$(path)#%/T/Inputs/basic#" %S/Inputs/basic/file1.yaml > %T/Inputs/basic/file1.yaml
 // RUN: sed "s#\$(path)#%/T/Inputs/basic#" %S/Inputs/basic/file2.yaml > %T/Inputs/basic/file2.yaml
-// RUN: clang-apply-replacements %T/Inputs/basic
+//
+// file1.yaml and file2.yaml hold the same replacement for basic.h, with
+// different spellings of its path. Only one copy is kept when loading them.
+// RUN: clang-apply-replacements -summary %T/Inputs/basic | FileCheck %s --check-prefix=SUMMARY
 // RUN: FileCheck -input-file=%T/Inputs/basic/basic.h %S/Inputs/basic/basic.h
 //
 // Check that the yaml files are *not* deleted after running clang-apply-replacements without remove-change-desc-files.
@@ -13,5 +16,7 @@
 // RUN: clang-apply-replacements -remove-change-desc-files %T/Inputs/basic
 // RUN: ls -1 %T/Inputs/basic | FileCheck %s --check-prefix=NO_YAML
 //
+// SUMMARY: Replacements read: 5 - Unique: 4 - Ratio: 1.25
+// SUMMARY-NEXT: Files written: 1 - Unchanged: 0 - Failed: 0
 // YAML: {{^file.\.yaml$}}
 // NO_YAML-NOT: {{^file.\.yaml$}}
@@ -0,0 +1,18 @@
+// RUN: rm -rf %T/Inputs/symlink %T/Inputs/symlink-target
+// RUN: mkdir -p %T/Inputs/symlink %T/Inputs/symlink-target
+//
+// link.yaml changes link.cpp, a symbolic link to target.cpp, which also has
+// a hard link. The change must be written through the symbolic link and be
+// seen through the hard link.
+//
+// RUN: grep -Ev "// *[A-Z-]+:" %S/Inputs/symlink/target.cpp > %T/Inputs/symlink-target/target.cpp
+// RUN: ln %T/Inputs/symlink-target/target.cpp %T/Inputs/symlink-target/hardlink.cpp
+// RUN: ln -s %T/Inputs/symlink-target/target.cpp %T/Inputs/symlink/link.cpp
+// RUN: sed "s#\$(path)#%/T/Inputs/symlink#" %S/Inputs/symlink/link.yaml > %T/Inputs/symlink/link.yaml
+// RUN: clang-apply-replacements -summary %T/Inputs/symlink | FileCheck %s
+// RUN: test -L %T/Inputs/symlink/link.cpp
+// RUN: FileCheck -input-file=%T/Inputs/symlink-target/target.cpp %S/Inputs/symlink/target.cpp
+// RUN: FileCheck -input-file=%T/Inputs/symlink-target/hardlink.cpp %S/Inputs/symlink/target.cpp
+// REQUIRES: shell
+//
+// CHECK: Files written: 1 - Unchanged: 0 - Failed: 0
@@ -0,0 +1,18 @@
+// RUN: mkdir -p %T/Inputs/unchanged
+//
+// same.yaml replaces code with identical text so same.cpp must be left alone
+// while changed.cpp is rewritten.
+//
+// RUN: grep -Ev "// *[A-Z-]+:" %S/Inputs/unchanged/same.cpp > %T/Inputs/unchanged/same.cpp
+// RUN: grep -Ev "// *[A-Z-]+:" %S/Inputs/unchanged/changed.cpp > %T/Inputs/unchanged/changed.cpp
+// RUN: sed "s#\$(path)#%/T/Inputs/unchanged#" %S/Inputs/unchanged/same.yaml > %T/Inputs/unchanged/same.yaml
+// RUN: sed "s#\$(path)#%/T/Inputs/unchanged#" %S/Inputs/unchanged/changed.yaml > %T/Inputs/unchanged/changed.yaml
+// RUN: clang-apply-replacements -summary %T/Inputs/unchanged | FileCheck %s
+// RUN: FileCheck -input-file=%T/Inputs/unchanged/same.cpp %S/Inputs/unchanged/same.cpp
+// RUN: FileCheck -input-file=%T/Inputs/unchanged/changed.cpp %S/Inputs/unchanged/changed.cpp
+//
+// No temporary file must be left behind.
+// RUN: ls -1 %T/Inputs/unchanged | FileCheck %s --check-prefix=TEMP
+//
+// CHECK: Files written: 1 - Unchanged: 1 - Failed: 0
+// TEMP-NOT: .tmp
@@ -0,0 +1,27 @@
+// RUN: rm -rf %t
+// RUN: mkdir -p %t
+// RUN: echo '#define NULL 0' > %t/header.h
+// RUN: echo 'int *h = NULL;' >> %t/header.h
+// RUN: echo 'int *c = 0;' > %t/changed.cpp
+// RUN: echo '#include "header.h"' > %t/includer.cpp
+// RUN: echo 'int u;' > %t/untouched.cpp
+// RUN: clang-modernize -use-nullptr -final-syntax-check -summary \
+// RUN:   -include=%t %t/changed.cpp %t/includer.cpp %t/untouched.cpp \
+// RUN:   -- -std=c++11 | FileCheck -check-prefix=SUMMARY %s
+// RUN: FileCheck -check-prefix=HEADER -input-file=%t/header.h %s
+//
+// Once transformed, broken.cpp no longer compiles since nullptr is a macro.
+// RUN: echo '#define nullptr )' > %t/broken.cpp
+// RUN: echo 'int *b = 0;' >> %t/broken.cpp
+// RUN: not clang-modernize -use-nullptr -final-syntax-check -summary \
+// RUN:   %t/broken.cpp %t/untouched.cpp -- -std=c++11 > %t/broken.out 2>&1
+// RUN: FileCheck -check-prefix=BROKEN -input-file=%t/broken.out %s
+// REQUIRES: shell
+
+// untouched.cpp isn't parsed again: neither it nor anything it includes
+// changed. includer.cpp is, since the header it includes changed.
+// SUMMARY: Final syntax check: parsed 2 of 3 sources
+// HEADER: int *h = nullptr;
+// BROKEN: Final syntax check: parsed 1 of 2 sources
+// BROKEN: Final syntax check failed for {{.*}}broken.cpp
+// BROKEN-NOT: failed for {{.*}}untouched.cpp
@@ -0,0 +1,32 @@
+// RUN: grep -Ev "// *[A-Z-]+:" %s > %t.cpp
+// RUN: rm -f %t.state
+// RUN: clang-modernize -use-nullptr -summary -incremental=%t.state %t.cpp \
+// RUN:   -- -std=c++11 | FileCheck -check-prefix=FIRST %s
+// RUN: FileCheck -input-file=%t.cpp %s
+// RUN: clang-modernize -use-nullptr -summary -incremental=%t.state %t.cpp \
+// RUN:   -- -std=c++11 | FileCheck -check-prefix=SECOND %s
+// RUN: clang-modernize -use-nullptr -summary -incremental=%t.state %t.cpp \
+// RUN:   -- -std=c++11 | FileCheck -check-prefix=THIRD %s
+// RUN: clang-modernize -use-nullptr -summary -incremental=%t.state %t.cpp \
+// RUN:   -risk=safe -- -std=c++11 | FileCheck -check-prefix=SECOND %s
+// RUN: echo "int *r = 0;" >> %t.cpp
+// RUN: clang-modernize -use-nullptr -summary -incremental=%t.state %t.cpp \
+// RUN:   -- -std=c++11 | FileCheck -check-prefix=MODIFIED %s
+
+// A source that was changed is transformed again by the next run.
+// FIRST: Transform: UseNullptr - Accepted: 2 - Skipped: 0
+// SECOND: Transform: UseNullptr - Accepted: 0 - Skipped: 0
+
+// Once a run made no changes, the source is skipped until it or the options
+// change.
+// THIRD: Transform: UseNullptr - Accepted: 0 - Skipped: 1
+// MODIFIED: Transform: UseNullptr - Accepted: 1 - Skipped: 0
+
+#define NULL 0
+
+void f() {
+  int *p = NULL;
+  // CHECK: int *p = nullptr;
+  char *q = 0;
+  // CHECK: char *q = nullptr;
+}
@@ -0,0 +1,19 @@
+// RUN: grep -Ev "// *[A-Z-]+:" %s > %t_a.cpp
+// RUN: grep -Ev "// *[A-Z-]+:" %s > %t_b.cpp
+// RUN: clang-modernize -use-nullptr -summary -j=2 %t_a.cpp %t_b.cpp \
+// RUN:   -- -std=c++11 | FileCheck -check-prefix=SUMMARY %s
+// RUN: FileCheck -input-file=%t_a.cpp %s
+// RUN: FileCheck -input-file=%t_b.cpp %s
+
+// The changes made to each source are counted once in the summary, whichever
+// thread transformed the source.
+// SUMMARY: Transform: UseNullptr - Accepted: 4
+
+#define NULL 0
+
+void f() {
+  int *p = NULL;
+  // CHECK: int *p = nullptr;
+  char *q = 0;
+  // CHECK: char *q = nullptr;
+}
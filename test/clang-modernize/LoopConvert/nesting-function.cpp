@@ -0,0 +1,27 @@
+// RUN: grep -Ev "// *[A-Z-]+:" %s > %t.cpp
+// RUN: clang-modernize -loop-convert %t.cpp -- -std=c++11 -I %S/Inputs
+// RUN: FileCheck -input-file=%t.cpp %s
+
+#include "structures.h"
+
+// The loop converter only analyzes the functions containing loops, starting
+// from the outermost one, so the name generated for a loop nested in a lambda
+// still doesn't conflict with the name generated for the enclosing loop.
+
+void lambda() {
+  const int N = 10;
+  Val Arr[N];
+  for (int i = 0; i < N; ++i) {
+    printf("%d", Arr[i].x);
+    auto F = [&]() {
+      for (int j = 0; j < N; ++j)
+        printf("%d", Arr[j].x);
+    };
+    F();
+  }
+  // CHECK: for (auto & elem : Arr) {
+  // CHECK-NEXT: printf("%d", elem.x);
+  // CHECK-NEXT: auto F = [&]() {
+  // CHECK-NEXT: for (auto & Arr_j : Arr)
+  // CHECK-NEXT: printf("%d", Arr_j.x);
+}
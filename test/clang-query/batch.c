@@ -0,0 +1,14 @@
+// RUN: clang-query -c "match functionDecl()" -c "match varDecl()" -c "set output count" -c "match functionDecl()" %s -- > %t.serial
+// RUN: clang-query -batch -c "match functionDecl()" -c "match varDecl()" -c "set output count" -c "match functionDecl()" %s -- > %t.batch
+// RUN: diff %t.serial %t.batch
+// RUN: FileCheck %s < %t.batch
+
+// CHECK: batch.c:12:1: note: "root" binds here
+// CHECK: 1 match.
+// CHECK: batch.c:13:1: note: "root" binds here
+// CHECK: batch.c:14:1: note: "root" binds here
+// CHECK: 2 matches.
+// CHECK: 1 match.
+void foo(void) {}
+int x;
+int y;
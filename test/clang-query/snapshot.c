@@ -0,0 +1,18 @@
+// RUN: rm -rf %t
+// RUN: mkdir -p %t
+// RUN: echo 'void foo(void) {}' > %t/input.c
+// RUN: clang-query -time -snapshot-dir=%t/snapshots -c "match functionDecl()" %t/input.c -- 2>&1 | FileCheck --check-prefix=BUILD %s
+// RUN: clang-query -time -snapshot-dir=%t/snapshots -c "match functionDecl()" %t/input.c -- 2>&1 | FileCheck --check-prefix=LOAD %s
+// RUN: echo 'void bar(void) {}' >> %t/input.c
+// RUN: clang-query -time -snapshot-dir=%t/snapshots -c "match functionDecl()" %t/input.c -- 2>&1 | FileCheck --check-prefix=CHANGED %s
+// RUN: clang-query -time -snapshot-dir=%t/snapshots -c "match functionDecl()" %t/input.c -- -DFOO 2>&1 | FileCheck --check-prefix=COMMAND %s
+// REQUIRES: shell
+
+// BUILD: loaded 0 of 1 files from snapshots
+// BUILD: 1 match.
+// LOAD: loaded 1 of 1 files from snapshots
+// LOAD: input.c:1:1: note: "root" binds here
+// LOAD: 1 match.
+// CHANGED: loaded 0 of 1 files from snapshots
+// CHANGED: 2 matches.
+// COMMAND: loaded 0 of 1 files from snapshots
@@ -0,0 +1,12 @@
+// RUN: cat %s > %t.cpp
+// RUN: clang-rename -offset=154 -new-name=Bar %t.cpp -i --
+// RUN: sed 's,//.*,,' %t.cpp | FileCheck %s
+// REQUIRES: shell
+class Foo {     // CHECK: class Bar {
+public:
+  Foo();        // CHECK: Bar();
+  Foo(int);     // CHECK: Bar(int);
+  int Foo2;     // CHECK: int Foo2;
+};
+// Use grep -FUbo 'Foo {' <file> to get the correct offset of Foo when changing
+// this file.
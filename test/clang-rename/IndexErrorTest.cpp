@@ -0,0 +1,25 @@
+// RUN: rm -rf %t
+// RUN: mkdir -p %t
+// RUN: echo 'int foo;' > %t/a.cpp
+// RUN: echo 'int bar() { return foo + undeclared; }' > %t/b.cpp
+// RUN: echo '[' > %t/compile_commands.json
+// RUN: echo '{"directory": "%t", "command": "clang++ -c %t/a.cpp", "file": "%t/a.cpp"},' >> %t/compile_commands.json
+// RUN: echo '{"directory": "%t", "command": "clang++ -c %t/b.cpp", "file": "%t/b.cpp"}' >> %t/compile_commands.json
+// RUN: echo ']' >> %t/compile_commands.json
+// RUN: not clang-rename -build-index=%t/index -p %t %t/a.cpp 2>&1 | FileCheck --check-prefix=BUILD %s
+// b.cpp failed to parse, so it is left out of the index and indexed again.
+// RUN: not clang-rename -build-index=%t/index -p %t %t/a.cpp 2>&1 | FileCheck --check-prefix=UPDATE %s
+// RUN: echo 'int bar() { return foo; }' > %t/b.cpp
+// RUN: clang-rename -build-index=%t/index -p %t %t/a.cpp 2>&1 | FileCheck --check-prefix=FIXED %s
+// RUN: clang-rename -use-index=%t/index -offset=4 -new-name=qux -p %t %t/a.cpp -i
+// RUN: FileCheck --check-prefix=A %s < %t/a.cpp
+// RUN: FileCheck --check-prefix=B %s < %t/b.cpp
+// REQUIRES: shell
+
+// BUILD: clang-rename: indexed 2 of 2 files.
+// UPDATE: clang-rename: indexed 1 of 2 files.
+// FIXED: clang-rename: indexed 1 of 2 files.
+// A: int qux;
+// B: int bar() { return qux; }
+
+// The offset is that of foo in a.cpp.
@@ -0,0 +1,33 @@
+// RUN: rm -rf %t
+// RUN: mkdir -p %t
+// RUN: echo 'extern int foo;' > %t/header.h
+// RUN: echo '#include "header.h"' > %t/a.cpp
+// RUN: echo 'int foo;' >> %t/a.cpp
+// RUN: echo '#include "header.h"' > %t/b.cpp
+// RUN: echo 'int bar() { return foo; }' >> %t/b.cpp
+// RUN: echo '[' > %t/compile_commands.json
+// RUN: echo '{"directory": "%t", "command": "clang++ -c %t/a.cpp", "file": "%t/a.cpp"},' >> %t/compile_commands.json
+// RUN: echo '{"directory": "%t", "command": "clang++ -c %t/b.cpp", "file": "%t/b.cpp"}' >> %t/compile_commands.json
+// RUN: echo ']' >> %t/compile_commands.json
+// RUN: clang-rename -build-index=%t/index -p %t %t/a.cpp 2>&1 | FileCheck --check-prefix=BUILD %s
+// RUN: clang-rename -build-index=%t/index -p %t %t/a.cpp 2>&1 | FileCheck --check-prefix=UPDATE %s
+// RUN: clang-rename -use-index=%t/index -offset=24 -new-name=qux -p %t %t/a.cpp -i
+// RUN: FileCheck --check-prefix=HEADER %s < %t/header.h
+// RUN: FileCheck --check-prefix=A %s < %t/a.cpp
+// RUN: FileCheck --check-prefix=B %s < %t/b.cpp
+// RUN: not clang-rename -use-index=%t/index -offset=24 -new-name=foo -p %t %t/a.cpp 2>&1 | FileCheck --check-prefix=STALE %s
+// An index whose translation unit refers to a file that isn't in the index.
+// RUN: printf 'CRNIDX02\000\000\000\000\000\000\000\000\001\000\000\000' > %t/corrupt
+// RUN: head -c 44 /dev/zero >> %t/corrupt
+// RUN: not clang-rename -use-index=%t/corrupt -offset=24 -new-name=foo -p %t %t/a.cpp 2>&1 | FileCheck --check-prefix=CORRUPT %s
+// REQUIRES: shell
+
+// BUILD: clang-rename: indexed 2 of 2 files.
+// UPDATE: clang-rename: indexed 0 of 2 files.
+// HEADER: extern int qux;
+// A: int qux;
+// B: int bar() { return qux; }
+// STALE: changed since it was indexed
+// CORRUPT: corrupt clang-rename index
+
+// The offset is that of foo in a.cpp, after the 20 byte #include line.
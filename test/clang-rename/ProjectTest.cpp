@@ -0,0 +1,26 @@
+// RUN: rm -rf %t
+// RUN: mkdir -p %t
+// RUN: echo 'extern int foo;' > %t/header.h
+// RUN: echo '#include "header.h"' > %t/a.cpp
+// RUN: echo 'int foo;' >> %t/a.cpp
+// RUN: echo '#include "header.h"' > %t/b.cpp
+// RUN: echo 'int bar() { return foo; }' >> %t/b.cpp
+// RUN: echo 'int baz;' > %t/c.cpp
+// RUN: echo '[' > %t/compile_commands.json
+// RUN: echo '{"directory": "%t", "command": "clang++ -c %t/a.cpp", "file": "%t/a.cpp"},' >> %t/compile_commands.json
+// RUN: echo '{"directory": "%t", "command": "clang++ -c %t/b.cpp", "file": "%t/b.cpp"},' >> %t/compile_commands.json
+// RUN: echo '{"directory": "%t", "command": "clang++ -c %t/c.cpp", "file": "%t/c.cpp"}' >> %t/compile_commands.json
+// RUN: echo ']' >> %t/compile_commands.json
+// RUN: clang-rename -project -prefilter -j 2 -offset=24 -new-name=qux -p %t %t/a.cpp -i
+// RUN: FileCheck --check-prefix=HEADER %s < %t/header.h
+// RUN: FileCheck --check-prefix=A %s < %t/a.cpp
+// RUN: FileCheck --check-prefix=B %s < %t/b.cpp
+// RUN: FileCheck --check-prefix=C %s < %t/c.cpp
+// REQUIRES: shell
+
+// HEADER: extern int qux;
+// A: int qux;
+// B: int bar() { return qux; }
+// C: int baz;
+
+// The offset is that of foo in a.cpp, after the 20 byte #include line.
@@ -0,0 +1,15 @@
+// RUN: rm -rf %t
+// RUN: mkdir -p %t
+// RUN: echo 'int foo;' > %t/a.cpp
+// RUN: echo 'extern int foo;' > %t/b.cpp
+// RUN: echo 'int bar() { return foo; }' >> %t/b.cpp
+// RUN: clang-rename -offset=4 -new-name=qux %t/a.cpp %t/b.cpp -- | FileCheck %s
+// RUN: clang-rename -streaming -offset=4 -new-name=qux %t/a.cpp %t/b.cpp -- | FileCheck %s
+// REQUIRES: shell
+
+// CHECK: int qux;
+// CHECK: extern int qux;
+// CHECK: int bar() { return qux; }
+
+// Both modes parse each file once: with all the ASTs kept, or with the file
+// of the symbol first and then the other files one at a time.
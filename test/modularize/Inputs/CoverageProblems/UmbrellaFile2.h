@@ -0,0 +1,2 @@
+#define UMBRELLA_HEADER_2 1
+#include "UmbrellaInclude3.h"
@@ -0,0 +1 @@
+#define UMBRELLA_INCLUDE_3 1
@@ -0,0 +1,20 @@
+// RUN: pp-trace %s -undef -target x86_64 -std=c++11 > %t.yaml
+// RUN: pp-trace -output-format=binary -output=%t.bin %s -undef -target x86_64 -std=c++11
+// RUN: pp-trace -convert=%t.bin > %t.converted.yaml
+// RUN: diff %t.yaml %t.converted.yaml
+// RUN: pp-trace -convert=%t.bin -output-format=csv | FileCheck --strict-whitespace %s
+
+#include "Inputs/Level1A.h"
+#define MACRO 1
+#if MACRO
+#endif
+
+// CHECK: Index,Callback,Argument,Value
+// CHECK-NEXT: 1,FileChanged,Loc,"""{{.*}}{{[/\\]}}pp-trace-binary.cpp:1:1"""
+// CHECK-NEXT: 1,FileChanged,Reason,EnterFile
+// CHECK-NEXT: 1,FileChanged,FileType,C_User
+// CHECK-NEXT: 1,FileChanged,PrevFID,(invalid)
+// CHECK: InclusionDirective,IsAngled,false
+// CHECK: MacroDefined,MacroNameTok,MACRO
+// CHECK: If,ConditionValue,CVK_True
+// CHECK: EndOfMainFile,,
@@ -0,0 +1,33 @@
+// RUN: pp-trace -only InclusionDirective,EndOfMainFile %s -undef -target x86_64 -std=c++11 | FileCheck --strict-whitespace %s
+// RUN: pp-trace -only InclusionDirective,MacroDefined -files "*Level1A.h" %s -undef -target x86_64 -std=c++11 | FileCheck --strict-whitespace --check-prefix=FILES %s
+// RUN: not pp-trace -ignore NoSuchCallback %s 2>&1 | FileCheck --check-prefix=ERROR %s
+
+#include "Inputs/Level1A.h"
+#include "Inputs/Level1B.h"
+
+// CHECK: ---
+// CHECK-NEXT: - Callback: InclusionDirective
+// CHECK-NEXT:   IncludeTok: include
+// CHECK-NEXT:   FileName: "Inputs/Level1A.h"
+// CHECK: - Callback: InclusionDirective
+// CHECK-NEXT:   IncludeTok: include
+// CHECK-NEXT:   FileName: "Level2A.h"
+// CHECK: - Callback: InclusionDirective
+// CHECK-NEXT:   IncludeTok: include
+// CHECK-NEXT:   FileName: "Inputs/Level1B.h"
+// CHECK: - Callback: InclusionDirective
+// CHECK-NEXT:   IncludeTok: include
+// CHECK-NEXT:   FileName: "Level2B.h"
+// CHECK: - Callback: EndOfMainFile
+// CHECK-NEXT: ...
+
+// FILES: ---
+// FILES-NEXT: - Callback: InclusionDirective
+// FILES-NEXT:   IncludeTok: include
+// FILES-NEXT:   FileName: "Level2A.h"
+// FILES: - Callback: MacroDefined
+// FILES-NEXT:   MacroNameTok: MACRO_1A
+// FILES-NEXT:   MacroDirective: MD_Define
+// FILES-NEXT: ...
+
+// ERROR: pp-trace: -ignore: unknown callback name: NoSuchCallback
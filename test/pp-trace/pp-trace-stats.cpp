@@ -0,0 +1,52 @@
+// RUN: pp-trace -stats -stats-format=json %s -undef -target x86_64 -std=c++11 | FileCheck --check-prefix=JSON %s
+// RUN: echo %s > %t.list
+// RUN: pp-trace -stats -j 2 -source-list %t.list %s -undef -target x86_64 -std=c++11 | FileCheck --check-prefix=TEXT %s
+// RUN: pp-trace -stats -stats-format=json -files "*Level1A.h" %s -undef -target x86_64 -std=c++11 | FileCheck --check-prefix=FILES %s
+
+#include "Inputs/Level1A.h"
+#include "Inputs/Level1A.h"
+#include "Inputs/Level1B.h"
+
+#define STATS_MACRO 1
+#if STATS_MACRO
+int i = STATS_MACRO;
+#elif STATS_MACRO + STATS_MACRO
+#endif
+#ifdef MACRO_1A
+#else
+#endif
+
+// JSON: "TranslationUnits": 1,
+// JSON-NEXT: "Conditionals": {"If": 1, "Elif": 1, "Ifdef": 1, "Ifndef": 0, "Else": 1, "Endif": 2},
+// JSON: {"File": "{{.*}}Level1A.h", "Includes": 2, "Entries": 2, "Skipped": 0, "TranslationUnits": 1, "Conditionals": 0, "SelfTime": {{[0-9.]+}}, "InclusiveTime": {{[0-9.]+}}},
+// JSON-NEXT: {"File": "{{.*}}Level1B.h", "Includes": 1, "Entries": 1, "Skipped": 0, "TranslationUnits": 1,
+// JSON-NEXT: {"File": "{{.*}}Level2A.h", "Includes": 0, "Entries": 2, "Skipped": 0, "TranslationUnits": 1,
+// JSON-NEXT: {"File": "{{.*}}Level2B.h", "Includes": 0, "Entries": 1, "Skipped": 0, "TranslationUnits": 1,
+// JSON-NEXT: {"File": "{{.*}}pp-trace-stats.cpp", "Includes": 3, "Entries": 1, "Skipped": 0, "TranslationUnits": 1, "Conditionals": 6,
+// JSON: "Macros": [
+// JSON-NEXT: {"Macro": "STATS_MACRO", "Expansions": 2}
+// JSON-NEXT: ]
+// JSON-NEXT: }
+
+// TEXT: Translation units: 2
+// TEXT: Conditional directives:
+// TEXT-NEXT: If                 2
+// TEXT-NEXT: Elif               2
+// TEXT: Files by inclusive time:
+// TEXT: Files entered more than once per translation unit:
+// TEXT-NEXT: Entries      TUs  Skipped  File
+// TEXT-NEXT: 4        2        0  {{.*}}Level1A.h
+// TEXT-NEXT: 4        2        0  {{.*}}Level2A.h
+// TEXT: Files by inclusion directives:
+// TEXT-NEXT: Includes  Conditionals  File
+// TEXT-NEXT: 6             12  {{.*}}pp-trace-stats.cpp
+// TEXT-NEXT: 4              0  {{.*}}Level1A.h
+// TEXT-NEXT: 2              0  {{.*}}Level1B.h
+// TEXT: Macros by expansions:
+// TEXT-NEXT: Expansions  Macro
+// TEXT-NEXT: 4  STATS_MACRO
+
+// FILES: "Files": [
+// FILES-NEXT: {"File": "{{.*}}Level1A.h", "Includes": 2, "Entries": 2,
+// FILES-NEXT: ]
+// FILES: "Macros": []
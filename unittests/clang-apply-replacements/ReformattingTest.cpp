@@ -67,3 +67,39 @@ TEST(CalculateChangedRangesTest, calculatesRanges) {
   Range ExpectedRanges[] = { Range(2, 3), Range(8, 4) };
   EXPECT_TRUE(std::equal(Changes.begin(), Changes.end(), ExpectedRanges));
 }
+
+// Ranges that overlap or touch are handed to clang-format as a single range.
+TEST(CalculateChangedRangesTest, mergesAdjacentRanges) {
+  ReplacementsVec R;
+  R.push_back(makeReplacement(2, 1, 3));
+  R.push_back(makeReplacement(3, 2, 1));
+  R.push_back(makeReplacement(5, 1, 2));
+  R.push_back(makeReplacement(9, 1, 0));
+  R.push_back(makeReplacement(12, 0, 2));
+  R.push_back(makeReplacement(12, 1, 1));
+  RangeVector Changes = calculateChangedRanges(R);
+
+  Range ExpectedRanges[] = { Range(2, 6), Range(11, 0), Range(13, 2) };
+  ASSERT_EQ(3u, Changes.size());
+  EXPECT_TRUE(std::equal(Changes.begin(), Changes.end(), ExpectedRanges));
+}
+
+// Check the ranges against shiftedCodePosition() on synthetic replacement
+// sets of increasing size. The largest sets, as produced by fixes applied to
+// generated files, used to take minutes when ranges were computed with one
+// call to shiftedCodePosition() per replacement.
+TEST(CalculateChangedRangesTest, scalesToLargeReplacementSets) {
+  for (unsigned Size = 10; Size <= 100000; Size *= 10) {
+    ReplacementsVec R;
+    for (unsigned I = 0; I < Size; ++I)
+      R.push_back(makeReplacement(I * 10, I % 4, I % 7));
+    RangeVector Changes = calculateChangedRanges(R);
+    ASSERT_EQ(Size, Changes.size());
+
+    bool CheckAll = Size <= 1000;
+    for (unsigned I = CheckAll ? 0 : Size - 1; I < Size; ++I) {
+      unsigned Expected = shiftedCodePosition(R, R[I].getOffset());
+      EXPECT_EQ(Range(Expected, I % 7), Changes[I]);
+    }
+  }
+}
@@ -276,6 +276,20 @@ TEST(IncludeDirectivesTest, indirectIncludes) {
   }
 }
 
+TEST(IncludeDirectivesTest, cyclicIncludes) {
+  // a.h and b.h include each other, and b.h includes c.h.
+  tooling::Replacements Replaces;
+  TestAddIncludeAction *Action = new TestAddIncludeAction("c.h", Replaces);
+  Action->mapVirtualHeader("a.h", "#pragma once\n"
+                                  "#include <b.h>\n");
+  Action->mapVirtualHeader("b.h", "#pragma once\n"
+                                  "#include <a.h>\n"
+                                  "#include <c.h>\n");
+  Action->mapVirtualHeader("c.h", "#pragma once\n");
+  ASSERT_NO_FATAL_FAILURE(applyActionOnCode(Action, "#include <a.h>\n"));
+  EXPECT_EQ(unsigned(0), Replaces.size());
+}
+
 /// \brief Convenience method to test header guards detection implementation.
 static std::string addIncludeInGuardedHeader(StringRef IncludeToAdd,
                                              StringRef GuardedHeaderCode) {
@@ -408,3 +422,28 @@ TEST(IncludeDirectivesTest, headerGuardWithInclude) {
                                              "\n"
                                              "#endif // GUARD_H\n"));
 }
+
+TEST(IncludeDirectivesTest, nestedConditionalsInGuard) {
+  EXPECT_EQ("#ifndef GUARD_H\n"
+            "#define GUARD_H\n"
+            "\n"
+            "#include <foo>\n"
+            "\n"
+            "#ifdef BAR\n"
+            "#if BAR > 1\n"
+            "struct bar;\n"
+            "#endif\n"
+            "#endif\n"
+            "\n"
+            "#endif // GUARD_H\n",
+            addIncludeInGuardedHeader("foo", "#ifndef GUARD_H\n"
+                                             "#define GUARD_H\n"
+                                             "\n"
+                                             "#ifdef BAR\n"
+                                             "#if BAR > 1\n"
+                                             "struct bar;\n"
+                                             "#endif\n"
+                                             "#endif\n"
+                                             "\n"
+                                             "#endif // GUARD_H\n"));
+}
@@ -76,6 +76,29 @@ TEST(IncludeExcludeTest, ParseStringCases) {
   EXPECT_FALSE(IEManager.isFileIncluded("c/c2/c3/f.cpp"));
 }
 
+TEST(IncludeExcludeTest, ParseStringNested) {
+  IncludeExcludeInfo IEManager;
+  std::error_code Err = IEManager.readListFromString(
+      /*include=*/ "a,a/b/c,a/b/c,/e",
+      /*exclude=*/ "a/b,/e/e2/f.cpp");
+
+  ASSERT_EQ(Err, std::error_code());
+  EXPECT_FALSE(IEManager.isIncludeListEmpty());
+
+  // An exclude path wins over any include path, shorter or longer.
+  EXPECT_TRUE(IEManager.isFileIncluded("a/f.cpp"));
+  EXPECT_FALSE(IEManager.isFileIncluded("a/b/f.cpp"));
+  EXPECT_FALSE(IEManager.isFileIncluded("a/b/c/f.cpp"));
+  EXPECT_TRUE(IEManager.isFileExplicitlyExcluded("a/b/c/f.cpp"));
+  EXPECT_FALSE(IEManager.isFileExplicitlyExcluded("a/f.cpp"));
+
+  // Path components are compared as a whole.
+  EXPECT_FALSE(IEManager.isFileIncluded("ab/f.cpp"));
+  EXPECT_TRUE(IEManager.isFileIncluded("/e/f.cpp"));
+  EXPECT_FALSE(IEManager.isFileIncluded("/e/e2/f.cpp"));
+  EXPECT_TRUE(IEManager.isFileIncluded("/e/e2/f.cpp.h"));
+}
+
 // Utility for creating and filling files with data for IncludeExcludeFileTest
 // tests.
 struct InputFiles {
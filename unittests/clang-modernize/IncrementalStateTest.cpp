@@ -0,0 +1,79 @@
+//===- clang-modernize/IncrementalStateTest.cpp - IncrementalState tests --===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "common/Utility.h"
+#include "Core/IncrementalState.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/raw_ostream.h"
+#include "gtest/gtest.h"
+
+static void writeFile(llvm::StringRef Path, llvm::StringRef Contents) {
+  std::error_code EC;
+  llvm::raw_fd_ostream OS(Path, EC, llvm::sys::fs::F_None);
+  ASSERT_NO_ERROR(EC);
+  OS << Contents;
+}
+
+static void createFile(const char *Prefix, const char *Suffix,
+                       llvm::StringRef Contents,
+                       llvm::SmallVectorImpl<char> &Path) {
+  int FD;
+  ASSERT_NO_ERROR(
+      llvm::sys::fs::createTemporaryFile(Prefix, Suffix, FD, Path));
+  llvm::raw_fd_ostream OS(FD, /*shouldClose=*/true);
+  OS << Contents;
+}
+
+TEST(IncrementalStateTest, SkipUnchanged) {
+  llvm::SmallString<128> Source, Header, StateFile;
+  ASSERT_NO_FATAL_FAILURE(
+      createFile("source", "cpp", "#include \"header.h\"\n", Source));
+  ASSERT_NO_FATAL_FAILURE(createFile("header", "h", "int *p = 0;\n", Header));
+  // Only the name of the state file is needed.
+  ASSERT_NO_FATAL_FAILURE(createFile("state", "", "", StateFile));
+  llvm::sys::fs::remove(StateFile);
+
+  std::vector<std::string> Inputs;
+  Inputs.push_back(Source.str());
+  Inputs.push_back(Header.str());
+
+  {
+    IncrementalState State;
+    // A missing state file is an empty state.
+    ASSERT_NO_ERROR(State.load(StateFile));
+    EXPECT_FALSE(State.isUnchanged(Source, "T", "risk=1", "cc"));
+
+    State.record(Source, "T", "risk=1", "cc", Inputs, /*Changed=*/false);
+    State.record(Source, "U", "risk=1", "cc", Inputs, /*Changed=*/true);
+    EXPECT_TRUE(State.isUnchanged(Source, "T", "risk=1", "cc"));
+    EXPECT_FALSE(State.isUnchanged(Source, "U", "risk=1", "cc"));
+    ASSERT_NO_ERROR(State.save(StateFile));
+  }
+
+  IncrementalState State;
+  ASSERT_NO_ERROR(State.load(StateFile));
+  EXPECT_TRUE(State.isUnchanged(Source, "T", "risk=1", "cc"));
+  EXPECT_FALSE(State.isUnchanged(Source, "U", "risk=1", "cc"));
+  EXPECT_FALSE(State.isUnchanged(Source, "T", "risk=2", "cc"));
+  EXPECT_FALSE(State.isUnchanged(Source, "T", "risk=1", "cc -DX"));
+
+  // Changes to files are only noticed once the hashes are invalidated.
+  writeFile(Header, "int *p = nullptr;\n");
+  EXPECT_TRUE(State.isUnchanged(Source, "T", "risk=1", "cc"));
+  State.invalidateFileHashes();
+  EXPECT_FALSE(State.isUnchanged(Source, "T", "risk=1", "cc"));
+
+  // A source whose inputs are gone is dropped.
+  llvm::sys::fs::remove(Header);
+  State.record(Source, "T", "risk=1", "cc", Inputs, /*Changed=*/false);
+  EXPECT_FALSE(State.isUnchanged(Source, "T", "risk=1", "cc"));
+
+  llvm::sys::fs::remove(Source);
+  llvm::sys::fs::remove(StateFile);
+}
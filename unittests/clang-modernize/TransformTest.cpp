@@ -71,6 +71,38 @@ TEST(Transform, Interface) {
   ASSERT_TRUE(T.getChangesNotMade());
 }
 
+TEST(Transform, Merge) {
+  TransformOptions Options;
+  DummyTransform T("my_transform", Options);
+  DummyTransform Worker("my_transform", Options);
+  CompilerInstance CI;
+
+  T.setAcceptedChanges(1);
+  ASSERT_TRUE(T.handleBeginSource(CI, "a.cpp"));
+  ASSERT_TRUE(
+      T.addReplacementForCurrentTU(tooling::Replacement("a.cpp", 0, 1, "a")));
+  T.handleEndSource();
+
+  Worker.setAcceptedChanges(2);
+  Worker.setRejectedChanges(1);
+  ASSERT_TRUE(Worker.handleBeginSource(CI, "b.cpp"));
+  ASSERT_TRUE(Worker.addReplacementForCurrentTU(
+      tooling::Replacement("b.cpp", 0, 1, "b")));
+  Worker.handleEndSource();
+
+  T.merge(Worker);
+  EXPECT_EQ(3u, T.getAcceptedChanges());
+  EXPECT_EQ(1u, T.getRejectedChanges());
+  EXPECT_EQ(0u, T.getDeferredChanges());
+
+  const TUReplacementsMap &Replacements = T.getAllReplacements();
+  ASSERT_EQ(2u, Replacements.size());
+  EXPECT_EQ("b.cpp", Replacements.lookup("b.cpp").MainSourceFile);
+  ASSERT_EQ(1u, Replacements.lookup("b.cpp").Replacements.size());
+  EXPECT_EQ("b",
+            Replacements.lookup("b.cpp").Replacements[0].getReplacementText());
+}
+
 class TimePassingASTConsumer : public ASTConsumer {
 public:
   TimePassingASTConsumer(bool *Called) : Called(Called) {}
@@ -176,6 +208,17 @@ TEST(Transform, Timings) {
   }
   ++I;
   EXPECT_EQ(T.timing_end(), I);
+
+  // The end of parsing is only reported by the action factory of the
+  // transform, so here all the time of a source is spent in the match phase.
+  Transform::PhaseTimingVec::const_iterator PI = T.phase_timing_begin();
+  for (unsigned N = 0; N < 2; ++N, ++PI) {
+    ASSERT_NE(T.phase_timing_end(), PI);
+    EXPECT_EQ("match", PI->Phase);
+    EXPECT_TRUE(FileA == PI->Source || FileB == PI->Source);
+    EXPECT_GT(PI->Duration.getProcessTime(), 0.0);
+  }
+  EXPECT_EQ(T.phase_timing_end(), PI);
 }
 
 class ModifiableCallback
@@ -120,6 +120,60 @@ TEST_F(QueryEngineTest, Basic) {
   EXPECT_EQ("Not a valid top-level matcher.\n", OS.str());
 }
 
+TEST_F(QueryEngineTest, CountAndLimit) {
+  DynTypedMatcher FnMatcher = functionDecl();
+
+  EXPECT_TRUE(SetQuery<OutputKind>(&QuerySession::OutKind, OK_Count)
+                  .run(OS, S));
+  EXPECT_TRUE(MatchQuery(FnMatcher).run(OS, S));
+  EXPECT_EQ("4 matches.\n", OS.str());
+  Str.clear();
+
+  EXPECT_TRUE(SetQuery<unsigned>(&QuerySession::Limit, 3).run(OS, S));
+  EXPECT_TRUE(MatchQuery(FnMatcher).run(OS, S));
+  EXPECT_EQ("3 matches.\n", OS.str());
+  Str.clear();
+
+  EXPECT_TRUE(SetQuery<OutputKind>(&QuerySession::OutKind, OK_Diag)
+                  .run(OS, S));
+  EXPECT_TRUE(MatchQuery(FnMatcher).run(OS, S));
+  EXPECT_TRUE(OS.str().find("bar.cc:1:1: note: \"root\" binds here") !=
+              std::string::npos);
+  EXPECT_TRUE(OS.str().find("bar.cc:2:1") == std::string::npos);
+  EXPECT_TRUE(OS.str().find("3 matches.") != std::string::npos);
+  Str.clear();
+
+  // Each query of a batch gets its own limit.
+  DynTypedMatcher FooMatcher = functionDecl(hasName("foo1"));
+  DynTypedMatcher Matchers[] = {FnMatcher, FooMatcher};
+  EXPECT_TRUE(MultiMatchQuery(Matchers).run(OS, S));
+  EXPECT_TRUE(OS.str().find("Match #3:") != std::string::npos);
+  EXPECT_TRUE(OS.str().find("Match #4:") == std::string::npos);
+  EXPECT_TRUE(OS.str().find("3 matches.\n\nMatch #1:") != std::string::npos);
+  EXPECT_TRUE(OS.str().find("1 match.\n") != std::string::npos);
+}
+
+TEST_F(QueryEngineTest, MultiMatch) {
+  DynTypedMatcher FnMatcher = functionDecl();
+  DynTypedMatcher FooMatcher = functionDecl(hasName("foo1"));
+
+  EXPECT_TRUE(MatchQuery(FnMatcher).run(OS, S));
+  EXPECT_TRUE(MatchQuery(FooMatcher).run(OS, S));
+  std::string Serial = OS.str();
+  Str.clear();
+
+  DynTypedMatcher Matchers[] = {FnMatcher, FooMatcher};
+  EXPECT_TRUE(MultiMatchQuery(Matchers).run(OS, S));
+  EXPECT_EQ(Serial, OS.str());
+  Str.clear();
+
+  // The queries before an invalid matcher are still answered.
+  DynTypedMatcher InvalidMatchers[] = {FooMatcher, isArrow()};
+  EXPECT_FALSE(MultiMatchQuery(InvalidMatchers).run(OS, S));
+  EXPECT_TRUE(OS.str().find("1 match.\nNot a valid top-level matcher.\n") !=
+              std::string::npos);
+}
+
 TEST_F(QueryEngineTest, LetAndMatch) {
   EXPECT_TRUE(QueryParser::parse("let x \"foo1\"", S)->run(OS, S));
   EXPECT_EQ("", OS.str());
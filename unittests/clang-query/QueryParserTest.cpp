@@ -58,7 +58,7 @@ TEST_F(QueryParserTest, Set) {
 
   Q = parse("set output");
   ASSERT_TRUE(isa<InvalidQuery>(Q));
-  EXPECT_EQ("expected 'diag', 'print' or 'dump', got ''",
+  EXPECT_EQ("expected 'diag', 'print', 'dump' or 'count', got ''",
             cast<InvalidQuery>(Q)->ErrStr);
 
   Q = parse("set bind-root true foo");
@@ -67,7 +67,7 @@ TEST_F(QueryParserTest, Set) {
 
   Q = parse("set output foo");
   ASSERT_TRUE(isa<InvalidQuery>(Q));
-  EXPECT_EQ("expected 'diag', 'print' or 'dump', got 'foo'",
+  EXPECT_EQ("expected 'diag', 'print', 'dump' or 'count', got 'foo'",
             cast<InvalidQuery>(Q)->ErrStr);
 
   Q = parse("set output dump");
@@ -84,6 +84,19 @@ TEST_F(QueryParserTest, Set) {
   ASSERT_TRUE(isa<SetQuery<bool> >(Q));
   EXPECT_EQ(&QuerySession::BindRoot, cast<SetQuery<bool> >(Q)->Var);
   EXPECT_EQ(true, cast<SetQuery<bool> >(Q)->Value);
+
+  Q = parse("set output count");
+  ASSERT_TRUE(isa<SetQuery<OutputKind> >(Q));
+  EXPECT_EQ(OK_Count, cast<SetQuery<OutputKind> >(Q)->Value);
+
+  Q = parse("set limit foo");
+  ASSERT_TRUE(isa<InvalidQuery>(Q));
+  EXPECT_EQ("expected a number, got 'foo'", cast<InvalidQuery>(Q)->ErrStr);
+
+  Q = parse("set limit 10");
+  ASSERT_TRUE(isa<SetQuery<unsigned> >(Q));
+  EXPECT_EQ(&QuerySession::Limit, cast<SetQuery<unsigned> >(Q)->Var);
+  EXPECT_EQ(10u, cast<SetQuery<unsigned> >(Q)->Value);
 }
 
 TEST_F(QueryParserTest, Match) {